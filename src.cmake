@@ -35,6 +35,7 @@ set(COMMONLIST
     ${COMMON_DIR}/Math.h
     ${COMMON_DIR}/Optional.h
     ${COMMON_DIR}/Platform.h
+    ${COMMON_DIR}/Profiler.h
     ${COMMON_DIR}/Serialize.h
     ${COMMON_DIR}/StackTrace.h
     ${COMMON_DIR}/String.cpp
@@ -190,8 +191,11 @@ set(ENGINELIST
     ${ENGINE_DIR}/framework/LogSystem.h
     ${ENGINE_DIR}/framework/Resource.cpp
     ${ENGINE_DIR}/framework/Resource.h
+    ${ENGINE_DIR}/framework/Profiler.cpp
     ${ENGINE_DIR}/framework/System.cpp
     ${ENGINE_DIR}/framework/System.h
+    ${ENGINE_DIR}/framework/ThreadPool.cpp
+    ${ENGINE_DIR}/framework/ThreadPool.h
     ${ENGINE_DIR}/framework/VirtualMachine.cpp
     ${ENGINE_DIR}/framework/VirtualMachine.h
     ${ENGINE_DIR}/framework/Crypto.cpp
@@ -219,7 +223,10 @@ endif()
 
 # Tests runnable for any engine variant
 set(ENGINETESTLIST ${COMMONTESTLIST}
+    ${COMMON_DIR}/IPC/ChannelTest.cpp
+    ${ENGINE_DIR}/framework/CommandBufferHostTest.cpp
     ${ENGINE_DIR}/framework/CommandSystemTest.cpp
+    ${ENGINE_DIR}/framework/ThreadPoolTest.cpp
 )
 
 set(QCOMMONLIST
@@ -243,6 +250,11 @@ set(QCOMMONLIST
     ${ENGINE_DIR}/qcommon/translation.cpp
 )
 
+set(QCOMMONTESTLIST ${ENGINETESTLIST}
+    ${ENGINE_DIR}/qcommon/MsgTest.cpp
+    ${ENGINE_DIR}/qcommon/NetchanTest.cpp
+)
+
 if (USE_CURSES)
     set(ENGINELIST ${ENGINELIST}
         ${ENGINE_DIR}/sys/con_curses.cpp
@@ -300,7 +312,7 @@ if (APPLE)
     set(CLIENTLIST ${CLIENTLIST} ${ENGINE_DIR}/sys/DisableAccentMenu.m)
 endif()
 
-set(CLIENTTESTLIST ${ENGINETESTLIST}
+set(CLIENTTESTLIST ${QCOMMONTESTLIST}
 )
 
 set(TTYCLIENTLIST
@@ -310,10 +322,20 @@ set(TTYCLIENTLIST
     ${ENGINE_DIR}/null/null_renderer.cpp
 )
 
+set(SERVERTESTLIST
+    ${ENGINE_DIR}/server/ServerTest.cpp
+)
+
 set(DEDSERVERLIST
     ${ENGINE_DIR}/null/NullKeyboard.cpp
     ${ENGINE_DIR}/null/null_client.cpp
     ${ENGINE_DIR}/null/null_input.cpp
 )
 
+set(LOADGENLIST
+    ${ENGINE_DIR}/loadgen/LoadGen.cpp
+    ${ENGINE_DIR}/null/NullKeyboard.cpp
+    ${ENGINE_DIR}/null/null_input.cpp
+)
+
 set(WIN_RC ${ENGINE_DIR}/sys/windows-resource/icon.rc)
@@ -45,6 +45,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "IPC/CommonSyscalls.h"
+#include "Profiler.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -61,6 +62,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fcntl.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #endif
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
@@ -134,6 +136,8 @@ namespace FS {
 static Cvar::Cvar<bool> fs_legacypaks("fs_legacypaks", "also load pk3s, ignoring version", Cvar::NONE, false);
 static Cvar::Cvar<int> fs_maxSymlinkDepth("fs_maxSymlinkDepth", "max depth of symlinks in zip paks (0 means disabled)", Cvar::NONE, 1);
 static Cvar::Cvar<std::string> fs_pakprefixes("fs_pakprefixes", "prefixes to look for paks to load", 0, "");
+static Cvar::Cvar<bool> fs_pakIndexCache("fs_pakIndexCache", "cache the file lists of zip paks in the homepath", Cvar::NONE, true);
+static Cvar::Cvar<bool> fs_mapPaks("fs_mapPaks", "memory map zip paks to read files without reopening them", Cvar::NONE, true);
 
 bool UseLegacyPaks()
 {
@@ -703,6 +707,11 @@ public:
 			unzClose(zipFile);
 	}
 
+	bool IsOpen() const
+	{
+		return zipFile != nullptr;
+	}
+
 	// Open an archive from an existing file descriptor
 	static ZipArchive Open(int fd, std::error_code& err)
 	{
@@ -1034,6 +1043,175 @@ private:
 	unzFile zipFile;
 };
 
+// Read-only memory mapping of a whole zip pak. It is shared with the file
+// views pointing into it so that they remain valid after the pak is unloaded.
+// Paks must not be truncated or rewritten in place while they are mapped:
+// reading a page which is no longer backed by the file raises SIGBUS instead
+// of returning an I/O error. Set fs_mapPaks to 0 when that can happen.
+class ZipMapping {
+public:
+	ZipMapping(const ZipMapping&) = delete;
+	ZipMapping& operator=(const ZipMapping&) = delete;
+
+	~ZipMapping()
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+		CloseHandle(handle);
+#else
+		munmap(const_cast<byte*>(base), size);
+#endif
+	}
+
+	// Map the file, returns null if that is not possible
+	static std::shared_ptr<const ZipMapping> Map(int fd)
+	{
+		my_stat_t st;
+		if (my_fstat(fd, &st) == -1 || st.st_size <= 0)
+			return nullptr;
+		if (static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max())
+			return nullptr;
+		size_t size = st.st_size;
+
+#ifdef _WIN32
+		HANDLE handle = CreateFileMappingW(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!handle)
+			return nullptr;
+		void* base = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, size);
+		if (!base) {
+			CloseHandle(handle);
+			return nullptr;
+		}
+		return std::shared_ptr<const ZipMapping>(new ZipMapping(static_cast<const byte*>(base), size, handle));
+#else
+		void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		if (base == MAP_FAILED)
+			return nullptr;
+		return std::shared_ptr<const ZipMapping>(new ZipMapping(static_cast<const byte*>(base), size));
+#endif
+	}
+
+	// Location of a file in the mapping, parsed from its central directory record
+	struct Entry {
+		const byte* data;
+		uint32_t compressedSize;
+		uint32_t uncompressedSize;
+		uint32_t crc;
+		bool deflated;
+	};
+
+	// Find the data of the file whose central directory record is at the given
+	// offset. Returns false for anything that minizip must handle: symlinks,
+	// encrypted or zip64 files and unsupported compression methods.
+	bool FindEntry(offset_t centralOffset, Entry& entry) const
+	{
+		constexpr uint32_t CENTRAL_SIGNATURE = 0x02014b50;
+		constexpr uint32_t LOCAL_SIGNATURE = 0x04034b50;
+		constexpr size_t CENTRAL_HEADER_SIZE = 46;
+		constexpr size_t LOCAL_HEADER_SIZE = 30;
+		constexpr uint32_t ZIP64_MARKER = 0xffffffff;
+		constexpr int DAEMON_S_IFMT = 00170000;
+		constexpr int DAEMON_S_IFLNK = 0120000;
+
+		if (size < CENTRAL_HEADER_SIZE || centralOffset < 0 || static_cast<uint64_t>(centralOffset) > size - CENTRAL_HEADER_SIZE)
+			return false;
+		const byte* central = base + centralOffset;
+		if (Read32(central) != CENTRAL_SIGNATURE)
+			return false;
+
+		uint16_t flags = Read16(central + 8);
+		uint16_t method = Read16(central + 10);
+		entry.crc = Read32(central + 16);
+		entry.compressedSize = Read32(central + 20);
+		entry.uncompressedSize = Read32(central + 24);
+		uint32_t externalAttr = Read32(central + 38);
+		uint32_t localOffset = Read32(central + 42);
+
+		if (flags & 1)
+			return false;
+		if (method != 0 && method != Z_DEFLATED)
+			return false;
+		if (entry.compressedSize == ZIP64_MARKER || entry.uncompressedSize == ZIP64_MARKER || localOffset == ZIP64_MARKER)
+			return false;
+		if (((externalAttr >> 16) & DAEMON_S_IFMT) == DAEMON_S_IFLNK)
+			return false;
+		entry.deflated = method == Z_DEFLATED;
+		if (!entry.deflated && entry.compressedSize != entry.uncompressedSize)
+			return false;
+
+		if (localOffset > size - LOCAL_HEADER_SIZE)
+			return false;
+		const byte* local = base + localOffset;
+		if (Read32(local) != LOCAL_SIGNATURE)
+			return false;
+		size_t dataOffset = localOffset + LOCAL_HEADER_SIZE + Read16(local + 26) + Read16(local + 28);
+		if (dataOffset > size || entry.compressedSize > size - dataOffset)
+			return false;
+		entry.data = base + dataOffset;
+		return true;
+	}
+
+private:
+#ifdef _WIN32
+	ZipMapping(const byte* base, size_t size, HANDLE handle)
+		: base(base), size(size), handle(handle) {}
+#else
+	ZipMapping(const byte* base, size_t size)
+		: base(base), size(size) {}
+#endif
+
+	static uint16_t Read16(const byte* p)
+	{
+		return p[0] | p[1] << 8;
+	}
+	static uint32_t Read32(const byte* p)
+	{
+		return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+	}
+
+	const byte* base;
+	size_t size;
+#ifdef _WIN32
+	HANDLE handle;
+#endif
+};
+
+// Inflate a deflated entry of a mapping into a buffer of its uncompressed size
+static void InflateMappedEntry(const ZipMapping::Entry& entry, char* out, std::error_code& err)
+{
+	if (entry.uncompressedSize == 0) {
+		ClearErrorCode(err);
+		return;
+	}
+
+	z_stream stream{};
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+		SetErrorCode(err, UNZ_INTERNALERROR, minizip_category());
+		return;
+	}
+	stream.next_in = const_cast<Bytef*>(entry.data);
+	stream.avail_in = entry.compressedSize;
+	stream.next_out = reinterpret_cast<Bytef*>(out);
+	stream.avail_out = entry.uncompressedSize;
+	int result = inflate(&stream, Z_FINISH);
+	uLong inflated = stream.total_out;
+	inflateEnd(&stream);
+	if (result != Z_STREAM_END || inflated != entry.uncompressedSize) {
+		SetErrorCode(err, UNZ_BADZIPFILE, minizip_category());
+		return;
+	}
+	ClearErrorCode(err);
+}
+
+// Check the CRC of an extracted entry, like unzCloseCurrentFile does
+static void CheckMappedEntryCRC(const ZipMapping::Entry& entry, const char* data, std::error_code& err)
+{
+	if (crc32(0, reinterpret_cast<const Bytef*>(data), entry.uncompressedSize) != entry.crc)
+		SetErrorCode(err, UNZ_CRCERROR, minizip_category());
+	else
+		ClearErrorCode(err);
+}
+
 } // GCC bug workaround
 #endif // defined(BUILD_ENGINE)
 
@@ -1053,6 +1231,12 @@ struct LoadedPakGuard {
 };
 static LoadedPakGuard loadedPaksGuard;
 
+#ifdef BUILD_ENGINE
+// Memory mappings of the loaded zip paks, indexed like loadedPaks. They are
+// kept apart from LoadedPakInfo since that is also sent to the VMs.
+static std::vector<std::shared_ptr<const ZipMapping>> loadedPakMappings;
+#endif
+
 // std::unordered_set uses std::hash which does not
 // hash pair of std::string.
 struct stdStringPairHasher
@@ -1072,6 +1256,224 @@ static std::unordered_set<std::pair<std::string, std::string>, stdStringPairHash
 // the offset_t is the position within the zip archive (unused for PAK_DIR).
 static std::unordered_map<std::string, std::pair<uint32_t, offset_t>, Str::IHash, Str::IEqual> fileMap;
 
+#ifdef BUILD_ENGINE
+// A file in the central directory of a zip pak
+struct PakIndexEntry {
+	std::string name;
+	offset_t offset;
+	uint32_t crc;
+};
+
+// Location of the central directory of a zip, from its end of central directory record
+struct ZipEndRecord {
+	uint32_t centralOffset;
+	uint32_t centralSize;
+	uint16_t numEntries;
+
+	bool operator==(const ZipEndRecord& other) const
+	{
+		return centralOffset == other.centralOffset && centralSize == other.centralSize && numEntries == other.numEntries;
+	}
+};
+
+// Find the end of central directory record in the tail of a zip, which is
+// followed by a comment of up to 64KB
+static bool ReadZipEndRecord(int fd, uint64_t size, ZipEndRecord& record)
+{
+	constexpr uint32_t END_SIGNATURE = 0x06054b50;
+	constexpr size_t END_RECORD_SIZE = 22;
+	constexpr size_t MAX_COMMENT_SIZE = 0xffff;
+
+	size_t tailSize = std::min<uint64_t>(size, END_RECORD_SIZE + MAX_COMMENT_SIZE);
+	if (tailSize < END_RECORD_SIZE)
+		return false;
+	std::vector<byte> tail(tailSize);
+	if (my_pread(fd, tail.data(), tailSize, size - tailSize) != static_cast<intptr_t>(tailSize))
+		return false;
+
+	auto read16 = [](const byte* p) -> uint16_t { return p[0] | p[1] << 8; };
+	auto read32 = [](const byte* p) -> uint32_t { return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24; };
+	for (size_t pos = tailSize - END_RECORD_SIZE + 1; pos-- > 0;) {
+		const byte* end = tail.data() + pos;
+		if (read32(end) != END_SIGNATURE)
+			continue;
+		record.numEntries = read16(end + 10);
+		record.centralSize = read32(end + 12);
+		record.centralOffset = read32(end + 16);
+		return true;
+	}
+	return false;
+}
+
+/* Cache of the file lists of zip paks, stored in the homepath. Entries are
+keyed by the path, size and modification time of the pak so that a pak
+which did not change can be loaded without walking its central directory.
+Since a pak can be rewritten within the resolution of its modification time,
+the end of central directory record of the pak must match as well.
+The cache is a local file, so it is stored in the host byte order. */
+class PakIndexCache {
+public:
+	// Get the cached file list of a pak, or null if it is not cached or changed
+	const std::vector<PakIndexEntry>* Find(Str::StringRef path, uint64_t size, int64_t mtime, const ZipEndRecord& endRecord)
+	{
+		Load();
+		auto it = indexes.find(path);
+		if (it == indexes.end() || it->second.size != size || it->second.mtime != mtime || !(it->second.endRecord == endRecord))
+			return nullptr;
+		it->second.used = true;
+		return &it->second.files;
+	}
+
+	void Insert(Str::StringRef path, uint64_t size, int64_t mtime, const ZipEndRecord& endRecord, std::vector<PakIndexEntry> files)
+	{
+		Load();
+		indexes[path] = {size, mtime, endRecord, std::move(files), true};
+		modified = true;
+	}
+
+	// Write the cache back if paks were added to it, dropping the paks which no longer exist
+	void Save()
+	{
+		if (!modified)
+			return;
+		modified = false;
+
+		std::string data;
+		Append(data, MAGIC);
+		Append(data, VERSION);
+		for (auto it = indexes.begin(); it != indexes.end();) {
+			if (!it->second.used && !RawPath::FileExists(it->first))
+				it = indexes.erase(it);
+			else
+				++it;
+		}
+		Append(data, static_cast<uint32_t>(indexes.size()));
+		for (auto& x: indexes) {
+			AppendString(data, x.first);
+			Append(data, x.second.size);
+			Append(data, x.second.mtime);
+			Append(data, x.second.endRecord.centralOffset);
+			Append(data, x.second.endRecord.centralSize);
+			Append(data, x.second.endRecord.numEntries);
+			Append(data, static_cast<uint32_t>(x.second.files.size()));
+			for (const PakIndexEntry& file: x.second.files) {
+				AppendString(data, file.name);
+				Append(data, file.offset);
+				Append(data, file.crc);
+			}
+		}
+
+		try {
+			std::string tempName = std::string(FILENAME) + ".tmp";
+			File file = HomePath::OpenWrite(tempName);
+			file.Write(data.data(), data.size());
+			file.Close();
+			HomePath::MoveFile(FILENAME, tempName);
+		} catch (std::system_error& err) {
+			fsLogs.Verbose("Could not write the pak index cache: %s", err.what());
+		}
+	}
+
+private:
+	static constexpr char FILENAME[] = "pakindex.cache";
+	static constexpr uint32_t MAGIC = 0x4b41504b; // "KPAK"
+	static constexpr uint32_t VERSION = 2;
+
+	struct Index {
+		uint64_t size;
+		int64_t mtime;
+		ZipEndRecord endRecord;
+		std::vector<PakIndexEntry> files;
+		bool used; // looked up or added in this session, so it is known to exist
+	};
+
+	void Load()
+	{
+		if (loaded || homePath.empty())
+			return;
+		loaded = true;
+
+		std::error_code err;
+		File file = HomePath::OpenRead(FILENAME, err);
+		if (err)
+			return;
+		std::string data = file.ReadAll(err);
+		if (err)
+			return;
+
+		// Discard the whole cache if anything is wrong with it
+		const char* in = data.data();
+		const char* end = in + data.size();
+		uint32_t magic, version, numPaks;
+		if (!Extract(in, end, magic) || magic != MAGIC || !Extract(in, end, version) || version != VERSION
+			|| !Extract(in, end, numPaks)) {
+			fsLogs.Verbose("Ignoring invalid pak index cache");
+			return;
+		}
+		std::unordered_map<std::string, Index> loadedIndexes;
+		for (uint32_t i = 0; i < numPaks; i++) {
+			std::string path;
+			Index index;
+			uint32_t numFiles;
+			if (!ExtractString(in, end, path) || !Extract(in, end, index.size) || !Extract(in, end, index.mtime)
+				|| !Extract(in, end, index.endRecord.centralOffset) || !Extract(in, end, index.endRecord.centralSize)
+				|| !Extract(in, end, index.endRecord.numEntries) || !Extract(in, end, numFiles)) {
+				fsLogs.Verbose("Ignoring truncated pak index cache");
+				return;
+			}
+			index.used = false;
+			index.files.reserve(std::min<size_t>(numFiles, end - in));
+			for (uint32_t j = 0; j < numFiles; j++) {
+				PakIndexEntry entry;
+				if (!ExtractString(in, end, entry.name) || !Extract(in, end, entry.offset) || !Extract(in, end, entry.crc)) {
+					fsLogs.Verbose("Ignoring truncated pak index cache");
+					return;
+				}
+				index.files.push_back(std::move(entry));
+			}
+			loadedIndexes.emplace(std::move(path), std::move(index));
+		}
+		indexes = std::move(loadedIndexes);
+	}
+
+	template<typename T> static void Append(std::string& data, T value)
+	{
+		data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+	static void AppendString(std::string& data, Str::StringRef str)
+	{
+		Append(data, static_cast<uint32_t>(str.size()));
+		data.append(str.data(), str.size());
+	}
+	template<typename T> static bool Extract(const char*& in, const char* end, T& value)
+	{
+		if (static_cast<size_t>(end - in) < sizeof(value))
+			return false;
+		memcpy(&value, in, sizeof(value));
+		in += sizeof(value);
+		return true;
+	}
+	static bool ExtractString(const char*& in, const char* end, std::string& str)
+	{
+		uint32_t length;
+		if (!Extract(in, end, length) || static_cast<size_t>(end - in) < length)
+			return false;
+		str.assign(in, length);
+		in += length;
+		return true;
+	}
+
+	std::unordered_map<std::string, Index> indexes;
+	bool loaded = false;
+	bool modified = false;
+};
+constexpr char PakIndexCache::FILENAME[];
+static PakIndexCache pakIndexCache;
+
+// Number of zip paks loaded with their file list from the cache
+static size_t pakIndexCacheHits = 0;
+#endif // BUILD_ENGINE
+
 #ifndef BUILD_VM
 /* Parse the deleted file list file of a package.
 
@@ -1275,6 +1677,7 @@ static void InternalLoadPak(
 	}
 
 	loadedPaks.emplace_back();
+	loadedPakMappings.emplace_back();
 	auto &loadedPak = loadedPaks.back();
 	loadedPak.name = pak.name;
 	loadedPak.version = pak.version;
@@ -1315,24 +1718,56 @@ static void InternalLoadPak(
 			return;
 		}
 
-		// Open zip
-		zipFile = ZipArchive::Open(loadedPak.fd, err);
-		if (err)
-			return;
+		// Files are read through the mapping when possible, minizip is the fallback
+		if (fs_mapPaks.Get()) {
+			loadedPakMappings.back() = ZipMapping::Map(loadedPak.fd);
+			if (!loadedPakMappings.back())
+				fsLogs.Verbose("Could not map pak '%s', reading it through minizip", pak.path);
+		}
 
-		// Get the file list and calculate the checksum of the package (checksum of all file checksums)
+		// Get the file list from the index cache if the pak didn't change, or from the zip
+		my_stat_t st;
+		ZipEndRecord endRecord;
+		bool cacheable = fs_pakIndexCache.Get() && my_fstat(loadedPak.fd, &st) == 0
+			&& ReadZipEndRecord(loadedPak.fd, st.st_size, endRecord);
+		const std::vector<PakIndexEntry>* files = cacheable ? pakIndexCache.Find(pak.path, st.st_size, st.st_mtime, endRecord) : nullptr;
+		std::vector<PakIndexEntry> zipFiles;
+		if (files) {
+			fsLogs.Debug("Using the cached file list of '%s'", pak.path);
+			pakIndexCacheHits++;
+		} else {
+			zipFile = ZipArchive::Open(loadedPak.fd, err);
+			if (err)
+				return;
+			zipFile.ForEachFile([&zipFiles](Str::StringRef filename, offset_t offset, uint32_t crc) {
+				zipFiles.push_back({filename, offset, crc});
+			}, err);
+			if (err)
+				return;
+			if (cacheable) {
+				pakIndexCache.Insert(pak.path, st.st_size, st.st_mtime, endRecord, std::move(zipFiles));
+				files = pakIndexCache.Find(pak.path, st.st_size, st.st_mtime, endRecord);
+			} else {
+				files = &zipFiles;
+			}
+		}
+
+		// Calculate the checksum of the package (checksum of all file checksums)
 		realChecksum = crc32(0, Z_NULL, 0);
-		zipFile.ForEachFile([&pak, &realChecksum, &pathPrefix, &hasDeps, &hasDeleted, &depsOffset, &deletedOffset, &isLegacy](Str::StringRef filename, offset_t offset, uint32_t crc) {
-			// Note that 'return' is effectively 'continue' since we are in a lambda
+		for (const PakIndexEntry& file: *files) {
+			Str::StringRef filename = file.name;
+			offset_t offset = file.offset;
+			uint32_t crc = file.crc;
+
 			if (!Str::IsPrefix(pathPrefix, filename)
 				&& filename != PAK_DELETED_FILE
 				&& filename != PAK_DEPS_FILE)
-				return;
+				continue;
 			if (Str::IsSuffix("/", filename))
-				return;
+				continue;
 			if (!Path::IsValid(filename, false)) {
 				fsLogs.Warn("Invalid filename '%s' in pak '%s'", filename, pak.path);
-				return;
+				continue;
 			}
 
 			// Legacy paks don't have version neither checksum
@@ -1343,12 +1778,12 @@ static void InternalLoadPak(
 			if (!isLegacy && filename == PAK_DELETED_FILE) {
 				hasDeleted = true;
 				deletedOffset = offset;
-				return;
+				continue;
 			}
 			else if (!isLegacy && filename == PAK_DEPS_FILE) {
 				hasDeps = true;
 				depsOffset = offset;
-				return;
+				continue;
 			}
 
 			if (FileIsDeleted(pak, filename)) {
@@ -1357,9 +1792,14 @@ static void InternalLoadPak(
 			else {
 				fileMap.emplace(filename, std::pair<uint32_t, offset_t>(loadedPaks.size() - 1, offset));
 			}
-		}, err);
-		if (err)
-			return;
+		}
+
+		// The zip is only needed below to read the dependency lists
+		if ((hasDeleted || (loadDeps && hasDeps)) && !zipFile.IsOpen()) {
+			zipFile = ZipArchive::Open(loadedPak.fd, err);
+			if (err)
+				return;
+		}
 	} else {
 		ASSERT_UNREACHABLE();
 	}
@@ -1455,21 +1895,25 @@ static void InternalLoadPak(
 void LoadPak(const PakInfo& pak, std::error_code& err)
 {
 	InternalLoadPak(pak, Util::nullopt, "", true, err);
+	pakIndexCache.Save();
 }
 
 void LoadPakPrefix(const PakInfo& pak, Str::StringRef pathPrefix, std::error_code& err)
 {
 	InternalLoadPak(pak, Util::nullopt, pathPrefix, false, err);
+	pakIndexCache.Save();
 }
 
 void LoadPakExplicit(const PakInfo& pak, uint32_t expectedChecksum, std::error_code& err)
 {
 	InternalLoadPak(pak, expectedChecksum, "", false, err);
+	pakIndexCache.Save();
 }
 
 void LoadPakExplicitWithoutChecksum(const PakInfo& pak, std::error_code& err)
 {
 	InternalLoadPak(pak, {}, "", false, err);
+	pakIndexCache.Save();
 }
 
 void ClearPaks()
@@ -1482,6 +1926,7 @@ void ClearPaks()
 			close(x.fd);
 	}
 	loadedPaks.clear();
+	loadedPakMappings.clear();
 	FS::RefreshPaks();
 }
 #else // BUILD_VM
@@ -1506,33 +1951,99 @@ const std::vector<LoadedPakInfo>& GetLoadedPaks()
 	return loadedPaks;
 }
 
+#ifdef BUILD_ENGINE
+size_t NumPakIndexCacheHits()
+{
+	return pakIndexCacheHits;
+}
+#endif
+
+// View a file read into a string, copying it if its address doesn't have the alignment
+static FileView AlignedFileView(std::string content, size_t alignment)
+{
+	// Check the address after the move, short strings are stored inside the
+	// string object and may be unaligned there
+	FileView view(std::move(content));
+	if (reinterpret_cast<uintptr_t>(view.data()) % alignment == 0)
+		return view;
+
+	std::shared_ptr<char> copy(new char[view.size()], std::default_delete<char[]>());
+	std::copy_n(view.data(), view.size(), copy.get());
+	return FileView(copy, copy.get(), view.size());
+}
+
 #ifdef BUILD_VM
-std::string ReadFile(Str::StringRef path, std::error_code& err) {
+/* Read a pak file from the engine. Small files are sent through the socket
+into inlineContent. Large files are put in shared memory by the engine
+instead, to avoid streaming them through the socket. */
+static void ReadPakFile(Str::StringRef path, std::string& inlineContent, Util::optional<IPC::SharedMemory>& sharedContent, int& length, std::error_code& err)
+{
 	// The VM has a list of all the pak files, so this may save a round trip
 	// if the file doesn't exist, as well as allowing a more specific error.
 	// It may be wrong if more paks are loaded after initialization though?
-	int length, h;
+	int h;
 	VM::SendMsg<VM::FSOpenPakFileReadMsg>(path, length, h);
 	if (!h) {
 		SetErrorCodeFilesystem(err, filesystem_error::no_such_file, path);
-		return "";
+		return;
+	}
+	if (length < VM::FS_SHARED_READ_MIN_SIZE) {
+		int lengthRead;
+		VM::SendMsg<VM::FSReadMsg>(h, length, inlineContent, lengthRead);
+		VM::SendMsg<VM::FSFCloseFileMsg>(h);
+		if (lengthRead != length) {
+			inlineContent.clear();
+			SetErrorCodeFilesystem(err, filesystem_error::io_error, path);
+			return;
+		}
+		ClearErrorCode(err);
+		return;
 	}
-	std::string content;
-	int lengthRead;
-	VM::SendMsg<VM::FSReadMsg>(h, length, content, lengthRead);
 	VM::SendMsg<VM::FSFCloseFileMsg>(h);
-	if (lengthRead != length) {
+
+	VM::SendMsg<VM::FSReadPakFileMsg>(path, length, sharedContent);
+	if (length == -1) {
+		SetErrorCodeFilesystem(err, filesystem_error::no_such_file, path);
+		return;
+	}
+	if (length < 0 || (length && (!sharedContent || sharedContent->GetSize() < static_cast<size_t>(length)))) {
+		sharedContent = Util::nullopt;
 		SetErrorCodeFilesystem(err, filesystem_error::io_error, path);
-		return "";
+		return;
 	}
 	ClearErrorCode(err);
-	return content;
+}
+
+std::string ReadFile(Str::StringRef path, std::error_code& err) {
+	int length;
+	std::string inlineContent;
+	Util::optional<IPC::SharedMemory> sharedContent;
+	ReadPakFile(path, inlineContent, sharedContent, length, err);
+	if (!sharedContent)
+		return inlineContent;
+	return std::string(static_cast<const char*>(sharedContent->GetBase()), length);
+}
+
+FileView ReadFileView(Str::StringRef path, size_t alignment, std::error_code& err)
+{
+	int length;
+	std::string inlineContent;
+	Util::optional<IPC::SharedMemory> sharedContent;
+	ReadPakFile(path, inlineContent, sharedContent, length, err);
+	if (!sharedContent)
+		return AlignedFileView(std::move(inlineContent), alignment);
+
+	// The mapping is page aligned, so any alignment is satisfied
+	auto memory = std::make_shared<const IPC::SharedMemory>(std::move(*sharedContent));
+	return FileView(memory, static_cast<const char*>(memory->GetBase()), length);
 }
 #endif
 
 #ifdef BUILD_ENGINE
 std::string ReadFile(Str::StringRef path, std::error_code& err)
 {
+	PROFILE_ZONE("FS::PakPath::ReadFile");
+
 	auto it = fileMap.find(path);
 	if (it == fileMap.end()) {
 		SetErrorCodeFilesystem(err, filesystem_error::no_such_file, path);
@@ -1557,6 +2068,25 @@ std::string ReadFile(Str::StringRef path, std::error_code& err)
 		file.Read(&out[0], length, err);
 		return out;
 	} else if (pak.type == pakType_t::PAK_ZIP) {
+		// Extract the file from the mapping of the pak if possible
+		ZipMapping::Entry entry;
+		const ZipMapping* mapping = loadedPakMappings[it->second.first].get();
+		if (mapping && mapping->FindEntry(it->second.second, entry)) {
+			std::string out;
+			out.resize(entry.uncompressedSize);
+			if (entry.deflated) {
+				InflateMappedEntry(entry, &out[0], err);
+				if (err)
+					return "";
+			} else {
+				std::copy_n(entry.data, entry.uncompressedSize, out.begin());
+			}
+			CheckMappedEntryCRC(entry, out.data(), err);
+			if (err)
+				return "";
+			return out;
+		}
+
 		// Open zip
 		ZipArchive zipFile = ZipArchive::Open(pak.fd, err);
 		if (err)
@@ -1585,6 +2115,31 @@ std::string ReadFile(Str::StringRef path, std::error_code& err)
 	ASSERT_UNREACHABLE();
 }
 
+FileView ReadFileView(Str::StringRef path, size_t alignment, std::error_code& err)
+{
+	PROFILE_ZONE("FS::PakPath::ReadFileView");
+
+	auto it = fileMap.find(path);
+	if (it != fileMap.end() && loadedPaks[it->second.first].type == pakType_t::PAK_ZIP) {
+		// Point into the mapping for stored files, as long as the caller can use the alignment
+		ZipMapping::Entry entry;
+		const std::shared_ptr<const ZipMapping>& mapping = loadedPakMappings[it->second.first];
+		if (mapping && mapping->FindEntry(it->second.second, entry) && !entry.deflated
+			&& reinterpret_cast<uintptr_t>(entry.data) % alignment == 0) {
+			const char* data = reinterpret_cast<const char*>(entry.data);
+			CheckMappedEntryCRC(entry, data, err);
+			if (err)
+				return FileView();
+			return FileView(mapping, data, entry.uncompressedSize);
+		}
+	}
+
+	std::string content = ReadFile(path, err);
+	if (err)
+		return FileView();
+	return AlignedFileView(std::move(content), alignment);
+}
+
 // Note: Does not handle symlinks.
 void CopyFile(Str::StringRef path, const File& dest, std::error_code& err)
 {
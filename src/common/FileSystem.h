@@ -332,9 +332,50 @@ namespace PakPath {
 	// Get a list of all the loaded paks
 	const std::vector<LoadedPakInfo>& GetLoadedPaks();
 
+#ifdef BUILD_ENGINE
+	// Get the number of zip paks whose file list was read from the pak index cache
+	size_t NumPakIndexCacheHits();
+#endif
+
 	// Read an entire file into a string
 	std::string ReadFile(Str::StringRef path, std::error_code& err = throws());
 
+	// Read-only contents of a file, which remain valid for the lifetime of the
+	// view even if the paks are unloaded in the meantime
+	class FileView {
+	public:
+		FileView() = default;
+		explicit FileView(std::string content)
+		{
+			auto owned = std::make_shared<const std::string>(std::move(content));
+			begin = owned->data();
+			length = owned->size();
+			owner = std::move(owned);
+		}
+		FileView(std::shared_ptr<const void> owner, const char* begin, size_t length)
+			: owner(std::move(owner)), begin(begin), length(length) {}
+
+		const char* data() const
+		{
+			return begin;
+		}
+		size_t size() const
+		{
+			return length;
+		}
+
+	private:
+		std::shared_ptr<const void> owner;
+		const char* begin = "";
+		size_t length = 0;
+	};
+
+	// Read an entire file without copying it if possible: a file stored
+	// uncompressed in a zip pak is viewed directly in the memory mapping of the
+	// pak if its data has the requested alignment. Other files are read like
+	// ReadFile does. The alignment can't exceed alignof(std::max_align_t).
+	FileView ReadFileView(Str::StringRef path, size_t alignment = 1, std::error_code& err = throws());
+
 	// Copy an entire file to another file
 	void CopyFile(Str::StringRef path, const File& dest, std::error_code& err = throws());
 
@@ -62,5 +62,30 @@ namespace {
         ASSERT_EQ(contents, "test2");
     }
 
+    TEST_F(FileSystemTest, FileViewZip)
+    {
+        PakPath::FileView view = PakPath::ReadFileView("test2.txt");
+        ASSERT_EQ(std::string(view.data(), view.size()), "test2");
+
+        PakPath::FileView aligned = PakPath::ReadFileView("test2.txt", alignof(std::max_align_t));
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(aligned.data()) % alignof(std::max_align_t), 0u);
+        ASSERT_EQ(std::string(aligned.data(), aligned.size()), "test2");
+    }
+
+    TEST_F(FileSystemTest, PakIndexCacheReload)
+    {
+        ASSERT_TRUE(HomePath::FileExists("pakindex.cache"));
+
+        // The second load of the dpk gets its file list from the cache
+        size_t hits = PakPath::NumPakIndexCacheHits();
+        PakPath::ClearPaks();
+        for (const char* name : {"testdata", "testdpk"}) {
+            PakPath::LoadPak(*FindPak(name, "src"));
+        }
+        ASSERT_EQ(PakPath::NumPakIndexCacheHits(), hits + 1);
+        ASSERT_EQ(PakPath::ReadFile("TEST2.TXT"), "test2");
+        ASSERT_EQ(PakPath::ReadFile("Test1.txt"), "test1");
+    }
+
 } // namespace
 } // namespace FS
@@ -0,0 +1,124 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+* Neither the name of the Daemon developers nor the
+names of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "Channel.h"
+#include "CommonSyscalls.h"
+
+namespace IPC {
+namespace {
+
+// Shaped like a trace syscall: a handful of small inputs and a struct-sized reply
+using TestMsg = SyncMessage<
+    Message<Id<VM::QVM, 1>, std::array<float, 3>, std::array<float, 3>, int, std::string>,
+    Reply<std::array<float, 8>, int>
+>;
+using QuitMsg = Message<Id<VM::QVM, 2>>;
+
+// Stands in for a VM answering syscalls on the other end of a socket pair.
+void EchoLoop(Socket socket)
+{
+    Channel channel(std::move(socket));
+    bool quit = false;
+    while (!quit) {
+        Util::Reader reader = channel.RecvMsg();
+        uint32_t id = reader.Read<uint32_t>();
+        if (id == QuitMsg::id) {
+            HandleMsg<QuitMsg>(channel, std::move(reader), [&] {
+                quit = true;
+            });
+        } else {
+            HandleMsg<TestMsg>(channel, std::move(reader), [](std::array<float, 3> start, std::array<float, 3> end, int mask, std::string, std::array<float, 8>& result, int& hit) {
+                result = {{start[0], start[1], start[2], end[0], end[1], end[2], 1.0f, 0.0f}};
+                hit = mask;
+            });
+        }
+    }
+}
+
+TEST(ChannelTest, SyscallRoundtrips)
+{
+    std::pair<Socket, Socket> sockets = Socket::CreatePair();
+    std::thread vm(EchoLoop, std::move(sockets.second));
+    Channel channel(std::move(sockets.first));
+    auto handler = [](uint32_t id, Util::Reader) {
+        FAIL() << "Unexpected message " << id;
+    };
+
+    // The buffers are reused from one message to the next
+    for (int i = 0; i < 100; i++) {
+        std::array<float, 8> result;
+        int hit;
+        std::string name(i, 'x');
+        SendMsg<TestMsg>(channel, handler, std::array<float, 3>{{1, 2, float(i)}}, std::array<float, 3>{{4, 5, 6}}, i, name, result, hit);
+        ASSERT_EQ(hit, i);
+        ASSERT_EQ(result[2], float(i));
+        ASSERT_EQ(result[5], 6.0f);
+    }
+    SendMsg<QuitMsg>(channel, handler);
+    vm.join();
+}
+
+TEST(ChannelTest, DISABLED_SyscallRoundtripBenchmark)
+{
+    const int roundtrips = 20000;
+
+    std::pair<Socket, Socket> sockets = Socket::CreatePair();
+    std::thread vm(EchoLoop, std::move(sockets.second));
+    Channel channel(std::move(sockets.first));
+    auto handler = [](uint32_t id, Util::Reader) {
+        FAIL() << "Unexpected message " << id;
+    };
+
+    int sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < roundtrips; i++) {
+        std::array<float, 8> result;
+        int hit;
+        SendMsg<TestMsg>(channel, handler, std::array<float, 3>{{1, 2, 3}}, std::array<float, 3>{{4, 5, 6}}, i, "trace", result, hit);
+        sum += hit - i + int(result[6]);
+    }
+    auto end = std::chrono::steady_clock::now();
+    SendMsg<QuitMsg>(channel, handler);
+    vm.join();
+
+    ASSERT_EQ(sum, roundtrips);
+
+    using seconds = std::chrono::duration<double>;
+    printf("IPC channel: %.0f syscall roundtrips/s\n",
+        roundtrips / std::chrono::duration_cast<seconds>(end - start).count());
+}
+
+} // namespace
+} // namespace IPC
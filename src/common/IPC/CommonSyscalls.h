@@ -96,6 +96,7 @@ namespace VM {
         QVM_COMMON_FS_GET_FILE_LIST_RECURSIVE,
         QVM_COMMON_FS_FIND_PAK,
         QVM_COMMON_FS_LOAD_PAK,
+        QVM_COMMON_FS_READ_PAK_FILE,
     };
 
     using ErrorMsg = IPC::SyncMessage<
@@ -148,6 +149,16 @@ namespace VM {
         IPC::Message<IPC::Id<VM::QVM_COMMON, QVM_COMMON_FS_LOAD_PAK>, std::string, std::string>,
         IPC::Reply<bool>
     >;
+    // Reads a whole pak file into shared memory, so that it isn't copied through the socket.
+    // The length is -1 if the file doesn't exist and -2 if it couldn't be read. The memory
+    // (rounded up to the page size) is only sent for files that aren't empty.
+    // A shared memory object costs a file descriptor and a mapping, so VMs only use this
+    // for files of at least FS_SHARED_READ_MIN_SIZE bytes and read smaller ones inline.
+    constexpr int FS_SHARED_READ_MIN_SIZE = 128 * 1024;
+    using FSReadPakFileMsg = IPC::SyncMessage<
+        IPC::Message<IPC::Id<VM::QVM_COMMON, QVM_COMMON_FS_READ_PAK_FILE>, std::string>,
+        IPC::Reply<int, Util::optional<IPC::SharedMemory>>
+    >;
 
     // Misc Syscall Definitions
 
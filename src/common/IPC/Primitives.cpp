@@ -233,8 +233,9 @@ static void InternalSendMsg(Sys::OSHandle handle, bool more, const FileDesc* han
 		Sys::Drop("IPC: Failed to send message: %s", error);
 	}
 #else
+	// tag + flags + size for each handle, plus the end tag, rounded to 16 bytes
+	unsigned char descBuffer[(NACL_ABI_IMC_DESC_MAX * (1 + sizeof(uint32_t) + sizeof(uint64_t)) + 1 + 0xf) & ~0xf];
 	size_t descBytes = 0;
-	std::unique_ptr<unsigned char[]> descBuffer;
 	if (numHandles != 0) {
 		for (size_t i = 0; i < numHandles; i++) {
 			// tag: 1 byte
@@ -250,7 +251,6 @@ static void InternalSendMsg(Sys::OSHandle handle, bool more, const FileDesc* han
 		// Add 1 byte end tag and round to 16 bytes
 		descBytes = (descBytes + 1 + 0xf) & ~0xf;
 
-		descBuffer.reset(new unsigned char[descBytes]);
 		unsigned char* descBuffer_ptr = &descBuffer[0];
 		for (size_t i = 0; i < numHandles; i++) {
 			*descBuffer_ptr++ = handles[i].type;
@@ -278,7 +278,7 @@ static void InternalSendMsg(Sys::OSHandle handle, bool more, const FileDesc* han
 	hdr.flags = 0;
 	iov[0].base = &internalHdr;
 	iov[0].length = sizeof(NaClInternalHeader);
-	iov[1].base = descBuffer.get();
+	iov[1].base = descBuffer;
 	iov[1].length = descBytes;
 	iov[2].base = &more;
 	iov[2].length = 1;
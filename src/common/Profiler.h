@@ -0,0 +1,101 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#ifndef COMMON_PROFILER_H_
+#define COMMON_PROFILER_H_
+
+/*
+ * A scoped zone profiler for the engine.
+ *
+ * PROFILE_ZONE("name") at the start of a block records when the block is
+ * entered and left, on any thread, with the steady clock's nanosecond
+ * resolution. Zones of a thread nest like the blocks they are in. Each
+ * thread appends to its own buffer, so recording takes no lock.
+ *
+ * Nothing is recorded outside of a capture started with the profileFrames
+ * command. Then a zone only costs a relaxed atomic load. The name must be a
+ * string literal because only the pointer is kept.
+ *
+ * Zones compile to nothing outside of the engine.
+ */
+
+#ifdef BUILD_ENGINE
+
+#include <atomic>
+
+namespace Profiler {
+
+	extern std::atomic<bool> capturing;
+
+	int64_t Now();
+	void RecordZone(const char* name, int64_t start, int64_t end);
+
+	// Starts and ends the captures on frame boundaries, called by Com_Frame
+	// before anything else.
+	void NewFrame();
+
+	class Zone {
+	public:
+		explicit Zone(const char* name)
+			: name(capturing.load(std::memory_order_relaxed) ? name : nullptr), start(0)
+		{
+			if (this->name) {
+				start = Now();
+			}
+		}
+
+		~Zone()
+		{
+			if (name) {
+				RecordZone(name, start, Now());
+			}
+		}
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* name;
+		int64_t start;
+	};
+
+} // namespace Profiler
+
+#define PROFILE_ZONE_CONCAT2(a, b) a ## b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT2(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#endif // BUILD_ENGINE
+
+#endif // COMMON_PROFILER_H_
@@ -71,11 +71,89 @@ namespace Util {
 	// Trait declaration for the serialization trait.
 	template<typename T, typename = void> struct SerializeTraits {};
 
+	namespace detail {
+
+		// Message buffers are recycled through a small per-thread pool so that
+		// sending and receiving IPC messages doesn't allocate in the common case.
+		// Large buffers (e.g. file contents) are not kept around.
+		class BufferPool {
+		public:
+			static const size_t MAX_BUFFERS = 8;
+			static const size_t MAX_BUFFER_SIZE = 64 << 10;
+
+			~BufferPool()
+			{
+				Destroyed() = true;
+			}
+
+			static std::vector<char> Acquire()
+			{
+				BufferPool* pool = Get();
+				if (!pool || pool->count == 0)
+					return {};
+				return std::move(pool->buffers[--pool->count]);
+			}
+
+			static void Release(std::vector<char>& buffer)
+			{
+				if (buffer.capacity() == 0 || buffer.capacity() > MAX_BUFFER_SIZE)
+					return;
+				BufferPool* pool = Get();
+				if (!pool || pool->count == MAX_BUFFERS)
+					return;
+				buffer.clear();
+				pool->buffers[pool->count++] = std::move(buffer);
+			}
+
+		private:
+			// Readers and writers can outlive the pool during static destruction
+			static bool& Destroyed()
+			{
+#ifdef BUILD_ENGINE
+				thread_local
+#endif
+				static bool destroyed = false;
+				return destroyed;
+			}
+
+			static BufferPool* Get()
+			{
+				if (Destroyed())
+					return nullptr;
+#ifdef BUILD_ENGINE
+				thread_local
+#endif
+				static BufferPool pool;
+				return &pool;
+			}
+
+			std::vector<char> buffers[MAX_BUFFERS];
+			size_t count = 0;
+		};
+
+	} // namespace detail
+
 	// Class to generate messages
 	class Writer {
 	public:
+		Writer() = default;
+		Writer(Writer&& other) NOEXCEPT
+			: data(std::move(other.data)), handles(std::move(other.handles)) {}
+		Writer& operator=(Writer&& other) NOEXCEPT
+		{
+			std::swap(data, other.data);
+			std::swap(handles, other.handles);
+			return *this;
+		}
+		~Writer()
+		{
+			detail::BufferPool::Release(data);
+		}
+
 		void WriteData(const void* p, size_t len)
 		{
+			if (data.capacity() == 0)
+				data = detail::BufferPool::Acquire();
 			data.insert(data.end(), static_cast<const char*>(p), static_cast<const char*>(p) + len);
 		}
 		void WriteSize(size_t size)
@@ -133,13 +211,16 @@ namespace Util {
 		Reader()
 			: pos(0), handles_pos(0) {}
 		Reader(Reader&& other) NOEXCEPT
-			: data(std::move(other.data)), handles(std::move(other.handles)), pos(other.pos), handles_pos(other.handles_pos) {}
+			: data(std::move(other.data)), handles(std::move(other.handles)), pos(other.pos), handles_pos(other.handles_pos),
+			  view(other.view), viewSize(other.viewSize) {}
 		Reader& operator=(Reader&& other) NOEXCEPT
 		{
 			std::swap(data, other.data);
 			std::swap(handles, other.handles);
 			std::swap(pos, other.pos);
 			std::swap(handles_pos, other.handles_pos);
+			std::swap(view, other.view);
+			std::swap(viewSize, other.viewSize);
 			return *this;
 		}
 		~Reader()
@@ -147,6 +228,7 @@ namespace Util {
 			// Close any handles that weren't read
 			for (size_t i = handles_pos; i < handles.size(); i++)
 				handles[i].Close();
+			detail::BufferPool::Release(data);
 		}
 
 		void ReadData(void* p, size_t len)
@@ -154,8 +236,8 @@ namespace Util {
 			if (!len)
 				return; // ensure null is never passed to memcpy
 
-			if (pos + len <= data.size()) {
-				memcpy(p, data.data() + pos, len);
+			if (pos + len <= Size()) {
+				memcpy(p, Begin() + pos, len);
 				pos += len;
 			} else
 				Sys::Drop("IPC: Unexpected end of message");
@@ -171,8 +253,8 @@ namespace Util {
 		}
 		const void* ReadInline(size_t len)
 		{
-			if (pos + len <= data.size()) {
-				const void* out = data.data() + pos;
+			if (pos + len <= Size()) {
+				const void* out = Begin() + pos;
 				pos += len;
 				return out;
 			} else
@@ -203,7 +285,7 @@ namespace Util {
 
 		void CheckEndRead()
 		{
-			if (pos != data.size())
+			if (pos != Size())
 				Sys::Drop("Reader: Unread bytes at end of message");
 			if (handles_pos != handles.size())
 				Sys::Drop("Reader: Unread handles at end of message");
@@ -211,6 +293,8 @@ namespace Util {
 
 		std::vector<char>& GetData()
 		{
+			if (data.capacity() == 0)
+				data = detail::BufferPool::Acquire();
 			return data;
 		}
 		std::vector<IPC::FileDesc>& GetHandles()
@@ -218,11 +302,33 @@ namespace Util {
 			return handles;
 		}
 
+		// Deserialize from an external buffer instead of the reader's own data,
+		// avoiding a copy. The buffer must stay valid and unchanged until reading
+		// is done; ReadInline hands out pointers into it, so memory another
+		// process can write to must be copied first.
+		void SetView(const char* p, size_t len)
+		{
+			view = p;
+			viewSize = len;
+			pos = 0;
+		}
+
 	private:
+		const char* Begin() const
+		{
+			return view ? view : data.data();
+		}
+		size_t Size() const
+		{
+			return view ? viewSize : data.size();
+		}
+
 		std::vector<char> data;
 		std::vector<IPC::FileDesc> handles;
 		size_t pos;
 		size_t handles_pos;
+		const char* view = nullptr;
+		size_t viewSize = 0;
 	};
 
 	// Implementation of the serialization traits for common types and std containers
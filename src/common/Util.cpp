@@ -54,4 +54,50 @@ void UpdateFPSCounter(float halfLife, int frameMs, float& fps)
 	}
 }
 
+SortKey* RadixSort(SortKey* keys, SortKey* scratch, size_t count)
+{
+	if (count < RADIX_SORT_MIN_COUNT) {
+		std::stable_sort(keys, keys + count, [](const SortKey& a, const SortKey& b) {
+			return a.key < b.key;
+		});
+		return keys;
+	}
+
+	// count the digits of all the passes at once
+	static_assert(sizeof(SortKey::key) == 8, "one pass per byte of the key");
+	size_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = keys[i].key;
+		for (int pass = 0; pass < 8; pass++) {
+			histograms[pass][(key >> (8 * pass)) & 0xff]++;
+		}
+	}
+
+	SortKey* from = keys;
+	SortKey* to = scratch;
+	for (int pass = 0; pass < 8; pass++) {
+		int shift = 8 * pass;
+		size_t* offsets = histograms[pass];
+
+		// all the keys have the same digit, the pass would not move anything
+		if (offsets[(from[0].key >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			size_t digitCount = offsets[digit];
+			offsets[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			to[offsets[(from[i].key >> shift) & 0xff]++] = from[i];
+		}
+		std::swap(from, to);
+	}
+
+	return from;
+}
+
 } // namespace Util
@@ -191,6 +191,22 @@ std::unique_ptr<T> make_unique(U&&... args)
 // latest frame began at the same time the previous one ended.
 void UpdateFPSCounter(float halfLife, int frameMs, float& fps);
 
+// A sort key and the position of the item it was taken from, see RadixSort.
+struct SortKey {
+	uint64_t key;
+	uint32_t index;
+};
+
+// Below this count the histograms of RadixSort cost more than a comparison sort
+constexpr size_t RADIX_SORT_MIN_COUNT = 1024;
+
+// Stable LSD radix sort of the keys, one byte per pass. Passes over a byte
+// which is the same in all the keys are skipped, so keys using few bits are
+// cheap. scratch must have room for count keys. Returns the buffer holding
+// the sorted keys, which is either keys or scratch; the items can then be
+// gathered with the indexes.
+SortKey* RadixSort(SortKey* keys, SortKey* scratch, size_t count);
+
 } // namespace Util
 
 #endif // COMMON_UTIL_H_
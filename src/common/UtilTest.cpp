@@ -28,6 +28,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ===========================================================================
 */
 
+#include <chrono>
+#include <random>
+
 #include <gtest/gtest.h>
 
 #include "Util.h"
@@ -75,5 +78,127 @@ namespace Util {
 			// 0.5 * 60 + 0.5 * 2
 			EXPECT_FLOAT_EQ(31, counter);
 		}
+
+		// Keys laid out like the renderer's drawSurf_t::sort: 16 index bits,
+		// 10 entity bits, 9 lightmap bits and the shader above them. Few
+		// shaders and entities per view, so that there are runs of equal bits.
+		std::vector<SortKey> DrawSurfKeys(std::mt19937& rng, int count)
+		{
+			std::uniform_int_distribution<uint64_t> shader(0, 300), lightmap(0, 40), entity(0, 200);
+			std::vector<SortKey> keys(count);
+			for (int i = 0; i < count; i++) {
+				uint64_t index = i & 0xffff;
+				keys[i] = { (shader(rng) << 35) | (lightmap(rng) << 26) | (entity(rng) << 16) | index, uint32_t(i) };
+			}
+			return keys;
+		}
+
+		std::vector<SortKey> StableSorted(std::vector<SortKey> keys)
+		{
+			std::stable_sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) {
+				return a.key < b.key;
+			});
+			return keys;
+		}
+
+		void ExpectSameOrder(const std::vector<SortKey>& expected, const SortKey* sorted)
+		{
+			for (size_t i = 0; i < expected.size(); i++) {
+				ASSERT_EQ(expected[i].key, sorted[i].key) << "at " << i;
+				ASSERT_EQ(expected[i].index, sorted[i].index) << "at " << i;
+			}
+		}
+
+		TEST(RadixSortTest, MatchesStableSort)
+		{
+			std::mt19937 rng(1234);
+			for (int count : {0, 1, 2, 17, 1000, 1024, 3000, 65536}) {
+				SCOPED_TRACE(count);
+				std::vector<SortKey> keys = DrawSurfKeys(rng, count), scratch(count);
+				std::vector<SortKey> expected = StableSorted(keys);
+				ExpectSameOrder(expected, RadixSort(keys.data(), scratch.data(), count));
+			}
+		}
+
+		TEST(RadixSortTest, StableWithEqualKeys)
+		{
+			std::mt19937 rng(5678);
+			std::uniform_int_distribution<uint64_t> value(0, 7);
+			std::vector<SortKey> keys(5000), scratch(keys.size());
+			for (size_t i = 0; i < keys.size(); i++) {
+				// the same few keys in the low and the high byte
+				uint64_t v = value(rng);
+				keys[i] = { v | (v << 56), uint32_t(i) };
+			}
+			std::vector<SortKey> expected = StableSorted(keys);
+			ExpectSameOrder(expected, RadixSort(keys.data(), scratch.data(), keys.size()));
+		}
+
+		TEST(RadixSortTest, AlreadySortedAndConstantKeys)
+		{
+			std::vector<SortKey> keys(3000), scratch(keys.size());
+			for (size_t i = 0; i < keys.size(); i++) {
+				keys[i] = { 42, uint32_t(i) };
+			}
+			// no pass is needed, the input is returned as is
+			ASSERT_EQ(keys.data(), RadixSort(keys.data(), scratch.data(), keys.size()));
+			ExpectSameOrder(StableSorted(keys), keys.data());
+		}
+
+		// Sorting drawSurf_t-sized items with std::sort, against radix sorting
+		// the keys then gathering the items, like R_SortDrawSurfs.
+		TEST(RadixSortTest, DISABLED_DrawSurfBenchmark)
+		{
+			struct Item {
+				void* pointers[3];
+				uint64_t sort;
+				int extra[4];
+			};
+
+			using Clock = std::chrono::steady_clock;
+			std::mt19937 rng(9012);
+			for (int count : {500, 4000, 20000, 65536}) {
+				std::vector<SortKey> keys = DrawSurfKeys(rng, count);
+				std::vector<Item> items(count);
+				for (int i = 0; i < count; i++) {
+					items[i].sort = keys[i].key;
+				}
+
+				const int rounds = std::max(4, 2000000 / count);
+				std::vector<Item> work(count), unsorted(count);
+				std::vector<SortKey> sortKeys(count), scratch(count);
+
+				Clock::duration stdTime{}, radixTime{};
+				for (int n = 0; n < rounds; n++) {
+					work = items;
+					Clock::time_point start = Clock::now();
+					std::sort(work.begin(), work.end(), [](const Item& a, const Item& b) {
+						return a.sort < b.sort;
+					});
+					stdTime += Clock::now() - start;
+
+					work = items;
+					start = Clock::now();
+					for (int i = 0; i < count; i++) {
+						sortKeys[i] = { work[i].sort, uint32_t(i) };
+					}
+					const SortKey* sorted = RadixSort(sortKeys.data(), scratch.data(), count);
+					unsorted.assign(work.begin(), work.end());
+					for (int i = 0; i < count; i++) {
+						work[i] = unsorted[sorted[i].index];
+					}
+					radixTime += Clock::now() - start;
+
+					for (int i = 1; i < count; i++) {
+						ASSERT_LE(work[i - 1].sort, work[i].sort);
+					}
+				}
+
+				auto perSort = [rounds](Clock::duration time) {
+					return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count() / 1000.0 / rounds;
+				};
+				printf("%d surfaces: std::sort %.1f us, radix sort %.1f us\n", count, perSort(stdTime), perSort(radixTime));
+			}
+		}
 	} // namespace
 } // namespace Util
@@ -47,8 +47,8 @@ static const int BOX_PLANES       = 12;
 #define LL( x ) x = LittleLong( x )
 
 clipMap_t cm;
-int       c_pointcontents;
-int       c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
+std::atomic<int> c_pointcontents;
+std::atomic<int> c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
 
 static cmodel_t  box_model;
 static cplane_t  *box_planes;
@@ -769,7 +769,8 @@ void CM_LoadMap(Str::StringRef name)
 	std::string mapFile = "maps/" + name + ".bsp";
 
 	std::error_code err;
-	std::string mapData = FS::PakPath::ReadFile(mapFile, err);
+	// The lumps are only read, so the map can be used in place if stored in a pak
+	FS::PakPath::FileView mapData = FS::PakPath::ReadFileView(mapFile, alignof(int), err);
 	if (err) {
 		Sys::Drop("Could not load %s: %s (code: %d)", mapFile.c_str(), err.message(), err.value() );
 	}
@@ -797,7 +798,7 @@ void CM_LoadMap(Str::StringRef name)
 		return;
 	}
 
-	header = * ( dheader_t * ) mapData.data();
+	header = * ( const dheader_t * ) mapData.data();
 
 	for (unsigned i = 0; i < sizeof( dheader_t ) / 4; i++ )
 	{
@@ -888,6 +889,11 @@ int CM_NumInlineModels()
 	return cm.numSubModels;
 }
 
+int CM_NumClusters()
+{
+	return cm.numClusters;
+}
+
 char           *CM_EntityString()
 {
 	return cm.entityString;
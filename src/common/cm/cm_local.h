@@ -80,7 +80,6 @@ struct cbrush_t
 	vec3_t       bounds[ 2 ];
 	int          numsides;
 	cbrushside_t *sides;
-	int          checkcount; // to avoid repeated testings
 };
 
 struct cPlane_t
@@ -139,7 +138,6 @@ struct cSurfaceCollide_t
 
 struct cSurface_t
 {
-	int               checkcount; // to avoid repeated testings
 	int               surfaceFlags;
 	int               contents;
 	cSurfaceCollide_t *sc;
@@ -197,7 +195,6 @@ struct clipMap_t
 	cSurface_t   **surfaces; // non-patches will be nullptr
 
 	int          floodvalid;
-	int          checkcount; // incremented on each trace
 	bool     perPolyCollision;
 };
 
@@ -214,8 +211,8 @@ struct clipMap_t
 #define SURFACE_CLIP_EPSILON ( 0.125f )
 
 extern clipMap_t cm;
-extern int       c_pointcontents;
-extern int       c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
+extern std::atomic<int> c_pointcontents;
+extern std::atomic<int> c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
 extern Cvar::Cvar<bool> cm_forceTriangles;
 extern Log::Logger cmLog;
 
@@ -245,6 +242,9 @@ struct traceWork_t
 	bool    isPoint; // optimized case
 	trace_t     trace; // returned from trace call
 	sphere_t    sphere; // sphere for oriendted capsule collision
+	cmTraceContext_t *context; // avoids testing a brush or surface twice
+	uint32_t    rayBit; // identifies the trace in a batch
+	int         brushTraces, patchTraces, trisoupTraces; // for statistics
 };
 
 struct leafList_t
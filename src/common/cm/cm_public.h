@@ -32,6 +32,9 @@ Maryland 20850 USA.
 ===========================================================================
 */
 
+#ifndef COMMON_CM_PUBLIC_H_
+#define COMMON_CM_PUBLIC_H_
+
 #include "engine/qcommon/q_shared.h"
 
 void         CM_LoadMap(Str::StringRef name);
@@ -49,6 +52,26 @@ char         *CM_EntityString();
 int          CM_PointContents( const vec3_t p, clipHandle_t model );
 int          CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles );
 
+// Per caller state of traces: traces using different contexts may run concurrently,
+// as long as the map is not loaded or cleared meanwhile. CM_TempBoxModel is not
+// covered and must only be used from the main thread.
+struct cmTraceContext_t
+{
+	int                   checkcount = 0; // incremented on each trace or batch of traces
+	std::vector<int>      brushChecks; // checkcount of the last trace that tested each brush
+	std::vector<int>      surfaceChecks;
+	std::vector<uint32_t> brushRays; // traces of the batch that tested each brush, one bit each
+	std::vector<uint32_t> surfaceRays;
+};
+
+// one of the traces of CM_BoxTraces
+struct boxTrace_t
+{
+	vec3_t start, end;
+	vec3_t mins, maxs;
+};
+
+// these use a context local to the calling thread
 void         CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins,
                           const vec3_t maxs, clipHandle_t model, int brushmask, int skipmask,
                           traceType_t type );
@@ -56,10 +79,28 @@ void         CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const
                                      const vec3_t mins, const vec3_t maxs, clipHandle_t model,
                                      int brushmask, int skipmask, const vec3_t origin,
                                      const vec3_t angles, traceType_t type );
+void         CM_BoxTrace( cmTraceContext_t &context, trace_t *results, const vec3_t start, const vec3_t end,
+                          const vec3_t mins, const vec3_t maxs, clipHandle_t model, int brushmask,
+                          int skipmask, traceType_t type );
+void         CM_TransformedBoxTrace( cmTraceContext_t &context, trace_t *results, const vec3_t start,
+                                     const vec3_t end, const vec3_t mins, const vec3_t maxs,
+                                     clipHandle_t model, int brushmask, int skipmask,
+                                     const vec3_t origin, const vec3_t angles, traceType_t type );
+
+// Same results as calling CM_BoxTrace for each trace, but sweeps through the BSP tree
+// once for a batch of traces and tests brushes against several traces at a time.
+// The gamelogic links the collision model in-process, so a VM can batch its traces
+// (e.g. bot sensing or missile sweeps) without any syscall.
+void         CM_BoxTraces( cmTraceContext_t &context, trace_t *results, const boxTrace_t *traces,
+                           int numTraces, clipHandle_t model, int brushmask, int skipmask,
+                           traceType_t type );
+void         CM_BoxTraces( trace_t *results, const boxTrace_t *traces, int numTraces, clipHandle_t model,
+                           int brushmask, int skipmask, traceType_t type );
 std::string CM_CheckTraceConsistency( const vec3_t start, const vec3_t end, int contentmask, int skipmask, const trace_t &tr );
 
 float CM_DistanceToModel( const vec3_t loc, clipHandle_t model );
 
+int   CM_NumClusters();
 byte *CM_ClusterPVS( int cluster );
 
 int  CM_PointLeafnum( const vec3_t p );
@@ -79,3 +120,5 @@ int      CM_WriteAreaBits( byte *buffer, int area );
 // cm_marks.c
 int      CM_MarkFragments( int numPoints, const vec3_t *points, const vec3_t projection,
                            int maxPoints, vec3_t pointBuffer, int maxFragments, markFragment_t *fragmentBuffer );
+
+#endif // COMMON_CM_PUBLIC_H_
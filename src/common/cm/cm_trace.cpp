@@ -35,6 +35,7 @@ Maryland 20850 USA.
 #include "cm_local.h"
 
 #include "cm_patch.h"
+#include "common/Profiler.h"
 
 // always use bbox vs. bbox collision and never capsule vs. bbox or vice versa
 //#define ALWAYS_BBOX_VS_BBOX
@@ -360,6 +361,30 @@ static bool CM_PositionTestInSurfaceCollide( traceWork_t *tw, const cSurfaceColl
 	return false;
 }
 
+/*
+================
+CM_MarkVisited
+
+Marks a brush or surface as tested by the trace, returns false if it already was
+================
+*/
+static bool CM_MarkVisited( const traceWork_t *tw, int &checkcount, uint32_t &rays )
+{
+	if ( checkcount != tw->context->checkcount )
+	{
+		checkcount = tw->context->checkcount;
+		rays = 0;
+	}
+
+	if ( rays & tw->rayBit )
+	{
+		return false;
+	}
+
+	rays |= tw->rayBit;
+	return true;
+}
+
 /*
 ================
 CM_TestInLeaf
@@ -374,13 +399,11 @@ void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf )
 	{
 		cbrush_t *b = &cm.brushes[ *brushNum ];
 
-		if ( b->checkcount == cm.checkcount )
+		if ( !CM_MarkVisited( tw, tw->context->brushChecks[ *brushNum ], tw->context->brushRays[ *brushNum ] ) )
 		{
 			continue; // already checked this brush in another leaf
 		}
 
-		b->checkcount = cm.checkcount;
-
 		if ( !( b->contents & tw->contents ) )
 		{
 			continue;
@@ -411,13 +434,11 @@ void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf )
 			continue;
 		}
 
-		if ( surface->checkcount == cm.checkcount )
+		if ( !CM_MarkVisited( tw, tw->context->surfaceChecks[ *surfaceNum ], tw->context->surfaceRays[ *surfaceNum ] ) )
 		{
 			continue; // already checked this surface in another leaf
 		}
 
-		surface->checkcount = cm.checkcount;
-
 		if ( !( surface->contents & tw->contents ) )
 		{
 			continue;
@@ -633,12 +654,8 @@ void CM_PositionTest( traceWork_t *tw )
 	ll.lastLeaf = 0;
 	ll.overflowed = false;
 
-	cm.checkcount++;
-
 	CM_BoxLeafnums_r( &ll, 0 );
 
-	cm.checkcount++;
-
 	// test the contents of the leafs
 	for ( i = 0; i < ll.count; i++ )
 	{
@@ -668,8 +685,8 @@ CM_TracePointThroughSurfaceCollide
 */
 void CM_TracePointThroughSurfaceCollide( traceWork_t *tw, const cSurfaceCollide_t *sc )
 {
-	static bool frontFacing[ SHADER_MAX_TRIANGLES ];
-	static float    intersection[ SHADER_MAX_TRIANGLES ];
+	static thread_local bool frontFacing[ SHADER_MAX_TRIANGLES ];
+	static thread_local float intersection[ SHADER_MAX_TRIANGLES ];
 	float           intersect;
 	const cPlane_t  *planes;
 	const cFacet_t  *facet;
@@ -1008,13 +1025,13 @@ void CM_TraceThroughSurface( traceWork_t *tw, const cSurface_t *surface )
 	if ( !cm_noCurves.Get() && surface->type == mapSurfaceType_t::MST_PATCH && surface->sc )
 	{
 		CM_TraceThroughSurfaceCollide( tw, surface->sc );
-		c_patch_traces++;
+		tw->patchTraces++;
 	}
 
 	if ( ( cm.perPolyCollision || cm_forceTriangles.Get() ) && surface->type == mapSurfaceType_t::MST_TRIANGLE_SOUP && surface->sc )
 	{
 		CM_TraceThroughSurfaceCollide( tw, surface->sc );
-		c_trisoup_traces++;
+		tw->trisoupTraces++;
 	}
 
 	if ( tw->trace.fraction < oldFrac )
@@ -1048,7 +1065,7 @@ void CM_TraceThroughBrush( traceWork_t *tw, const cbrush_t *brush )
 		return;
 	}
 
-	c_brush_traces++;
+	tw->brushTraces++;
 
 	getout = false;
 	startout = false;
@@ -1261,95 +1278,101 @@ void CM_TraceThroughBrush( traceWork_t *tw, const cbrush_t *brush )
 
 /*
 ================
-CM_TraceThroughLeaf
+CM_TraceThroughLeafSurfaces
 ================
 */
-void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf )
+static void CM_TraceThroughLeafSurfaces( traceWork_t *tw, const cLeaf_t *leaf )
 {
-	// trace line against all brushes in the leaf
-	const int *firstBrushNum = leaf->firstLeafBrush;
-	const int *endBrushNum = firstBrushNum + leaf->numLeafBrushes;
-	for ( const int *brushNum = firstBrushNum; brushNum < endBrushNum; brushNum++ )
+	// trace line against all surfaces in the leaf
+	const int *firstSurfaceNum = leaf->firstLeafSurface;
+	const int *endSurfaceNum = firstSurfaceNum + leaf->numLeafSurfaces;
+	for ( const int *surfaceNum = firstSurfaceNum; surfaceNum < endSurfaceNum; surfaceNum++ )
 	{
-		cbrush_t *b = &cm.brushes[ *brushNum ];
+		cSurface_t *surface = cm.surfaces[ *surfaceNum ];
 
-		if ( b->checkcount == cm.checkcount )
+		if ( !surface )
 		{
-			continue; // already checked this brush in another leaf
+			continue;
 		}
 
-		b->checkcount = cm.checkcount;
+		if ( !CM_MarkVisited( tw, tw->context->surfaceChecks[ *surfaceNum ], tw->context->surfaceRays[ *surfaceNum ] ) )
+		{
+			continue; // already checked this surface in another leaf
+		}
 
-		if ( !( b->contents & tw->contents ) )
+		if ( !( surface->contents & tw->contents ) )
 		{
 			continue;
 		}
 
-		if ( b->contents & tw->skipContents )
+		if ( surface->contents & tw->skipContents )
 		{
 			continue;
 		}
 
-		if ( !CM_BoundsIntersect( tw->bounds[ 0 ], tw->bounds[ 1 ], b->bounds[ 0 ], b->bounds[ 1 ] ) )
+		if ( !CM_BoundsIntersect( tw->bounds[ 0 ], tw->bounds[ 1 ], surface->sc->bounds[ 0 ], surface->sc->bounds[ 1 ] ) )
 		{
 			continue;
 		}
 
-		CM_TraceThroughBrush( tw, b );
+		CM_TraceThroughSurface( tw, surface );
 
-		if ( tw->trace.allsolid )
+		if ( !tw->trace.fraction )
 		{
 			return;
 		}
 	}
+}
 
-	// CM_TraceThroughSurface does not set startsolid/allsolid so 0 fraction is the most we'll know
-	if ( !tw->trace.fraction )
-	{
-		return;
-	}
-
-	// trace line against all surfaces in the leaf
-	const int *firstSurfaceNum = leaf->firstLeafSurface;
-	const int *endSurfaceNum = firstSurfaceNum + leaf->numLeafSurfaces;
-	for ( const int *surfaceNum = firstSurfaceNum; surfaceNum < endSurfaceNum; surfaceNum++ )
+/*
+================
+CM_TraceThroughLeaf
+================
+*/
+void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf )
+{
+	// trace line against all brushes in the leaf
+	const int *firstBrushNum = leaf->firstLeafBrush;
+	const int *endBrushNum = firstBrushNum + leaf->numLeafBrushes;
+	for ( const int *brushNum = firstBrushNum; brushNum < endBrushNum; brushNum++ )
 	{
-		cSurface_t *surface = cm.surfaces[ *surfaceNum ];
-
-		if ( !surface )
-		{
-			continue;
-		}
+		cbrush_t *b = &cm.brushes[ *brushNum ];
 
-		if ( surface->checkcount == cm.checkcount )
+		if ( !CM_MarkVisited( tw, tw->context->brushChecks[ *brushNum ], tw->context->brushRays[ *brushNum ] ) )
 		{
-			continue; // already checked this surface in another leaf
+			continue; // already checked this brush in another leaf
 		}
 
-		surface->checkcount = cm.checkcount;
-
-		if ( !( surface->contents & tw->contents ) )
+		if ( !( b->contents & tw->contents ) )
 		{
 			continue;
 		}
 
-		if ( surface->contents & tw->skipContents )
+		if ( b->contents & tw->skipContents )
 		{
 			continue;
 		}
 
-		if ( !CM_BoundsIntersect( tw->bounds[ 0 ], tw->bounds[ 1 ], surface->sc->bounds[ 0 ], surface->sc->bounds[ 1 ] ) )
+		if ( !CM_BoundsIntersect( tw->bounds[ 0 ], tw->bounds[ 1 ], b->bounds[ 0 ], b->bounds[ 1 ] ) )
 		{
 			continue;
 		}
 
-		CM_TraceThroughSurface( tw, surface );
+		CM_TraceThroughBrush( tw, b );
 
-		if ( !tw->trace.fraction )
+		if ( tw->trace.allsolid )
 		{
 			return;
 		}
 	}
+
+	// CM_TraceThroughSurface does not set startsolid/allsolid so 0 fraction is the most we'll know
+	if ( !tw->trace.fraction )
+	{
+		return;
+	}
+
+	CM_TraceThroughLeafSurfaces( tw, leaf );
 }
 
 static const float RADIUS_EPSILON = 1.0f;
@@ -1838,36 +1861,68 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 
 /*
 ==================
-CM_Trace
+CM_BeginTrace
+
+Starts a new generation of the context, for multi-check avoidance
 ==================
 */
-static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins,
-                      const vec3_t maxs, clipHandle_t model, const vec3_t origin, int brushmask,
-                      int skipmask, traceType_t type, const sphere_t *sphere )
+static void CM_BeginTrace( cmTraceContext_t &context )
 {
-	int         i;
-	vec3_t      offset;
-	cmodel_t    *cmod;
+	// one more for the temporary box brush
+	size_t numBrushes = cm.numBrushes + 1;
+	size_t numSurfaces = cm.numSurfaces;
 
-	cmod = CM_ClipHandleToModel( model );
+	if ( context.brushChecks.size() < numBrushes || context.surfaceChecks.size() < numSurfaces
+	     || context.checkcount == std::numeric_limits<int>::max() )
+	{
+		context.brushChecks.assign( std::max( numBrushes, context.brushChecks.size() ), 0 );
+		context.surfaceChecks.assign( std::max( numSurfaces, context.surfaceChecks.size() ), 0 );
+		context.brushRays.resize( context.brushChecks.size() );
+		context.surfaceRays.resize( context.surfaceChecks.size() );
+		context.checkcount = 0;
+	}
 
-	cm.checkcount++; // for multi-check avoidance
+	context.checkcount++;
+}
 
-	c_traces++; // for statistics, may be zeroed
+/*
+==================
+CM_EndTrace
 
-	// fill in a default trace
-	traceWork_t tw{};
-	tw.trace.fraction = 1; // assume it goes the entire distance until shown otherwise
-	VectorCopy( origin, tw.modelOrigin );
-	tw.type = type;
+Adds the statistics of a trace to the global counters
+==================
+*/
+static void CM_EndTrace( const traceWork_t &tw )
+{
+	c_traces.fetch_add( 1, std::memory_order_relaxed ); // for statistics, may be zeroed
 
-	if ( !cm.numNodes )
+	if ( tw.brushTraces )
 	{
-		*results = tw.trace;
+		c_brush_traces.fetch_add( tw.brushTraces, std::memory_order_relaxed );
+	}
 
-		return; // map not loaded, shouldn't happen
+	if ( tw.patchTraces )
+	{
+		c_patch_traces.fetch_add( tw.patchTraces, std::memory_order_relaxed );
 	}
 
+	if ( tw.trisoupTraces )
+	{
+		c_trisoup_traces.fetch_add( tw.trisoupTraces, std::memory_order_relaxed );
+	}
+}
+
+/*
+==================
+CM_SetupTrace
+==================
+*/
+static void CM_SetupTrace( traceWork_t &tw, const vec3_t start, const vec3_t end, const vec3_t mins,
+                           const vec3_t maxs, int brushmask, int skipmask, const sphere_t *sphere )
+{
+	int    i;
+	vec3_t offset;
+
 	// allow nullptr to be passed in for 0,0,0
 	if ( !mins )
 	{
@@ -1990,6 +2045,87 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 			}
 		}
 	}
+}
+
+/*
+==================
+CM_SetupSweep
+
+Prepares a trace that is not a position test
+==================
+*/
+static void CM_SetupSweep( traceWork_t &tw )
+{
+	//
+	// check for point special case
+	//
+	if ( tw.size[ 0 ][ 0 ] == 0 && tw.size[ 0 ][ 1 ] == 0 && tw.size[ 0 ][ 2 ] == 0 )
+	{
+		tw.isPoint = true;
+		VectorClear( tw.extents );
+	}
+	else
+	{
+		tw.isPoint = false;
+		tw.extents[ 0 ] = tw.size[ 1 ][ 0 ];
+		tw.extents[ 1 ] = tw.size[ 1 ][ 1 ];
+		tw.extents[ 2 ] = tw.size[ 1 ][ 2 ];
+	}
+}
+
+/*
+==================
+CM_FinishTrace
+==================
+*/
+static void CM_FinishTrace( traceWork_t &tw, const vec3_t start, const vec3_t end, trace_t *results )
+{
+	// generate endpos from the original, unmodified start/end
+	if ( tw.trace.fraction == 1 )
+	{
+		VectorCopy( end, tw.trace.endpos );
+	}
+	else
+	{
+		VectorLerp( start, end, tw.trace.fraction, tw.trace.endpos );
+	}
+
+	CM_EndTrace( tw );
+
+	*results = tw.trace;
+}
+
+/*
+==================
+CM_Trace
+==================
+*/
+static void CM_Trace( cmTraceContext_t &context, trace_t *results, const vec3_t start, const vec3_t end,
+                      const vec3_t mins, const vec3_t maxs, clipHandle_t model, const vec3_t origin,
+                      int brushmask, int skipmask, traceType_t type, const sphere_t *sphere )
+{
+	cmodel_t    *cmod;
+
+	cmod = CM_ClipHandleToModel( model );
+
+	// fill in a default trace
+	traceWork_t tw{};
+	tw.trace.fraction = 1; // assume it goes the entire distance until shown otherwise
+	VectorCopy( origin, tw.modelOrigin );
+	tw.type = type;
+
+	if ( !cm.numNodes )
+	{
+		*results = tw.trace;
+
+		return; // map not loaded, shouldn't happen
+	}
+
+	CM_BeginTrace( context );
+	tw.context = &context;
+	tw.rayBit = 1;
+
+	CM_SetupTrace( tw, start, end, mins, maxs, brushmask, skipmask, sphere );
 
 	//
 	// check for position test special case
@@ -2036,21 +2172,7 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 	}
 	else
 	{
-		//
-		// check for point special case
-		//
-		if ( tw.size[ 0 ][ 0 ] == 0 && tw.size[ 0 ][ 1 ] == 0 && tw.size[ 0 ][ 2 ] == 0 )
-		{
-			tw.isPoint = true;
-			VectorClear( tw.extents );
-		}
-		else
-		{
-			tw.isPoint = false;
-			tw.extents[ 0 ] = tw.size[ 1 ][ 0 ];
-			tw.extents[ 1 ] = tw.size[ 1 ][ 1 ];
-			tw.extents[ 2 ] = tw.size[ 1 ][ 2 ];
-		}
+		CM_SetupSweep( tw );
 
 		//
 		// general sweeping through world
@@ -2094,17 +2216,13 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 		}
 	}
 
-	// generate endpos from the original, unmodified start/end
-	if ( tw.trace.fraction == 1 )
-	{
-		VectorCopy( end, tw.trace.endpos );
-	}
-	else
-	{
-		VectorLerp( start, end, tw.trace.fraction, tw.trace.endpos );
-	}
+	CM_FinishTrace( tw, start, end, results );
+}
 
-	*results = tw.trace;
+static cmTraceContext_t &CM_ThreadTraceContext()
+{
+	static thread_local cmTraceContext_t context;
+	return context;
 }
 
 /*
@@ -2112,10 +2230,18 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 CM_BoxTrace
 ==================
 */
+void CM_BoxTrace( cmTraceContext_t &context, trace_t *results, const vec3_t start, const vec3_t end,
+                  const vec3_t mins, const vec3_t maxs, clipHandle_t model, int brushmask,
+                  int skipmask, traceType_t type )
+{
+	PROFILE_ZONE( "CM_BoxTrace" );
+	CM_Trace( context, results, start, end, mins, maxs, model, vec3_origin, brushmask, skipmask, type, nullptr );
+}
+
 void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
                   clipHandle_t model, int brushmask, int skipmask, traceType_t type )
 {
-	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, skipmask, type, nullptr );
+	CM_BoxTrace( CM_ThreadTraceContext(), results, start, end, mins, maxs, model, brushmask, skipmask, type );
 }
 
 /*
@@ -2126,11 +2252,13 @@ Handles offseting and rotation of the end points for moving and
 rotating entities
 ==================
 */
-void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
-                             const vec3_t mins, const vec3_t maxs, clipHandle_t model,
-                             int brushmask, int skipmask, const vec3_t origin, const vec3_t angles,
-                             traceType_t type )
+void CM_TransformedBoxTrace( cmTraceContext_t &context, trace_t *results, const vec3_t start,
+                             const vec3_t end, const vec3_t mins, const vec3_t maxs,
+                             clipHandle_t model, int brushmask, int skipmask,
+                             const vec3_t origin, const vec3_t angles, traceType_t type )
 {
+	PROFILE_ZONE( "CM_TransformedBoxTrace" );
+
 	trace_t  trace;
 	vec3_t   start_l, end_l;
 	bool rotated;
@@ -2220,7 +2348,7 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	}
 
 	// sweep the box through the model
-	CM_Trace( &trace, start_l, end_l, symetricSize[ 0 ], symetricSize[ 1 ], model, origin,
+	CM_Trace( context, &trace, start_l, end_l, symetricSize[ 0 ], symetricSize[ 1 ], model, origin,
 			  brushmask, skipmask, type, &sphere );
 
 	// if the bmodel was rotated and there was a collision
@@ -2240,6 +2368,566 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	*results = trace;
 }
 
+void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+                             const vec3_t mins, const vec3_t maxs, clipHandle_t model,
+                             int brushmask, int skipmask, const vec3_t origin, const vec3_t angles,
+                             traceType_t type )
+{
+	CM_TransformedBoxTrace( CM_ThreadTraceContext(), results, start, end, mins, maxs, model,
+	                        brushmask, skipmask, origin, angles, type );
+}
+
+/*
+===============================================================================
+
+BATCHED TRACING
+
+===============================================================================
+*/
+
+// the traces of a batch are told apart with one bit each in cmTraceContext_t
+static const int MAX_BATCH_TRACES = 32;
+
+// The vector code must round exactly like the scalar code to give the same results,
+// so it is not used when the compiler may contract or reorder the float operations.
+#if defined( DAEMON_USE_ARCH_INTRINSICS_i686_sse ) && ( defined( __SSE_MATH__ ) || defined( _M_X64 ) ) \
+	&& !defined( __FMA__ ) && !defined( __FAST_MATH__ )
+#define CM_SSE_BRUSH_TRACES
+#endif
+
+#ifdef CM_SSE_BRUSH_TRACES
+static inline __m128 CM_Select( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+static inline __m128 CM_DotProduct4( __m128 x, __m128 y, __m128 z, const vec3_t normal )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( normal[ 0 ] ) ), _mm_mul_ps( y, _mm_set1_ps( normal[ 1 ] ) ) ),
+	                   _mm_mul_ps( z, _mm_set1_ps( normal[ 2 ] ) ) );
+}
+
+/*
+================
+CM_TraceThroughBrush4
+
+CM_TraceThroughBrush for up to four box traces, one per SSE lane
+================
+*/
+static void CM_TraceThroughBrush4( traceWork_t *const *tws, int numTraces, const cbrush_t *brush )
+{
+	if ( !brush->numsides )
+	{
+		return;
+	}
+
+	alignas( 16 ) float start[ 3 ][ 4 ], end[ 3 ][ 4 ], size[ 2 ][ 3 ][ 4 ];
+
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		// unused lanes repeat the last trace
+		const traceWork_t *tw = tws[ std::min( lane, numTraces - 1 ) ];
+
+		for ( int i = 0; i < 3; i++ )
+		{
+			start[ i ][ lane ] = tw->start[ i ];
+			end[ i ][ lane ] = tw->end[ i ];
+			size[ 0 ][ i ][ lane ] = tw->size[ 0 ][ i ];
+			size[ 1 ][ i ][ lane ] = tw->size[ 1 ][ i ];
+		}
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 epsilon = _mm_set1_ps( SURFACE_CLIP_EPSILON );
+
+	__m128 enterFrac = _mm_set1_ps( -1.0f );
+	__m128 leaveFrac = one;
+	__m128 leadSide = zero;
+	__m128 getout = zero;
+	__m128 startout = zero;
+	__m128 inFront = zero; // lanes for which the brush was found to be entirely in front of a plane
+
+	for ( int sideNum = 0; sideNum < brush->numsides; sideNum++ )
+	{
+		const cplane_t *plane = brush->sides[ sideNum ].plane;
+
+		// adjust the plane distance appropriately for mins/maxs
+		__m128 offsetX = _mm_load_ps( size[ plane->signbits & 1 ? 1 : 0 ][ 0 ] );
+		__m128 offsetY = _mm_load_ps( size[ plane->signbits & 2 ? 1 : 0 ][ 1 ] );
+		__m128 offsetZ = _mm_load_ps( size[ plane->signbits & 4 ? 1 : 0 ][ 2 ] );
+		__m128 dist = _mm_sub_ps( _mm_set1_ps( plane->dist ), CM_DotProduct4( offsetX, offsetY, offsetZ, plane->normal ) );
+
+		__m128 d1 = _mm_sub_ps( CM_DotProduct4( _mm_load_ps( start[ 0 ] ), _mm_load_ps( start[ 1 ] ), _mm_load_ps( start[ 2 ] ), plane->normal ), dist );
+		__m128 d2 = _mm_sub_ps( CM_DotProduct4( _mm_load_ps( end[ 0 ] ), _mm_load_ps( end[ 1 ] ), _mm_load_ps( end[ 2 ] ), plane->normal ), dist );
+
+		getout = _mm_or_ps( getout, _mm_cmpgt_ps( d2, zero ) );
+		startout = _mm_or_ps( startout, _mm_cmpgt_ps( d1, zero ) );
+
+		// if completely in front of face, no intersection with the entire brush
+		inFront = _mm_or_ps( inFront, _mm_and_ps( _mm_cmpgt_ps( d1, zero ),
+			_mm_or_ps( _mm_cmpge_ps( d2, epsilon ), _mm_cmpge_ps( d2, d1 ) ) ) );
+
+		if ( _mm_movemask_ps( inFront ) == 0xf )
+		{
+			break;
+		}
+
+		// if it doesn't cross the plane, the plane isn't relevant
+		__m128 crosses = _mm_andnot_ps( _mm_or_ps( inFront, _mm_and_ps( _mm_cmple_ps( d1, zero ), _mm_cmple_ps( d2, zero ) ) ),
+			_mm_cmpeq_ps( zero, zero ) );
+
+		if ( !_mm_movemask_ps( crosses ) )
+		{
+			continue;
+		}
+
+		__m128 enters = _mm_and_ps( crosses, _mm_cmpgt_ps( d1, d2 ) );
+		__m128 leaves = _mm_andnot_ps( _mm_cmpgt_ps( d1, d2 ), crosses );
+		__m128 denominator = CM_Select( crosses, _mm_sub_ps( d1, d2 ), one );
+
+		// enter
+		__m128 f = _mm_div_ps( _mm_sub_ps( d1, epsilon ), denominator );
+		f = _mm_andnot_ps( _mm_cmplt_ps( f, zero ), f );
+		__m128 closer = _mm_and_ps( enters, _mm_cmpgt_ps( f, enterFrac ) );
+		enterFrac = CM_Select( closer, f, enterFrac );
+		leadSide = CM_Select( closer, _mm_set1_ps( sideNum ), leadSide );
+
+		// leave
+		f = _mm_div_ps( _mm_add_ps( d1, epsilon ), denominator );
+		f = CM_Select( _mm_cmpgt_ps( f, one ), one, f );
+		leaveFrac = CM_Select( _mm_and_ps( leaves, _mm_cmplt_ps( f, leaveFrac ) ), f, leaveFrac );
+	}
+
+	alignas( 16 ) float enterFracs[ 4 ], leaveFracs[ 4 ], leadSides[ 4 ];
+	_mm_store_ps( enterFracs, enterFrac );
+	_mm_store_ps( leaveFracs, leaveFrac );
+	_mm_store_ps( leadSides, leadSide );
+	int inFrontBits = _mm_movemask_ps( inFront );
+	int getoutBits = _mm_movemask_ps( getout );
+	int startoutBits = _mm_movemask_ps( startout );
+
+	for ( int lane = 0; lane < numTraces; lane++ )
+	{
+		traceWork_t *tw = tws[ lane ];
+
+		tw->brushTraces++;
+
+		if ( inFrontBits & ( 1 << lane ) )
+		{
+			continue;
+		}
+
+		if ( !( startoutBits & ( 1 << lane ) ) )
+		{
+			// original point was inside brush
+			tw->trace.startsolid = true;
+
+			if ( !( getoutBits & ( 1 << lane ) ) )
+			{
+				tw->trace.allsolid = true;
+				tw->trace.fraction = 0;
+				tw->trace.contents = brush->contents;
+			}
+
+			continue;
+		}
+
+		if ( enterFracs[ lane ] < leaveFracs[ lane ] && enterFracs[ lane ] > -1 && enterFracs[ lane ] < tw->trace.fraction )
+		{
+			const cbrushside_t *leadside = &brush->sides[ static_cast<int>( leadSides[ lane ] ) ];
+
+			tw->trace.fraction = enterFracs[ lane ];
+			VectorCopy( leadside->plane->normal, tw->trace.plane.normal );
+			tw->trace.plane.dist = leadside->plane->dist;
+			tw->trace.surfaceFlags = leadside->surfaceFlags;
+			tw->trace.contents = brush->contents;
+		}
+	}
+}
+#endif
+
+/*
+================
+CM_TraceThroughBrushes
+
+Traces several box traces through the same brush
+================
+*/
+static void CM_TraceThroughBrushes( traceWork_t *const *tws, int numTraces, const cbrush_t *brush )
+{
+	int i = 0;
+
+#ifdef CM_SSE_BRUSH_TRACES
+	for ( ; numTraces - i > 1; i += 4 )
+	{
+		CM_TraceThroughBrush4( tws + i, std::min( numTraces - i, 4 ), brush );
+	}
+#endif
+
+	for ( ; i < numTraces; i++ )
+	{
+		CM_TraceThroughBrush( tws[ i ], brush );
+	}
+}
+
+struct batchRay_t
+{
+	traceWork_t *tw;
+	float       p1f, p2f;
+	vec3_t      p1, p2;
+};
+
+/*
+================
+CM_TraceThroughLeafBatch
+
+CM_TraceThroughLeaf for each trace reaching the leaf, testing each brush
+against all the traces that need it at once
+================
+*/
+static void CM_TraceThroughLeafBatch( const cLeaf_t *leaf, const batchRay_t *rays, int numRays )
+{
+	traceWork_t *active[ MAX_BATCH_TRACES ];
+	traceWork_t *hits[ MAX_BATCH_TRACES ];
+	int         numActive = numRays;
+
+	for ( int i = 0; i < numRays; i++ )
+	{
+		active[ i ] = rays[ i ].tw;
+	}
+
+	// the whole batch uses the same context and masks
+	cmTraceContext_t &context = *active[ 0 ]->context;
+	int contents = active[ 0 ]->contents;
+	int skipContents = active[ 0 ]->skipContents;
+
+	const int *firstBrushNum = leaf->firstLeafBrush;
+	const int *endBrushNum = firstBrushNum + leaf->numLeafBrushes;
+	for ( const int *brushNum = firstBrushNum; brushNum < endBrushNum && numActive; brushNum++ )
+	{
+		cbrush_t *b = &cm.brushes[ *brushNum ];
+
+		if ( !( b->contents & contents ) || ( b->contents & skipContents ) )
+		{
+			continue;
+		}
+
+		int numHits = 0;
+		uint32_t hitBits = 0;
+
+		for ( int i = 0; i < numActive; i++ )
+		{
+			traceWork_t *tw = active[ i ];
+
+			if ( !CM_MarkVisited( tw, context.brushChecks[ *brushNum ], context.brushRays[ *brushNum ] ) )
+			{
+				continue; // already checked this brush in another leaf
+			}
+
+			if ( !CM_BoundsIntersect( tw->bounds[ 0 ], tw->bounds[ 1 ], b->bounds[ 0 ], b->bounds[ 1 ] ) )
+			{
+				continue;
+			}
+
+			hits[ numHits++ ] = tw;
+			hitBits |= tw->rayBit;
+		}
+
+		if ( !numHits )
+		{
+			continue;
+		}
+
+		CM_TraceThroughBrushes( hits, numHits, b );
+
+		// like CM_TraceThroughLeaf, stop there for the traces that ended up in solid
+		int numLeft = 0;
+
+		for ( int i = 0; i < numActive; i++ )
+		{
+			if ( !( active[ i ]->trace.allsolid && ( active[ i ]->rayBit & hitBits ) ) )
+			{
+				active[ numLeft++ ] = active[ i ];
+			}
+		}
+
+		numActive = numLeft;
+	}
+
+	for ( int i = 0; i < numActive; i++ )
+	{
+		// CM_TraceThroughSurface does not set startsolid/allsolid so 0 fraction is the most we'll know
+		if ( active[ i ]->trace.fraction )
+		{
+			CM_TraceThroughLeafSurfaces( active[ i ], leaf );
+		}
+	}
+}
+
+/*
+==================
+CM_TraceThroughTreeBatch
+
+Walks the tree once for a batch of traces. Each trace visits the same leafs
+in the same order as with CM_TraceThroughTree, so the results are identical.
+==================
+*/
+static void CM_TraceThroughTreeBatch( int num, const batchRay_t *rays, int numRays )
+{
+	int live[ MAX_BATCH_TRACES ];
+	int numLive = 0;
+
+	for ( int i = 0; i < numRays; i++ )
+	{
+		if ( rays[ i ].tw->trace.fraction < rays[ i ].p1f )
+		{
+			continue; // already hit something nearer
+		}
+
+		live[ numLive++ ] = i;
+	}
+
+	if ( !numLive )
+	{
+		return;
+	}
+
+	// if < 0, we are in a leaf node
+	if ( num < 0 )
+	{
+		batchRay_t leafRays[ MAX_BATCH_TRACES ];
+
+		for ( int i = 0; i < numLive; i++ )
+		{
+			leafRays[ i ] = rays[ live[ i ] ];
+		}
+
+		CM_TraceThroughLeafBatch( &cm.leafs[ -1 - num ], leafRays, numLive );
+		return;
+	}
+
+	const cNode_t  *node = cm.nodes + num;
+	const cplane_t *plane = node->plane;
+
+	enum class nodeSide_t : uint8_t { FRONT, BACK, FRONT_THEN_BACK, BACK_THEN_FRONT };
+	nodeSide_t sides[ MAX_BATCH_TRACES ];
+	float fracs[ MAX_BATCH_TRACES ][ 2 ];
+
+	for ( int i = 0; i < numLive; i++ )
+	{
+		const batchRay_t &ray = rays[ live[ i ] ];
+		float t1, t2, offset;
+		float frac, frac2, idist;
+
+		// adjust the plane distance appropriately for mins/maxs
+		if ( plane->type < 3 )
+		{
+			t1 = ray.p1[ plane->type ] - plane->dist;
+			t2 = ray.p2[ plane->type ] - plane->dist;
+			offset = ray.tw->extents[ plane->type ];
+		}
+		else
+		{
+			t1 = DotProduct( plane->normal, ray.p1 ) - plane->dist;
+			t2 = DotProduct( plane->normal, ray.p2 ) - plane->dist;
+			offset = ray.tw->maxOffset;
+		}
+
+		// see which sides we need to consider
+		if ( t1 >= offset + 1 && t2 >= offset + 1 )
+		{
+			sides[ i ] = nodeSide_t::FRONT;
+			continue;
+		}
+
+		if ( t1 < -offset - 1 && t2 < -offset - 1 )
+		{
+			sides[ i ] = nodeSide_t::BACK;
+			continue;
+		}
+
+		// put the crosspoint SURFACE_CLIP_EPSILON pixels on the near side
+		if ( t1 < t2 )
+		{
+			idist = 1.0f / ( t1 - t2 );
+			sides[ i ] = nodeSide_t::BACK_THEN_FRONT;
+			frac2 = ( t1 + offset + SURFACE_CLIP_EPSILON ) * idist;
+			frac = ( t1 - offset + SURFACE_CLIP_EPSILON ) * idist;
+		}
+		else if ( t1 > t2 )
+		{
+			idist = 1.0f / ( t1 - t2 );
+			sides[ i ] = nodeSide_t::FRONT_THEN_BACK;
+			frac2 = ( t1 - offset - SURFACE_CLIP_EPSILON ) * idist;
+			frac = ( t1 + offset + SURFACE_CLIP_EPSILON ) * idist;
+		}
+		else
+		{
+			sides[ i ] = nodeSide_t::FRONT_THEN_BACK;
+			frac = 1;
+			frac2 = 0;
+		}
+
+		// clamped the same way as CM_TraceThroughTree does
+		fracs[ i ][ 0 ] = frac < 0 ? 0 : frac > 1 ? 1 : frac;
+		fracs[ i ][ 1 ] = frac2 < 0 ? 0 : frac2 > 1 ? 1 : frac2;
+	}
+
+	// Every trace goes through the near child before the far one, in four passes:
+	// front child for the traces starting there, back child for the traces starting
+	// there, then the far child of the traces that cross the node.
+	batchRay_t children[ MAX_BATCH_TRACES ];
+
+	for ( int pass = 0; pass < 4; pass++ )
+	{
+		int child = ( pass == 0 || pass == 3 ) ? 0 : 1;
+		int numChildren = 0;
+
+		for ( int i = 0; i < numLive; i++ )
+		{
+			const batchRay_t &ray = rays[ live[ i ] ];
+			batchRay_t &sub = children[ numChildren ];
+			float frac;
+
+			switch ( sides[ i ] )
+			{
+			case nodeSide_t::FRONT:
+			case nodeSide_t::BACK:
+				if ( pass != ( sides[ i ] == nodeSide_t::FRONT ? 0 : 1 ) )
+				{
+					continue;
+				}
+
+				sub = ray;
+				numChildren++;
+				continue;
+
+			case nodeSide_t::FRONT_THEN_BACK:
+			case nodeSide_t::BACK_THEN_FRONT:
+				if ( pass == ( sides[ i ] == nodeSide_t::FRONT_THEN_BACK ? 0 : 1 ) )
+				{
+					// move up to the node
+					frac = fracs[ i ][ 0 ];
+					sub.tw = ray.tw;
+					sub.p1f = ray.p1f;
+					sub.p2f = ray.p1f + ( ray.p2f - ray.p1f ) * frac;
+					VectorCopy( ray.p1, sub.p1 );
+					sub.p2[ 0 ] = ray.p1[ 0 ] + frac * ( ray.p2[ 0 ] - ray.p1[ 0 ] );
+					sub.p2[ 1 ] = ray.p1[ 1 ] + frac * ( ray.p2[ 1 ] - ray.p1[ 1 ] );
+					sub.p2[ 2 ] = ray.p1[ 2 ] + frac * ( ray.p2[ 2 ] - ray.p1[ 2 ] );
+					numChildren++;
+				}
+				else if ( pass == ( sides[ i ] == nodeSide_t::FRONT_THEN_BACK ? 2 : 3 ) )
+				{
+					// go past the node
+					frac = fracs[ i ][ 1 ];
+					sub.tw = ray.tw;
+					sub.p1f = ray.p1f + ( ray.p2f - ray.p1f ) * frac;
+					sub.p2f = ray.p2f;
+					sub.p1[ 0 ] = ray.p1[ 0 ] + frac * ( ray.p2[ 0 ] - ray.p1[ 0 ] );
+					sub.p1[ 1 ] = ray.p1[ 1 ] + frac * ( ray.p2[ 1 ] - ray.p1[ 1 ] );
+					sub.p1[ 2 ] = ray.p1[ 2 ] + frac * ( ray.p2[ 2 ] - ray.p1[ 2 ] );
+					VectorCopy( ray.p2, sub.p2 );
+					numChildren++;
+				}
+				continue;
+			}
+		}
+
+		if ( numChildren )
+		{
+			CM_TraceThroughTreeBatch( node->children[ child ], children, numChildren );
+		}
+	}
+}
+
+/*
+==================
+CM_BoxTraces
+==================
+*/
+void CM_BoxTraces( cmTraceContext_t &context, trace_t *results, const boxTrace_t *traces, int numTraces,
+                   clipHandle_t model, int brushmask, int skipmask, traceType_t type )
+{
+	PROFILE_ZONE( "CM_BoxTraces" );
+
+	// only box sweeps through the world have a tree walk to share
+	if ( model || type != traceType_t::TT_AABB || !cm.numNodes )
+	{
+		for ( int i = 0; i < numTraces; i++ )
+		{
+			CM_BoxTrace( context, &results[ i ], traces[ i ].start, traces[ i ].end, traces[ i ].mins,
+			             traces[ i ].maxs, model, brushmask, skipmask, type );
+		}
+
+		return;
+	}
+
+	for ( int first = 0; first < numTraces; first += MAX_BATCH_TRACES )
+	{
+		int         count = std::min( numTraces - first, MAX_BATCH_TRACES );
+		traceWork_t tws[ MAX_BATCH_TRACES ];
+		batchRay_t  rays[ MAX_BATCH_TRACES ];
+		int         traceNums[ MAX_BATCH_TRACES ];
+		int         numRays = 0;
+
+		CM_BeginTrace( context );
+
+		for ( int i = first; i < first + count; i++ )
+		{
+			const boxTrace_t &trace = traces[ i ];
+
+			// position tests don't walk the tree
+			if ( VectorCompare( trace.start, trace.end ) )
+			{
+				continue;
+			}
+
+			traceWork_t &tw = tws[ numRays ];
+			tw = {};
+			tw.trace.fraction = 1; // assume it goes the entire distance until shown otherwise
+			tw.type = type;
+			tw.context = &context;
+			tw.rayBit = 1u << numRays;
+
+			CM_SetupTrace( tw, trace.start, trace.end, trace.mins, trace.maxs, brushmask, skipmask, nullptr );
+			CM_SetupSweep( tw );
+
+			rays[ numRays ].tw = &tw;
+			rays[ numRays ].p1f = 0;
+			rays[ numRays ].p2f = 1;
+			VectorCopy( tw.start, rays[ numRays ].p1 );
+			VectorCopy( tw.end, rays[ numRays ].p2 );
+			traceNums[ numRays ] = i;
+			numRays++;
+		}
+
+		CM_TraceThroughTreeBatch( 0, rays, numRays );
+
+		for ( int i = 0; i < numRays; i++ )
+		{
+			const boxTrace_t &trace = traces[ traceNums[ i ] ];
+			CM_FinishTrace( tws[ i ], trace.start, trace.end, &results[ traceNums[ i ] ] );
+		}
+
+		for ( int i = first; i < first + count; i++ )
+		{
+			if ( VectorCompare( traces[ i ].start, traces[ i ].end ) )
+			{
+				CM_BoxTrace( context, &results[ i ], traces[ i ].start, traces[ i ].end, traces[ i ].mins,
+				             traces[ i ].maxs, model, brushmask, skipmask, type );
+			}
+		}
+	}
+}
+
+void CM_BoxTraces( trace_t *results, const boxTrace_t *traces, int numTraces, clipHandle_t model,
+                   int brushmask, int skipmask, traceType_t type )
+{
+	CM_BoxTraces( CM_ThreadTraceContext(), results, traces, numTraces, model, brushmask, skipmask, type );
+}
+
 // Checks the invariants of a trace - that the trace_t result is
 // consistent with itself and the arguments.
 // Returns a string describing a problem if there is one, or the empty string if not.
@@ -28,6 +28,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ===========================================================================
 */
 
+#include <random>
+#include <thread>
+
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -184,4 +187,140 @@ TEST_F(TraceTest, BoxHitPatch)
     EXPECT_NEAR(tr.plane.dist, 362.105, PATCH_PLANE_DIST_ATOL);
 }
 
+struct TraceParams
+{
+    vec3_t start, end, mins, maxs;
+    vec3_t origin, angles;
+    clipHandle_t model;
+    bool transformed;
+};
+
+void RunTrace(cmTraceContext_t &context, const TraceParams &p, trace_t &tr)
+{
+    if (p.transformed) {
+        CM_TransformedBoxTrace(context, &tr, p.start, p.end, p.mins, p.maxs, p.model, contentmask, skipmask,
+                               p.origin, p.angles, traceType_t::TT_AABB);
+    } else {
+        CM_BoxTrace(context, &tr, p.start, p.end, p.mins, p.maxs, p.model, contentmask, skipmask, traceType_t::TT_AABB);
+    }
+}
+
+// Traces with one context per thread must give the same results as running them one after another
+TEST_F(TraceTest, ConcurrentTraces)
+{
+    constexpr int numThreads = 8;
+    constexpr int numTraces = 4000;
+
+    vec3_t worldMins, worldMaxs;
+    CM_ModelBounds(CM_InlineModel(0), worldMins, worldMaxs);
+
+    std::mt19937 rng(42);
+    auto uniform = [&](float min, float max) {
+        return std::uniform_real_distribution<float>(min, max)(rng);
+    };
+
+    std::vector<TraceParams> params(numTraces);
+    for (TraceParams &p : params) {
+        for (int i = 0; i < 3; i++) {
+            p.start[i] = uniform(worldMins[i], worldMaxs[i]);
+            p.end[i] = p.start[i] + uniform(-1000, 1000);
+            float size = rng() % 4 ? uniform(0, 40) : 0;
+            p.mins[i] = -size;
+            p.maxs[i] = size;
+            p.origin[i] = uniform(-100, 100);
+            p.angles[i] = rng() % 2 ? uniform(0, 360) : 0;
+        }
+        p.transformed = CM_NumInlineModels() > 1 && rng() % 4 == 0;
+        p.model = CM_InlineModel(p.transformed ? 1 + rng() % (CM_NumInlineModels() - 1) : 0);
+    }
+
+    std::vector<trace_t> serial(numTraces);
+    cmTraceContext_t serialContext;
+    for (int i = 0; i < numTraces; i++) {
+        RunTrace(serialContext, params[i], serial[i]);
+    }
+
+    std::vector<trace_t> concurrent(numTraces);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t] {
+            cmTraceContext_t context;
+            // every thread runs all the traces, each one writes a different part of the results
+            for (int n = 0; n < numTraces; n++) {
+                int i = (n + t * numTraces / numThreads) % numTraces;
+                trace_t tr;
+                RunTrace(context, params[i], tr);
+                if (i % numThreads == t) {
+                    concurrent[i] = tr;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (int i = 0; i < numTraces; i++) {
+        SCOPED_TRACE(i);
+        EXPECT_EQ(serial[i].fraction, concurrent[i].fraction);
+        EXPECT_EQ(serial[i].allsolid, concurrent[i].allsolid);
+        EXPECT_EQ(serial[i].startsolid, concurrent[i].startsolid);
+        EXPECT_THAT(concurrent[i].endpos, Pointwise(::testing::FloatEq(), serial[i].endpos));
+        EXPECT_THAT(concurrent[i].plane.normal, Pointwise(::testing::FloatEq(), serial[i].plane.normal));
+        EXPECT_EQ(serial[i].contents, concurrent[i].contents);
+        EXPECT_EQ(serial[i].surfaceFlags, concurrent[i].surfaceFlags);
+    }
+}
+
+// A batch of traces must give exactly the same results as tracing one by one
+TEST_F(TraceTest, BatchedTraces)
+{
+    constexpr int numTraces = 3000;
+
+    vec3_t worldMins, worldMaxs;
+    CM_ModelBounds(CM_InlineModel(0), worldMins, worldMaxs);
+
+    std::mt19937 rng(7);
+    auto uniform = [&](float min, float max) {
+        return std::uniform_real_distribution<float>(min, max)(rng);
+    };
+
+    std::vector<boxTrace_t> traces(numTraces);
+    for (boxTrace_t &trace : traces) {
+        // mostly short traces like movement, some long ones like hitscan, some position tests
+        float length = rng() % 4 ? 100 : 4000;
+        bool position = rng() % 16 == 0;
+        bool point = rng() % 3 == 0;
+        for (int i = 0; i < 3; i++) {
+            trace.start[i] = uniform(worldMins[i], worldMaxs[i]);
+            trace.end[i] = position ? trace.start[i] : trace.start[i] + uniform(-length, length);
+            trace.mins[i] = point ? 0 : -uniform(1, 40);
+            trace.maxs[i] = point ? 0 : uniform(1, 40);
+        }
+    }
+
+    // with the context of the calling thread, and with a context of the caller
+    std::vector<trace_t> batched(numTraces), batchedContext(numTraces);
+    CM_BoxTraces(batched.data(), traces.data(), numTraces, CM_InlineModel(0), contentmask, skipmask, traceType_t::TT_AABB);
+    cmTraceContext_t context;
+    CM_BoxTraces(context, batchedContext.data(), traces.data(), numTraces, CM_InlineModel(0), contentmask, skipmask, traceType_t::TT_AABB);
+
+    for (int i = 0; i < numTraces; i++) {
+        SCOPED_TRACE(i);
+        const boxTrace_t &trace = traces[i];
+        trace_t tr;
+        CM_BoxTrace(&tr, trace.start, trace.end, trace.mins, trace.maxs, CM_InlineModel(0), contentmask, skipmask, traceType_t::TT_AABB);
+        for (const trace_t &result : {batched[i], batchedContext[i]}) {
+            EXPECT_EQ(tr.fraction, result.fraction);
+            EXPECT_EQ(tr.allsolid, result.allsolid);
+            EXPECT_EQ(tr.startsolid, result.startsolid);
+            EXPECT_THAT(result.endpos, Pointwise(::testing::FloatEq(), tr.endpos));
+            EXPECT_THAT(result.plane.normal, Pointwise(::testing::FloatEq(), tr.plane.normal));
+            EXPECT_EQ(tr.plane.dist, result.plane.dist);
+            EXPECT_EQ(tr.contents, result.contents);
+            EXPECT_EQ(tr.surfaceFlags, result.surfaceFlags);
+        }
+    }
+}
+
 } // namespace
@@ -63,6 +63,37 @@ struct ipcSnapshot_t
 	OpaquePlayerState ps;
 };
 
+// The snapshot ring that the engine fills in shared memory, see
+// LocateSnapshotsMsg. A slot is rewritten for every parsed snapshot and
+// its generation is bumped each time, so the cgame can check that the
+// slot still holds the snapshot the engine validated. The entities of
+// all the slots are stored one after the other in a circular buffer.
+#define SHARED_SNAPSHOT_SLOTS    32 // must be PACKET_BACKUP
+#define SHARED_SNAPSHOT_ENTITIES ( SHARED_SNAPSHOT_SLOTS * 256 )
+
+struct sharedSnapshot_t
+{
+	uint32_t      generation;
+	int           messageNum;
+
+	int           snapFlags;
+	int           ping;
+	int           serverTime;
+	byte          areamask[ MAX_MAP_AREA_BYTES ];
+
+	uint32_t      firstEntity; // counts all the entities ever written in the ring
+	int           numEntities;
+
+	OpaquePlayerState ps;
+};
+
+struct sharedSnapshots_t
+{
+	uint32_t         numEntities; // entities written in the ring so far
+	sharedSnapshot_t slots[ SHARED_SNAPSHOT_SLOTS ];
+	entityState_t    entities[ SHARED_SNAPSHOT_ENTITIES ];
+};
+
 struct cgClientState_t
 {
 	connstate_t connState;
@@ -90,4 +121,18 @@ using markMsgOutput_t = std::pair<
 	std::vector<markFragment_t>
 >;
 
+// A skeleton to build with trap_R_BuildSkeletons, the same arguments as
+// trap_R_BuildSkeleton and optionally a trap_R_BlendSkeleton with the
+// skeleton of an earlier job. Sent as plain data, so no bool in there.
+struct skeletonJob_t
+{
+	qhandle_t anim;
+	int       startFrame;
+	int       endFrame;
+	float     frac;
+	int       clearOrigin;
+	int       blendJob; // index of the job to blend with, -1 for none
+	float     blendFrac;
+};
+
 #endif
@@ -91,6 +91,23 @@ namespace Util {
 		}
 	};
 
+	// refSkeleton_t is POD, so the vector would be sent whole without this
+	template<> struct SerializeTraits<std::vector<refSkeleton_t>> {
+		static void Write(Writer& stream, const std::vector<refSkeleton_t>& skels)
+		{
+			stream.WriteSize(skels.size());
+			for (const refSkeleton_t& skel : skels)
+				stream.Write<refSkeleton_t>(skel);
+		}
+		static std::vector<refSkeleton_t> Read(Reader& stream)
+		{
+			std::vector<refSkeleton_t> skels(stream.ReadSize<refSkeleton_t>());
+			for (refSkeleton_t& skel : skels)
+				skel = stream.Read<refSkeleton_t>();
+			return skels;
+		}
+	};
+
 	// Use that bone optimization for refEntity_t
 	template<> struct SerializeTraits<refEntity_t> {
 		static void Write(Writer& stream, const refEntity_t& ent)
@@ -227,6 +244,11 @@ enum cgameImport_t
   CG_LAN_RESETPINGS,
   CG_LAN_SERVERSTATUS,
   CG_LAN_RESETSERVERSTATUS,
+
+  // Added at the end to keep the ids of the older syscalls
+  CG_R_BUILDSKELETONS,
+  CG_LOCATESNAPSHOTS,
+  CG_GETSHAREDSNAPSHOT,
 };
 
 // All Miscs
@@ -262,6 +284,16 @@ using GetSnapshotMsg = IPC::SyncMessage<
 	IPC::Message<IPC::Id<VM::QVM, CG_GETSNAPSHOT>, int>,
 	IPC::Reply<bool, ipcSnapshot_t>
 >;
+// The cgame creates the shared snapshot ring and hands it to the engine
+using LocateSnapshotsMsg = IPC::SyncMessage<
+	IPC::Message<IPC::Id<VM::QVM, CG_LOCATESNAPSHOTS>, IPC::SharedMemory>
+>;
+// Same as GetSnapshotMsg but the snapshot itself is read from the shared
+// ring, only its slot generation and the server commands are sent
+using GetSharedSnapshotMsg = IPC::SyncMessage<
+	IPC::Message<IPC::Id<VM::QVM, CG_GETSHAREDSNAPSHOT>, int>,
+	IPC::Reply<bool, uint32_t, std::vector<std::string>>
+>;
 using GetCurrentCmdNumberMsg = IPC::SyncMessage<
 	IPC::Message<IPC::Id<VM::QVM, CG_GETCURRENTCMDNUMBER>>,
 	IPC::Reply<int>
@@ -373,6 +405,11 @@ namespace Render {
 		IPC::Message<IPC::Id<VM::QVM, CG_R_BUILDSKELETON>, int, int, int, float, bool>,
 		IPC::Reply<refSkeleton_t, int>
 	>;
+	// All the skeletons of a frame in one roundtrip, built and blended in order
+	using BuildSkeletonsMsg = IPC::SyncMessage<
+		IPC::Message<IPC::Id<VM::QVM, CG_R_BUILDSKELETONS>, std::vector<skeletonJob_t>>,
+		IPC::Reply<std::vector<refSkeleton_t>, std::vector<int>>
+	>;
 	using BoneIndexMsg = IPC::SyncMessage<
 		IPC::Message<IPC::Id<VM::QVM, CG_R_BONEINDEX>, int, std::string>,
 		IPC::Reply<int>
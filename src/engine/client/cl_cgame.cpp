@@ -48,8 +48,10 @@ Maryland 20850 USA.
 
 #include "framework/CommonVMServices.h"
 #include "framework/CommandSystem.h"
+#include "common/Profiler.h"
 #include "framework/CvarSystem.h"
 #include "framework/Network.h"
+#include "framework/ThreadPool.h"
 
 // Suppress warnings for unused [this] lambda captures.
 #ifdef __clang__
@@ -66,6 +68,47 @@ Maryland 20850 USA.
  */
 static Cvar::Cvar<int> p_team("p_team", "team number of your team", Cvar::ROM, 0);
 
+static Cvar::Range<Cvar::Cvar<int>> cl_skeletonThreads("cl_skeletonThreads",
+	"worker threads building the skeletons batched by the cgame, 0 to build them on the main thread",
+	Cvar::NONE, 0, 0, ThreadPool::MAX_WORKERS);
+
+/*
+====================
+CL_BuildSkeletons
+
+Building a skeleton only reads the animation, so the jobs can be spread over
+threads; the blends depend on earlier jobs and are cheap, they are done after.
+====================
+*/
+static void CL_BuildSkeletons( const std::vector<skeletonJob_t>& jobs, std::vector<refSkeleton_t>& skeletons, std::vector<int>& results )
+{
+	for ( size_t i = 0; i < jobs.size(); i++ )
+	{
+		if ( jobs[ i ].blendJob >= int( i ) )
+		{
+			Sys::Drop( "CL_BuildSkeletons: job %d blends with job %d which is not before it", int( i ), jobs[ i ].blendJob );
+		}
+	}
+
+	skeletons.resize( jobs.size() );
+	results.resize( jobs.size() );
+
+	ThreadPool::ParallelFor( cl_skeletonThreads.Get(), jobs.size(), [ & ]( int i ) {
+		const skeletonJob_t& job = jobs[ i ];
+		results[ i ] = re.BuildSkeleton( &skeletons[ i ], job.anim, job.startFrame, job.endFrame, job.frac, job.clearOrigin );
+	} );
+
+	for ( size_t i = 0; i < jobs.size(); i++ )
+	{
+		const skeletonJob_t& job = jobs[ i ];
+
+		if ( job.blendJob >= 0 && results[ i ] && results[ job.blendJob ] )
+		{
+			results[ i ] = re.BlendSkeleton( &skeletons[ i ], &skeletons[ job.blendJob ], job.blendFrac );
+		}
+	}
+}
+
 /*
 ====================
 CL_GetUserCmd
@@ -318,6 +361,131 @@ bool CL_GetSnapshot( int snapshotNumber, ipcSnapshot_t *snapshot )
 	return true;
 }
 
+// The snapshot ring located by the cgame, see LocateSnapshotsMsg
+static IPC::SharedMemory cgameSnapshots;
+
+static_assert( SHARED_SNAPSHOT_SLOTS == PACKET_BACKUP, "the shared snapshot ring must match cl.snapshots" );
+static_assert( SHARED_SNAPSHOT_ENTITIES >= MAX_GENTITIES, "a full snapshot must fit in the shared entity ring" );
+
+/*
+====================
+CL_WriteSharedSnapshot
+
+Copies a parsed snapshot to its slot of the ring shared with the cgame
+====================
+*/
+void CL_WriteSharedSnapshot( const clSnapshot_t *snap )
+{
+	if ( !cgameSnapshots )
+	{
+		return;
+	}
+
+	sharedSnapshots_t *shared = static_cast<sharedSnapshots_t *>( cgameSnapshots.GetBase() );
+	sharedSnapshot_t *slot = &shared->slots[ snap->messageNum & PACKET_MASK ];
+	int numEntities = snap->entities.size();
+
+	// the entities may wrap around the end of the ring
+	uint32_t first = shared->numEntities;
+	int start = first % SHARED_SNAPSHOT_ENTITIES;
+	int count = std::min( numEntities, SHARED_SNAPSHOT_ENTITIES - start );
+	std::copy_n( snap->entities.data(), count, shared->entities + start );
+	std::copy_n( snap->entities.data() + count, numEntities - count, shared->entities );
+	shared->numEntities = first + numEntities;
+
+	slot->generation++;
+	slot->messageNum = snap->messageNum;
+	slot->snapFlags = snap->snapFlags;
+	slot->ping = snap->ping;
+	slot->serverTime = snap->serverTime;
+	memcpy( slot->areamask, snap->areamask, sizeof( slot->areamask ) );
+	slot->firstEntity = first;
+	slot->numEntities = numEntities;
+	slot->ps = snap->ps;
+}
+
+/*
+====================
+CL_LocateSnapshots
+====================
+*/
+static void CL_LocateSnapshots( IPC::SharedMemory mem )
+{
+	if ( mem.GetSize() < sizeof( sharedSnapshots_t ) )
+	{
+		Sys::Drop( "CL_LocateSnapshots: shared memory of %zu bytes is too small", mem.GetSize() );
+	}
+
+	cgameSnapshots = std::move( mem );
+	memset( cgameSnapshots.GetBase(), 0, sizeof( sharedSnapshots_t ) );
+
+	// the snapshots parsed before the cgame asked for the ring, oldest first
+	for ( int i = PACKET_BACKUP - 1; i >= 0; i-- )
+	{
+		int messageNum = cl.snap.messageNum - i;
+		const clSnapshot_t *snap = &cl.snapshots[ messageNum & PACKET_MASK ];
+
+		if ( snap->valid && snap->messageNum == messageNum )
+		{
+			CL_WriteSharedSnapshot( snap );
+		}
+	}
+}
+
+/*
+====================
+CL_GetSharedSnapshot
+
+Like CL_GetSnapshot, but the cgame reads the snapshot from the shared
+ring, so only the generation of its slot and the commands are returned
+====================
+*/
+static bool CL_GetSharedSnapshot( int snapshotNumber, uint32_t &generation, std::vector<std::string> &serverCommands )
+{
+	clSnapshot_t *clSnap;
+
+	if ( !cgameSnapshots )
+	{
+		Sys::Drop( "CL_GetSharedSnapshot: the snapshot ring was not located" );
+	}
+
+	if ( snapshotNumber > cl.snap.messageNum )
+	{
+		Sys::Drop( "CL_GetSharedSnapshot: snapshotNumber > cl.snapshot.messageNum" );
+	}
+
+	// if the frame has fallen out of the circular buffer, we can't return it
+	if ( cl.snap.messageNum - snapshotNumber >= PACKET_BACKUP )
+	{
+		return false;
+	}
+
+	// if the frame is not valid, we can't return it
+	clSnap = &cl.snapshots[ snapshotNumber & PACKET_MASK ];
+
+	if ( !clSnap->valid )
+	{
+		return false;
+	}
+
+	// if the entities in the frame have fallen out of their circular buffer, we can't return it
+	const sharedSnapshots_t *shared = static_cast<const sharedSnapshots_t *>( cgameSnapshots.GetBase() );
+	const sharedSnapshot_t *slot = &shared->slots[ snapshotNumber & PACKET_MASK ];
+
+	if ( slot->messageNum != snapshotNumber
+	     || shared->numEntities - slot->firstEntity > SHARED_SNAPSHOT_ENTITIES )
+	{
+		return false;
+	}
+
+	generation = slot->generation;
+
+	CL_FillServerCommands( serverCommands, clc.lastExecutedServerCommand + 1, clSnap->serverCommandNum );
+	clc.lastExecutedServerCommand = clSnap->serverCommandNum;
+
+	return true;
+}
+
 /*
 ====================
 CL_ShutdownCGame
@@ -326,6 +494,7 @@ CL_ShutdownCGame
 void CL_ShutdownCGame()
 {
 	cls.cgameStarted = false;
+	cgameSnapshots = IPC::SharedMemory();
 
 	if ( !cgvm.IsActive() )
 	{
@@ -1076,6 +1245,8 @@ void CGameVM::CGameConsoleLine(const std::string& str)
 
 void CGameVM::Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel)
 {
+	PROFILE_ZONE("CGameVM::Syscall");
+
 	int major = id >> 16;
 	int minor = id & 0xffff;
 	if (major == VM::QVM) {
@@ -1170,6 +1341,18 @@ void CGameVM::QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& cha
 			});
 			break;
 
+		case CG_LOCATESNAPSHOTS:
+			IPC::HandleMsg<LocateSnapshotsMsg>(channel, std::move(reader), [this] (IPC::SharedMemory mem) {
+				CL_LocateSnapshots(std::move(mem));
+			});
+			break;
+
+		case CG_GETSHAREDSNAPSHOT:
+			IPC::HandleMsg<GetSharedSnapshotMsg>(channel, std::move(reader), [this] (int number, bool& res, uint32_t& generation, std::vector<std::string>& serverCommands) {
+				res = CL_GetSharedSnapshot(number, generation, serverCommands);
+			});
+			break;
+
 		case CG_GETCURRENTCMDNUMBER:
 			IPC::HandleMsg<GetCurrentCmdNumberMsg>(channel, std::move(reader), [this] (int& number) {
 				number = CL_GetCurrentCmdNumber();
@@ -1336,6 +1519,12 @@ void CGameVM::QVMSyscall(int syscallNum, Util::Reader& reader, IPC::Channel& cha
 			});
 			break;
 
+		case CG_R_BUILDSKELETONS:
+			IPC::HandleMsg<Render::BuildSkeletonsMsg>(channel, std::move(reader), [this] (const std::vector<skeletonJob_t>& jobs, std::vector<refSkeleton_t>& skels, std::vector<int>& res) {
+				CL_BuildSkeletons(jobs, skels, res);
+			});
+			break;
+
 		case CG_R_BONEINDEX:
 			IPC::HandleMsg<Render::BoneIndexMsg>(channel, std::move(reader), [this] (int model, const std::string& boneName, int& index) {
 				index = re.BoneIndex(model, boneName.c_str());
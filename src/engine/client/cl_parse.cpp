@@ -317,6 +317,7 @@ void CL_ParseSnapshot( msg_t *msg )
 
 	// save the frame off in the backup array for later delta comparisons
 	cl.snapshots[ cl.snap.messageNum & PACKET_MASK ] = cl.snap;
+	CL_WriteSharedSnapshot( &cl.snap );
 
 	if ( cl_shownet->integer == 3 )
 	{
@@ -662,6 +662,7 @@ void     CL_ShutdownCGame();
 void     CL_CGameRendering();
 void     CL_SetCGameTime();
 void     CL_FirstSnapshot();
+void     CL_WriteSharedSnapshot( const clSnapshot_t *snap );
 void     CL_OnTeamChanged( int newTeam );
 
 //
@@ -63,19 +63,18 @@ namespace IPC {
     void CommandBufferHost::Consume() {
         buffer.LoadWriterData();
         logs.Debug("Consuming up to %i data from buffer for %s", buffer.GetMaxReadLength(), name);
-        bool consuming = true;
         //TODO set fixed bound too
 
-        while(consuming) {
+        while (true) {
             Util::Reader reader;
-            consuming = ConsumeOne(reader);
-
-            if (consuming) {
-                uint32_t id = reader.Read<uint32_t>();
-                int major = id >> 16;
-                int minor = id & 0xffff;
-                this->HandleCommandBufferSyscall(major, minor, reader);
+            if (!ConsumeOne(reader)) {
+                break;
             }
+
+            uint32_t id = reader.Read<uint32_t>();
+            int major = id >> 16;
+            int minor = id & 0xffff;
+            this->HandleCommandBufferSyscall(major, minor, reader);
             //TODO add more logic to stop consuming (e.g. when the socket is ready)
         }
     }
@@ -96,9 +95,12 @@ namespace IPC {
         if (!buffer.CanRead(size + sizeof(uint32_t))) {
             Sys::Drop("Command buffer for %s had an incomplete message write", name);
         }
-        std::vector<char>& readerData = reader.GetData();
-        readerData.resize(size);
-        buffer.Read(readerData.data(), size, sizeof(uint32_t));
+
+        // The VM can still write to the ring, so the message is copied before
+        // it is deserialized, into a buffer reused between messages.
+        message.resize(size);
+        buffer.Read(message.data(), size, sizeof(uint32_t));
+        reader.SetView(message.data(), size);
 
         buffer.AdvanceReadPointer(size + sizeof(uint32_t));
 
@@ -44,17 +44,21 @@ namespace IPC {
             void Syscall(int index, Util::Reader& reader, IPC::Channel& channel);
             void Close();
 
+        protected:
+            void Init(IPC::SharedMemory mem);
+            void Consume();
+
         private:
             std::string name;
             Log::Logger logs;
             IPC::CommandBuffer buffer;
             IPC::SharedMemory shm;
 
-            virtual void HandleCommandBufferSyscall(int major, int minor, Util::Reader& reader) = 0;
+            // Private copy of the message being handled
+            std::vector<char> message;
 
-            void Init(IPC::SharedMemory mem);
+            virtual void HandleCommandBufferSyscall(int major, int minor, Util::Reader& reader) = 0;
 
-            void Consume();
             bool ConsumeOne(Util::Reader& reader);
     };
 }
@@ -0,0 +1,182 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+* Neither the name of the Daemon developers nor the
+names of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include "CommandBufferHost.h"
+
+namespace IPC {
+namespace {
+
+const size_t BUFFER_SIZE = 16384;
+
+class TestCommandBufferHost : public CommandBufferHost {
+public:
+    TestCommandBufferHost(): CommandBufferHost("test") {}
+
+    using CommandBufferHost::Init;
+    using CommandBufferHost::Consume;
+
+    std::vector<std::pair<int, std::string>> received;
+    bool keep = true;
+    uint64_t sum = 0;
+
+private:
+    void HandleCommandBufferSyscall(int major, int minor, Util::Reader& reader) override {
+        EXPECT_EQ(major, 1);
+        int value = reader.Read<int>();
+        std::string text = reader.Read<std::string>();
+        reader.CheckEndRead();
+
+        sum += value + minor + text.size();
+        if (keep) {
+            received.emplace_back(value, std::move(text));
+        }
+    }
+};
+
+// Frames a message the same way as CommandBufferClient::Write, including the
+// padding that AdvanceWritePointer adds.
+void AppendMessage(std::vector<char>& out, int minor, int value, Str::StringRef text) {
+    Util::Writer message;
+    message.Write<uint32_t>((1 << 16) | minor);
+    message.Write<int>(value);
+    message.Write<std::string>(text);
+
+    const std::vector<char>& data = message.GetData();
+    uint32_t dataSize = data.size();
+    out.insert(out.end(), (char*)&dataSize, (char*)&dataSize + sizeof(uint32_t));
+    out.insert(out.end(), data.begin(), data.end());
+    out.resize((out.size() + 3) & ~3);
+}
+
+class CommandBufferTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        SharedMemory shm = SharedMemory::Create(BUFFER_SIZE);
+        writer.Init(shm.GetBase(), shm.GetSize());
+        writer.Reset();
+        host.Init(std::move(shm));
+    }
+
+    void Write(const std::vector<char>& messages) {
+        writer.LoadReaderData();
+        ASSERT_TRUE(writer.CanWrite(messages.size()));
+        writer.Write(messages.data(), messages.size());
+        writer.AdvanceWritePointer(messages.size());
+    }
+
+    CommandBuffer writer;
+    TestCommandBufferHost host;
+};
+
+TEST_F(CommandBufferTest, ConsumeAcrossWraparound)
+{
+    // Odd batch sizes make messages straddle the end of the ring at varying
+    // offsets, including in the middle of the length prefix.
+    int value = 0;
+    for (int round = 0; round < 200; round++) {
+        std::vector<char> messages;
+        std::vector<std::pair<int, std::string>> expected;
+        for (int i = 0; i < round % 13 + 1; i++) {
+            std::string text((value * 7) % 61, 'a' + value % 26);
+            AppendMessage(messages, round % 100, value, text);
+            expected.emplace_back(value++, text);
+        }
+
+        host.received.clear();
+        Write(messages);
+        host.Consume();
+        ASSERT_EQ(host.received, expected);
+    }
+}
+
+TEST_F(CommandBufferTest, DISABLED_ConsumeBenchmark)
+{
+    const int batches = 5000;
+
+    std::vector<char> messages;
+    int count = 0;
+    while (messages.size() < BUFFER_SIZE / 2) {
+        AppendMessage(messages, count % 64, count, "models/weapons/rifle/rifle.iqm");
+        count++;
+    }
+
+    // The previous consumption path, which copied every message into a newly
+    // allocated reader, as a baseline.
+    SharedMemory copyShm = SharedMemory::Create(BUFFER_SIZE);
+    CommandBuffer copyWriter, copyReader;
+    copyWriter.Init(copyShm.GetBase(), copyShm.GetSize());
+    copyWriter.Reset();
+    copyReader.Init(copyShm.GetBase(), copyShm.GetSize());
+    uint64_t copySum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < batches; i++) {
+        copyWriter.LoadReaderData();
+        copyWriter.Write(messages.data(), messages.size());
+        copyWriter.AdvanceWritePointer(messages.size());
+
+        copyReader.LoadWriterData();
+        while (copyReader.CanRead(sizeof(uint32_t))) {
+            uint32_t size;
+            copyReader.Read((char*)&size, sizeof(uint32_t));
+            Util::Reader reader;
+            reader.GetData().resize(size);
+            copyReader.Read(reader.GetData().data(), size, sizeof(uint32_t));
+            copyReader.AdvanceReadPointer(size + sizeof(uint32_t));
+
+            int minor = reader.Read<uint32_t>() & 0xffff;
+            int value = reader.Read<int>();
+            copySum += value + minor + reader.Read<std::string>().size();
+        }
+    }
+    auto copied = std::chrono::steady_clock::now();
+
+    host.keep = false;
+    for (int i = 0; i < batches; i++) {
+        Write(messages);
+        host.Consume();
+    }
+    auto consumed = std::chrono::steady_clock::now();
+
+    ASSERT_EQ(host.sum, copySum);
+
+    using seconds = std::chrono::duration<double>;
+    double total = double(batches) * count;
+    printf("command buffer, %d messages: copying %.0f msg/s, in place %.0f msg/s\n", batches * count,
+        total / std::chrono::duration_cast<seconds>(copied - start).count(),
+        total / std::chrono::duration_cast<seconds>(consumed - copied).count());
+}
+
+} // namespace
+} // namespace IPC
@@ -349,6 +349,27 @@ namespace VM {
                 });
                 break;
 
+            case QVM_COMMON_FS_READ_PAK_FILE:
+                IPC::HandleMsg<FSReadPakFileMsg>(channel, std::move(reader), [this](const std::string& filename, int& length, Util::optional<IPC::SharedMemory>& content) {
+                    std::error_code err;
+                    FS::PakPath::FileView file = FS::PakPath::ReadFileView(filename, 1, err);
+                    if (err) {
+                        const std::error_code notFound(Util::ordinal(FS::filesystem_error::no_such_file), FS::filesystem_category());
+                        length = err == notFound ? -1 : -2;
+                        return;
+                    }
+                    if (file.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                        length = -2;
+                        return;
+                    }
+                    length = file.size();
+                    if (length) {
+                        content = IPC::SharedMemory::Create(length);
+                        memcpy(content->GetBase(), file.data(), length);
+                    }
+                });
+                break;
+
             default:
                 Sys::Drop("Bad log syscall number '%d' for VM '%s'", minor, vmName.c_str());
         }
@@ -0,0 +1,223 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include "common/Common.h"
+#include "common/Profiler.h"
+#include "common/FileSystem.h"
+
+#include <mutex>
+
+namespace Profiler {
+
+std::atomic<bool> capturing{false};
+
+// Zones a thread can record during one capture, the following ones are dropped
+static const size_t MAX_THREAD_EVENTS = 1 << 16;
+
+struct Event {
+	const char* name;
+	int64_t start;
+	int64_t end;
+};
+
+// Only its own thread writes to a buffer. The main thread reads the first
+// count events once the capture is over.
+struct ThreadBuffer {
+	int id;
+	bool mainThread;
+	std::atomic<int> generation{-1};
+	std::atomic<size_t> count{0};
+	std::atomic<size_t> dropped{0};
+	std::unique_ptr<Event[]> events;
+};
+
+static std::mutex bufferListMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> bufferList;
+static thread_local ThreadBuffer* threadBuffer = nullptr;
+
+// Bumped by each capture, so the threads know to drop their old events
+static std::atomic<int> captureGeneration{0};
+
+// Main thread only
+static int framesRequested = 0;
+static int framesLeft = 0;
+static int captureFrames = 0;
+static std::string capturePath;
+static int64_t captureStart = 0;
+
+int64_t Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Sys::SteadyClock::now().time_since_epoch()).count();
+}
+
+void RecordZone(const char* name, int64_t start, int64_t end)
+{
+	ThreadBuffer* buffer = threadBuffer;
+
+	if (!buffer) {
+		std::lock_guard<std::mutex> lock(bufferListMutex);
+		bufferList.emplace_back(new ThreadBuffer);
+		buffer = bufferList.back().get();
+		buffer->id = bufferList.size() - 1;
+		buffer->mainThread = Sys::OnMainThread();
+		buffer->events.reset(new Event[MAX_THREAD_EVENTS]);
+		threadBuffer = buffer;
+	}
+
+	int generation = captureGeneration.load(std::memory_order_acquire);
+
+	if (buffer->generation.load(std::memory_order_relaxed) != generation) {
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+		buffer->generation.store(generation, std::memory_order_release);
+	}
+
+	size_t count = buffer->count.load(std::memory_order_relaxed);
+
+	if (count == MAX_THREAD_EVENTS) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[count] = {name, start, end};
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+// Writes the events in the Chrome trace event format, which chrome://tracing,
+// Perfetto and Tracy's importer can open.
+static void WriteCapture()
+{
+	int generation = captureGeneration.load(std::memory_order_relaxed);
+	std::string json = "{\"traceEvents\":[\n";
+	size_t numEvents = 0, numDropped = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(bufferListMutex);
+
+		for (const auto& buffer : bufferList) {
+			if (buffer->generation.load(std::memory_order_acquire) != generation) {
+				continue;
+			}
+
+			size_t count = buffer->count.load(std::memory_order_acquire);
+			numDropped += buffer->dropped.load(std::memory_order_relaxed);
+
+			json += Str::Format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+				buffer->id, buffer->mainThread ? "main" : Str::Format("thread %d", buffer->id));
+
+			for (size_t i = 0; i < count; i++) {
+				const Event& event = buffer->events[i];
+				json += Str::Format("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n",
+					event.name, buffer->id, (event.start - captureStart) / 1000.0, (event.end - event.start) / 1000.0);
+			}
+
+			numEvents += count;
+		}
+	}
+
+	// no trailing comma allowed before the closing bracket
+	if (json.back() == '\n' && json[json.size() - 2] == ',') {
+		json.erase(json.size() - 2, 1);
+	}
+
+	json += "],\"displayTimeUnit\":\"ns\"}\n";
+
+	std::error_code err;
+	FS::File file = FS::HomePath::OpenWrite(capturePath, err);
+
+	if (!err) {
+		file.Write(json.data(), json.size(), err);
+	}
+
+	if (err) {
+		Log::Warn("Could not write the profile to %s: %s", capturePath, err.message());
+		return;
+	}
+
+	Log::Notice("Wrote %d zones over %d frames to %s", numEvents, captureFrames, capturePath);
+
+	if (numDropped) {
+		Log::Notice("%d zones were dropped because a thread recorded more than %d", numDropped, MAX_THREAD_EVENTS);
+	}
+}
+
+void NewFrame()
+{
+	if (framesRequested) {
+		captureFrames = framesLeft = framesRequested;
+		framesRequested = 0;
+		captureStart = Now();
+		captureGeneration.fetch_add(1, std::memory_order_release);
+		capturing.store(true, std::memory_order_relaxed);
+		return;
+	}
+
+	if (framesLeft == 0 || --framesLeft > 0) {
+		return;
+	}
+
+	capturing.store(false, std::memory_order_relaxed);
+	WriteCapture();
+}
+
+class ProfileFramesCmd : public Cmd::StaticCmd {
+public:
+	ProfileFramesCmd()
+		: Cmd::StaticCmd("profileFrames", Cmd::BASE, "records the profiler zones of the next frames to a Chrome trace file") {}
+
+	void Run(const Cmd::Args& args) const override
+	{
+		int frames;
+
+		if (args.Argc() < 2 || args.Argc() > 3 || !Str::ParseInt(frames, args.Argv(1)) || frames <= 0) {
+			PrintUsage(args, "<frames> [name]", "records the zones of the next <frames> frames to profiles/<name>.json in the homepath");
+			return;
+		}
+
+		if (framesLeft || framesRequested) {
+			Print("A capture is already running");
+			return;
+		}
+
+		std::string name = args.Argc() == 3 ? args.Argv(2) : "profile";
+
+		if (!FS::Path::IsValid(name, false)) {
+			Print("Invalid name: %s", name);
+			return;
+		}
+
+		// start with the next frame
+		capturePath = FS::Path::Build("profiles", name + ".json");
+		framesRequested = frames;
+	}
+};
+static ProfileFramesCmd profileFramesCmdRegistration;
+
+} // namespace Profiler
@@ -0,0 +1,155 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include "common/Common.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ThreadPool {
+
+class Pool {
+public:
+	~Pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wakeWorkers.notify_all();
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+
+	void Run(int numWorkers, int count, const std::function<void(int)>& func)
+	{
+		numWorkers = Math::Clamp(numWorkers, 0, std::min(MAX_WORKERS, count - 1));
+
+		if (numWorkers == 0) {
+			for (int i = 0; i < count; i++) {
+				func(i);
+			}
+			return;
+		}
+
+		// Batches from different threads are run one after another
+		std::lock_guard<std::mutex> runLock(runMutex);
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (static_cast<int>(threads.size()) < numWorkers) {
+			int index = threads.size();
+			threads.emplace_back(&Pool::WorkerMain, this, index);
+		}
+
+		job = &func;
+		jobCount = count;
+		activeWorkers = numWorkers;
+		runningWorkers = numWorkers;
+		nextIndex = 0;
+		generation++;
+		lock.unlock();
+		wakeWorkers.notify_all();
+
+		Work();
+
+		lock.lock();
+		workersDone.wait(lock, [this] { return runningWorkers == 0; });
+		job = nullptr;
+	}
+
+private:
+	void Work()
+	{
+		for (int i = nextIndex++; i < jobCount; i = nextIndex++) {
+			(*job)(i);
+		}
+	}
+
+	void WorkerMain(int index)
+	{
+		uint64_t seenGeneration = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			wakeWorkers.wait(lock, [&] {
+				return quit || (generation != seenGeneration && index < activeWorkers);
+			});
+
+			if (quit) {
+				return;
+			}
+
+			seenGeneration = generation;
+			lock.unlock();
+
+			Work();
+
+			lock.lock();
+			if (--runningWorkers == 0) {
+				workersDone.notify_one();
+			}
+		}
+	}
+
+	std::mutex runMutex;
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable workersDone;
+	std::vector<std::thread> threads;
+
+	// Protected by mutex
+	bool quit = false;
+	uint64_t generation = 0;
+	int activeWorkers = 0;
+	int runningWorkers = 0;
+
+	// Published to the workers through the mutex when a batch starts
+	const std::function<void(int)>* job = nullptr;
+	int jobCount = 0;
+	std::atomic<int> nextIndex{0};
+};
+
+void ParallelFor(int numWorkers, int count, const std::function<void(int)>& func)
+{
+	static Pool pool;
+
+	if (count <= 0) {
+		return;
+	}
+
+	pool.Run(numWorkers, count, func);
+}
+
+} // namespace ThreadPool
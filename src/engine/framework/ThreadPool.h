@@ -0,0 +1,61 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#ifndef FRAMEWORK_THREAD_POOL_H_
+#define FRAMEWORK_THREAD_POOL_H_
+
+#include <functional>
+
+/*
+ * A small pool of persistent worker threads for data-parallel engine work.
+ *
+ * Workers are created lazily the first time they are needed and are kept
+ * around for the lifetime of the process, so dispatching a batch only costs
+ * a wakeup. The calling thread always takes part in the work, which means a
+ * request for 0 workers degenerates to a plain serial loop.
+ *
+ * Jobs must not call Sys::Drop: off the main thread it turns into a fatal
+ * Sys::Error.
+ */
+
+namespace ThreadPool {
+
+	// Maximum number of worker threads, not counting the calling thread.
+	constexpr int MAX_WORKERS = 32;
+
+	// Calls func(i) for every i in [0, count), spread over the calling thread
+	// and up to numWorkers worker threads, and returns once all calls are done.
+	// Indices are handed out in increasing order but may complete in any order.
+	// Must not be called from inside a job.
+	void ParallelFor(int numWorkers, int count, const std::function<void(int)>& func);
+
+} // namespace ThreadPool
+
+#endif // FRAMEWORK_THREAD_POOL_H_
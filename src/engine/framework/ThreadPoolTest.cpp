@@ -0,0 +1,100 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2024, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Daemon developers nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include "common/Common.h"
+#include "ThreadPool.h"
+
+namespace ThreadPool {
+namespace {
+
+TEST(ThreadPoolTest, SerialWithoutWorkers)
+{
+    std::vector<int> order;
+    ParallelFor(0, 10, [&](int i) { order.push_back(i); });
+    ASSERT_EQ(order, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(ThreadPoolTest, RunsEveryIndexOnceWithWorkers)
+{
+    for (int numWorkers : {1, 3, MAX_WORKERS}) {
+        SCOPED_TRACE(numWorkers);
+        // several batches in a row reuse the same workers
+        for (int batch = 0; batch < 20; batch++) {
+            std::vector<std::atomic<int>> calls(1000);
+            ParallelFor(numWorkers, calls.size(), [&](int i) { calls[i]++; });
+            for (size_t i = 0; i < calls.size(); i++) {
+                ASSERT_EQ(1, calls[i].load()) << "index " << i;
+            }
+        }
+    }
+}
+
+TEST(ThreadPoolTest, UsesWorkerThreads)
+{
+    // the job blocks until a second thread has joined in, so this hangs if
+    // the workers never run
+    std::atomic<int> running{0};
+    std::atomic<bool> otherThread{false};
+    std::thread::id caller = std::this_thread::get_id();
+    ParallelFor(2, 2, [&](int) {
+        if (std::this_thread::get_id() != caller) {
+            otherThread = true;
+        }
+        running++;
+        while (running < 2) {
+            std::this_thread::yield();
+        }
+    });
+    ASSERT_TRUE(otherThread);
+}
+
+TEST(ThreadPoolTest, BatchesFromSeveralThreads)
+{
+    std::atomic<int> total{0};
+    std::vector<std::thread> callers;
+    for (int t = 0; t < 4; t++) {
+        callers.emplace_back([&] {
+            for (int batch = 0; batch < 10; batch++) {
+                ParallelFor(2, 100, [&](int) { total++; });
+            }
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+    ASSERT_EQ(4 * 10 * 100, total.load());
+}
+
+} // namespace
+} // namespace ThreadPool
@@ -0,0 +1,864 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+* Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+* Neither the name of the Daemon developers nor the
+names of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+// LoadGen.cpp: synthetic clients to load test the server, built into
+// daemon-loadgen in place of the null client.
+//
+// The clients connect over UDP like remote players would, each from its own
+// socket, to the server running in the same process: playerstates can only be
+// decoded with the netcode table the game module gives to the engine, and the
+// server frame time can be read directly. Usage, after starting a map:
+//   loadgen <clients> [address]
+
+#include "qcommon/q_shared.h"
+#include "qcommon/qcommon.h"
+#include "server/server.h"
+#include "framework/CommandSystem.h"
+#include "framework/Network.h"
+
+cvar_t *cl_shownet;
+
+static Cvar::Range<Cvar::Cvar<int>> loadgen_reportInterval("loadgen_reportInterval",
+	"seconds between two load reports, 0 to only report when the test stops", Cvar::NONE, 5, 0, 3600);
+static Cvar::Cvar<bool> loadgen_move("loadgen_move",
+	"make the synthetic clients run around, jump and shoot instead of standing still", Cvar::NONE, true);
+
+static const int CONNECT_RESEND_MSEC = 1000;
+static const int RECONNECT_MSEC = 3000;
+
+// how far back the server can delta from and still be decoded, kept smaller than
+// PACKET_BACKUP as the clients acknowledge every message they get; power of two
+static const int SNAPSHOT_BACKUP = 8;
+
+enum class loadClientState_t
+{
+	CONNECTING, // sending getchallenge
+	CHALLENGING, // sending connect
+	CONNECTED, // waiting for the gamestate
+	ACTIVE
+};
+
+struct loadSnapshot_t
+{
+	bool                       valid;
+	int                        messageNum;
+	int                        serverTime;
+	OpaquePlayerState          ps;
+	std::vector<entityState_t> entities;
+};
+
+struct loadClient_t
+{
+	int               socket;
+	int               qport;
+	loadClientState_t state;
+	int               stateTime; // last connection packet, or when to connect again
+	std::string       challenge;
+	std::string       dropReason;
+
+	netchan_t netchan;
+	int       serverId;
+	int       serverMessageSequence;
+	int       serverCommandSequence;
+
+	// the only command the clients send is the final disconnect
+	int         reliableSequence;
+	int         reliableAcknowledge;
+	std::string reliableCommand;
+
+	std::unordered_map<int, entityState_t> baselines;
+	loadSnapshot_t                         snapshots[ SNAPSHOT_BACKUP ];
+	int                                    snapshotTime; // when the last one was received
+	int                                    snapshotServerTime;
+	usercmd_t                              cmd; // the last one sent
+};
+
+// counted from the start of the test or from the last report
+struct loadStats_t
+{
+	int     startTime;
+	int64_t bytesReceived;
+	int     snapshots;
+	int     decodeErrors;
+	int     lostDeltas;
+
+	int     lastServerTime;
+	int     serverFrames;
+	int64_t frameUsec;
+	int64_t sendUsec;
+	int     maxFrameUsec;
+};
+
+static std::vector<std::unique_ptr<loadClient_t>> loadClients;
+static netadr_t                                   loadServerAddress;
+static loadStats_t                                loadStats;
+
+// Errors found here don't go through Sys::Drop, which makes repeated errors fatal
+NORETURN static void LoadGen_DecodeError( std::string message )
+{
+	throw Sys::DropErr( true, std::move( message ) );
+}
+
+static void LoadGen_OutOfBand( const loadClient_t &client, Str::StringRef text, bool compress )
+{
+	static byte data[ MAX_MSGLEN ];
+	std::string packet = Net::OOBHeader() + text;
+
+	msg_t msg{};
+	msg.data = data;
+	msg.maxsize = sizeof( data );
+	msg.cursize = packet.size();
+	memcpy( data, packet.data(), packet.size() );
+
+	// the server expects connect packets to be compressed, see Net::OutOfBandData
+	if ( compress )
+	{
+		Huff_Compress( &msg, 12 );
+	}
+
+	NET_SendClientPacket( client.socket, msg.cursize, msg.data );
+}
+
+// Forgets everything sent by the server since the last gamestate
+static void LoadGen_ClearGameState( loadClient_t &client )
+{
+	client.baselines.clear();
+
+	for ( loadSnapshot_t &snapshot : client.snapshots )
+	{
+		snapshot.valid = false;
+		snapshot.entities.clear();
+	}
+}
+
+static void LoadGen_Reset( loadClient_t &client, int when )
+{
+	client.state = loadClientState_t::CONNECTING;
+	client.stateTime = when - CONNECT_RESEND_MSEC;
+	client.challenge.clear();
+	client.dropReason.clear();
+	client.serverId = 0;
+	client.serverMessageSequence = 0;
+	client.serverCommandSequence = 0;
+	client.reliableSequence = 0;
+	client.reliableAcknowledge = 0;
+	LoadGen_ClearGameState( client );
+}
+
+/*
+=======================================================================
+
+SERVER MESSAGE PARSING, as done by cl_parse.cpp
+
+=======================================================================
+*/
+
+static void LoadGen_ParseGamestate( loadClient_t &client, msg_t *msg )
+{
+	std::string systemInfo;
+
+	LoadGen_ClearGameState( client );
+	client.serverCommandSequence = MSG_ReadLong( msg );
+
+	while ( true )
+	{
+		int cmd = MSG_ReadByte( msg );
+
+		if ( cmd == svc_EOF )
+		{
+			break;
+		}
+
+		if ( cmd == svc_configstring )
+		{
+			int index = MSG_ReadShort( msg );
+
+			if ( index < 0 || index >= MAX_CONFIGSTRINGS )
+			{
+				LoadGen_DecodeError( "configstring > MAX_CONFIGSTRINGS" );
+			}
+
+			const char *str = MSG_ReadBigString( msg );
+
+			if ( index == CS_SYSTEMINFO )
+			{
+				systemInfo = str;
+			}
+		}
+		else if ( cmd == svc_baseline )
+		{
+			int number = MSG_ReadBits( msg, GENTITYNUM_BITS );
+			entityState_t nullstate{};
+			MSG_ReadDeltaEntity( msg, &nullstate, &client.baselines[ number ], number );
+		}
+		else
+		{
+			LoadGen_DecodeError( Str::Format( "bad command byte %d in gamestate", cmd ) );
+		}
+	}
+
+	MSG_ReadLong( msg ); // client number
+
+	client.serverId = atoi( Info_ValueForKey( systemInfo.c_str(), "sv_serverid" ) );
+	client.state = loadClientState_t::ACTIVE;
+	client.snapshotTime = Sys::Milliseconds();
+	client.snapshotServerTime = 0;
+	client.cmd = {};
+}
+
+static void LoadGen_ParseCommandString( loadClient_t &client, msg_t *msg )
+{
+	int        seq = MSG_ReadLong( msg );
+	const char *s = MSG_ReadString( msg );
+
+	if ( client.serverCommandSequence >= seq )
+	{
+		return;
+	}
+
+	client.serverCommandSequence = seq;
+
+	// the commands are for the cgame, except for the few ones the engine
+	// client looks at itself
+	Cmd::Args args( s );
+
+	if ( args.Argc() >= 3 && args.Argv( 0 ) == "cs" && atoi( args.Argv( 1 ).c_str() ) == CS_SYSTEMINFO )
+	{
+		// map_restart changes the serverId without sending a gamestate
+		client.serverId = atoi( Info_ValueForKey( args.Argv( 2 ).c_str(), "sv_serverid" ) );
+	}
+	else if ( args.Argc() >= 1 && args.Argv( 0 ) == "disconnect" )
+	{
+		client.dropReason = args.Argc() >= 2 ? args.Argv( 1 ) : "disconnected";
+	}
+}
+
+static const entityState_t &LoadGen_Baseline( const loadClient_t &client, int number )
+{
+	static const entityState_t nullstate{};
+	auto it = client.baselines.find( number );
+	return it != client.baselines.end() ? it->second : nullstate;
+}
+
+// See CL_ParsePacketEntities, both entity lists are sorted by number
+static void LoadGen_ParsePacketEntities( const loadClient_t &client, msg_t *msg, const loadSnapshot_t *old,
+                                         loadSnapshot_t *newSnap )
+{
+	static const std::vector<entityState_t> noEntities;
+	const std::vector<entityState_t> &oldEntities = old ? old->entities : noEntities;
+	std::vector<entityState_t> &newEntities = newSnap->entities;
+	size_t oldIndex = 0;
+
+	int numEntities = MSG_ReadShort( msg );
+
+	if ( numEntities < 0 || numEntities > MAX_GENTITIES )
+	{
+		LoadGen_DecodeError( Str::Format( "bad entity count %d", numEntities ) );
+	}
+
+	newEntities.reserve( numEntities );
+
+	while ( true )
+	{
+		int number = MSG_ReadBits( msg, GENTITYNUM_BITS );
+
+		if ( msg->readcount > msg->cursize )
+		{
+			LoadGen_DecodeError( "unexpected end of message in packet entities" );
+		}
+
+		if ( number == MAX_GENTITIES - 1 )
+		{
+			break;
+		}
+
+		// entities with no entry are unchanged
+		while ( oldIndex < oldEntities.size() && oldEntities[ oldIndex ].number < number )
+		{
+			newEntities.push_back( oldEntities[ oldIndex++ ] );
+		}
+
+		entityState_t entity;
+
+		if ( oldIndex < oldEntities.size() && oldEntities[ oldIndex ].number == number )
+		{
+			MSG_ReadDeltaEntity( msg, &oldEntities[ oldIndex++ ], &entity, number );
+		}
+		else
+		{
+			MSG_ReadDeltaEntity( msg, &LoadGen_Baseline( client, number ), &entity, number );
+		}
+
+		// removed entities are read as MAX_GENTITIES - 1
+		if ( entity.number != MAX_GENTITIES - 1 )
+		{
+			newEntities.push_back( entity );
+		}
+	}
+
+	newEntities.insert( newEntities.end(), oldEntities.begin() + oldIndex, oldEntities.end() );
+
+	// a delta from the wrong snapshot is read to skip it, it can't add up
+	if ( newSnap->valid && newEntities.size() != size_t( numEntities ) )
+	{
+		LoadGen_DecodeError( Str::Format( "%d entities announced, %d decoded", numEntities, int( newEntities.size() ) ) );
+	}
+}
+
+static void LoadGen_ParseSnapshot( loadClient_t &client, msg_t *msg )
+{
+	loadSnapshot_t newSnap{};
+	loadSnapshot_t *old = nullptr;
+	byte           areamask[ MAX_MAP_AREA_BYTES ];
+
+	newSnap.serverTime = MSG_ReadLong( msg );
+	newSnap.messageNum = client.serverMessageSequence;
+
+	int deltaNum = MSG_ReadByte( msg );
+	MSG_ReadByte( msg ); // snapFlags
+
+	if ( deltaNum <= 0 )
+	{
+		newSnap.valid = true;
+	}
+	else
+	{
+		old = &client.snapshots[ ( newSnap.messageNum - deltaNum ) & ( SNAPSHOT_BACKUP - 1 ) ];
+		newSnap.valid = old->valid && old->messageNum == newSnap.messageNum - deltaNum;
+	}
+
+	int len = MSG_ReadByte( msg );
+
+	if ( len < 0 || len > (int) sizeof( areamask ) )
+	{
+		LoadGen_DecodeError( Str::Format( "invalid size %d for areamask", len ) );
+	}
+
+	MSG_ReadData( msg, areamask, len );
+
+	MSG_ReadDeltaPlayerstate( msg, old ? &old->ps : nullptr, &newSnap.ps );
+	LoadGen_ParsePacketEntities( client, msg, old, &newSnap );
+
+	if ( msg->readcount > msg->cursize )
+	{
+		LoadGen_DecodeError( "unexpected end of message in snapshot" );
+	}
+
+	// the server will send a full snapshot once it sees it was not decoded
+	if ( !newSnap.valid )
+	{
+		loadStats.lostDeltas++;
+		return;
+	}
+
+	loadStats.snapshots++;
+	client.snapshotTime = Sys::Milliseconds();
+	client.snapshotServerTime = newSnap.serverTime;
+	client.snapshots[ newSnap.messageNum & ( SNAPSHOT_BACKUP - 1 ) ] = std::move( newSnap );
+}
+
+static void LoadGen_ParseServerMessage( loadClient_t &client, msg_t *msg )
+{
+	MSG_Bitstream( msg );
+
+	client.reliableAcknowledge = MSG_ReadLong( msg );
+
+	if ( client.reliableAcknowledge < client.reliableSequence - MAX_RELIABLE_COMMANDS )
+	{
+		client.reliableAcknowledge = client.reliableSequence;
+	}
+
+	while ( true )
+	{
+		if ( msg->readcount > msg->cursize )
+		{
+			LoadGen_DecodeError( "read past end of server message" );
+		}
+
+		int cmd = MSG_ReadByte( msg );
+
+		if ( cmd < 0 || cmd == svc_EOF )
+		{
+			break;
+		}
+
+		switch ( cmd )
+		{
+			case svc_nop:
+				break;
+
+			case svc_serverCommand:
+				LoadGen_ParseCommandString( client, msg );
+				break;
+
+			case svc_gamestate:
+				LoadGen_ParseGamestate( client, msg );
+				break;
+
+			case svc_snapshot:
+				if ( client.state != loadClientState_t::ACTIVE )
+				{
+					LoadGen_DecodeError( "snapshot before the gamestate" );
+				}
+
+				LoadGen_ParseSnapshot( client, msg );
+				break;
+
+			default:
+				LoadGen_DecodeError( Str::Format( "illegible server message %d", cmd ) );
+		}
+	}
+}
+
+static void LoadGen_ConnectionlessPacket( loadClient_t &client, int index, msg_t *msg )
+{
+	MSG_BeginReadingOOB( msg );
+	MSG_ReadLong( msg ); // skip the -1
+
+	Cmd::Args args( MSG_ReadStringLine( msg ) );
+
+	if ( args.Argc() < 1 )
+	{
+		return;
+	}
+
+	if ( args.Argv( 0 ) == "challengeResponse" && args.Argc() >= 2 && client.state == loadClientState_t::CONNECTING )
+	{
+		client.challenge = args.Argv( 1 );
+		client.state = loadClientState_t::CHALLENGING;
+		client.stateTime = Sys::Milliseconds() - CONNECT_RESEND_MSEC;
+	}
+	else if ( args.Argv( 0 ) == "connectResponse" && client.state == loadClientState_t::CHALLENGING )
+	{
+		Netchan_Setup( netsrc_t::NS_CLIENT, &client.netchan, loadServerAddress, client.qport );
+		client.state = loadClientState_t::CONNECTED;
+	}
+	else if ( args.Argv( 0 ) == "print" )
+	{
+		Log::Notice( "loadgen: client %d: %s", index, MSG_ReadString( msg ) );
+	}
+}
+
+static void LoadGen_PacketEvent( loadClient_t &client, int index, msg_t *msg )
+{
+	loadStats.bytesReceived += msg->cursize;
+
+	if ( msg->cursize >= 4 && *( int * ) msg->data == -1 )
+	{
+		LoadGen_ConnectionlessPacket( client, index, msg );
+		return;
+	}
+
+	if ( client.state < loadClientState_t::CONNECTED || msg->cursize < 4 )
+	{
+		return;
+	}
+
+	if ( !Netchan_Process( &client.netchan, msg ) )
+	{
+		return; // out of order, duplicated, or a fragment
+	}
+
+	client.serverMessageSequence = LittleLong( *( int * ) msg->data );
+
+	try
+	{
+		LoadGen_ParseServerMessage( client, msg );
+	}
+	catch ( Sys::DropErr &err )
+	{
+		loadStats.decodeErrors++;
+		Log::Warn( "loadgen: client %d: %s, connecting again", index, err.what() );
+		LoadGen_Reset( client, Sys::Milliseconds() + RECONNECT_MSEC );
+		return;
+	}
+
+	if ( !client.dropReason.empty() )
+	{
+		Log::Notice( "loadgen: client %d dropped: %s", index, client.dropReason );
+		LoadGen_Reset( client, Sys::Milliseconds() + RECONNECT_MSEC );
+	}
+}
+
+/*
+=======================================================================
+
+CLIENT PACKETS
+
+=======================================================================
+*/
+
+// The same course for every client, shifted in time so they don't all move
+// together: run along a square while turning, jump and shoot from time to time
+static void LoadGen_BuildCmd( loadClient_t &client, int index, int now )
+{
+	static const signed char forward[] = { 127, 0, -127, 0 };
+	static const signed char right[] = { 0, 127, 0, -127 };
+
+	int serverTime = client.snapshotServerTime + now - client.snapshotTime;
+	usercmd_t &cmd = client.cmd;
+
+	// the server ignores commands that don't move time forward
+	serverTime = std::max( serverTime, cmd.serverTime + 1 );
+	cmd = {};
+	cmd.serverTime = serverTime;
+
+	if ( !loadgen_move.Get() )
+	{
+		return;
+	}
+
+	int t = now + index * 577;
+	cmd.forwardmove = forward[ ( t / 1000 ) % 4 ];
+	cmd.rightmove = right[ ( t / 1000 ) % 4 ];
+	cmd.angles[ YAW ] = ANGLE2SHORT( ( t / 10 ) % 360 );
+
+	if ( t % 3000 < 100 )
+	{
+		cmd.upmove = 127;
+	}
+
+	if ( t % 2000 < 500 )
+	{
+		usercmdPressButton( cmd.buttons, BUTTON_ATTACK );
+	}
+}
+
+// Netchan_Transmit with the client's own socket and qport. Client packets
+// are always small enough to not be fragmented.
+static void LoadGen_Transmit( loadClient_t &client, const msg_t &msg )
+{
+	msg_t send;
+	byte  data[ MAX_MSGLEN + 8 ];
+
+	MSG_InitOOB( &send, data, sizeof( data ) );
+	MSG_WriteLong( &send, client.netchan.outgoingSequence++ );
+	MSG_WriteShort( &send, client.qport );
+	MSG_WriteData( &send, msg.data, msg.cursize );
+
+	NET_SendClientPacket( client.socket, send.cursize, send.data );
+}
+
+static void LoadGen_WritePacket( loadClient_t &client, int index, int now )
+{
+	msg_t buf;
+	byte  data[ MAX_MSGLEN ];
+
+	MSG_Init( &buf, data, sizeof( data ) );
+	MSG_Bitstream( &buf );
+
+	MSG_WriteLong( &buf, client.serverId );
+	MSG_WriteLong( &buf, client.serverMessageSequence );
+	MSG_WriteLong( &buf, client.serverCommandSequence );
+
+	if ( client.reliableSequence > client.reliableAcknowledge )
+	{
+		MSG_WriteByte( &buf, clc_clientCommand );
+		MSG_WriteLong( &buf, client.reliableSequence );
+		MSG_WriteString( &buf, client.reliableCommand.c_str() );
+	}
+
+	if ( client.state == loadClientState_t::ACTIVE )
+	{
+		const loadSnapshot_t &last = client.snapshots[ client.serverMessageSequence & ( SNAPSHOT_BACKUP - 1 ) ];
+		bool delta = last.valid && last.messageNum == client.serverMessageSequence;
+		usercmd_t nullcmd{};
+
+		LoadGen_BuildCmd( client, index, now );
+
+		MSG_WriteByte( &buf, delta ? clc_move : clc_moveNoDelta );
+		MSG_WriteByte( &buf, 1 );
+		MSG_WriteDeltaUsercmd( &buf, &nullcmd, &client.cmd );
+	}
+
+	MSG_WriteByte( &buf, clc_EOF );
+	LoadGen_Transmit( client, buf );
+}
+
+static void LoadGen_SendConnectionPacket( loadClient_t &client, int index, int now )
+{
+	if ( now - client.stateTime < CONNECT_RESEND_MSEC )
+	{
+		return;
+	}
+
+	client.stateTime = now;
+
+	if ( client.state == loadClientState_t::CONNECTING )
+	{
+		LoadGen_OutOfBand( client, "getchallenge", false );
+		return;
+	}
+
+	InfoMap userinfo;
+	userinfo[ "name" ] = Str::Format( "loadgen%d", index );
+	userinfo[ "protocol" ] = std::to_string( PROTOCOL_VERSION );
+	userinfo[ "qport" ] = std::to_string( client.qport );
+	userinfo[ "challenge" ] = client.challenge;
+
+	LoadGen_OutOfBand( client, "connect " + Cmd::Escape( InfoMapToString( userinfo ) ), true );
+}
+
+/*
+=======================================================================
+
+LOAD TEST CONTROL
+
+=======================================================================
+*/
+
+static void LoadGen_Report()
+{
+	int   now = Sys::Milliseconds();
+	float seconds = std::max( now - loadStats.startTime, 1 ) / 1000.0f;
+	int   active = std::count_if( loadClients.begin(), loadClients.end(), []( const std::unique_ptr<loadClient_t> &client ) {
+		return client->state == loadClientState_t::ACTIVE;
+	} );
+	float perClient = seconds * std::max( active, 1 );
+
+	Log::Notice( "loadgen: %d/%d clients in game over %.1fs", active, int( loadClients.size() ), seconds );
+
+	if ( loadStats.serverFrames )
+	{
+		Log::Notice( "  server frame %.2fms average, %.2fms max, sending snapshots %.2fms average",
+		             loadStats.frameUsec / 1000.0f / loadStats.serverFrames, loadStats.maxFrameUsec / 1000.0f,
+		             loadStats.sendUsec / 1000.0f / loadStats.serverFrames );
+	}
+
+	Log::Notice( "  %.1fKB/s and %.1f snapshots/s per client", loadStats.bytesReceived / 1024.0f / perClient,
+	             loadStats.snapshots / perClient );
+	Log::Notice( "  %d snapshot decode errors, %d deltas from snapshots no longer kept",
+	             loadStats.decodeErrors, loadStats.lostDeltas );
+
+	loadStats = {};
+	loadStats.startTime = now;
+	loadStats.lastServerTime = svs.time;
+}
+
+static void LoadGen_Stop()
+{
+	if ( loadClients.empty() )
+	{
+		return;
+	}
+
+	int now = Sys::Milliseconds();
+
+	// send it a few times in case one is dropped, like CL_SendDisconnect
+	for ( size_t i = 0; i < loadClients.size(); i++ )
+	{
+		loadClient_t &client = *loadClients[ i ];
+
+		if ( client.state >= loadClientState_t::CONNECTED )
+		{
+			client.reliableCommand = "disconnect";
+			client.reliableSequence++;
+
+			for ( int n = 0; n < 3; n++ )
+			{
+				LoadGen_WritePacket( client, i, now );
+			}
+		}
+
+		NET_CloseClientSocket( client.socket );
+	}
+
+	LoadGen_Report();
+	loadClients.clear();
+}
+
+static bool LoadGen_Start( int count, const std::string &address )
+{
+	int found = NET_StringToAdr( address.c_str(), &loadServerAddress, netadrtype_t::NA_UNSPEC );
+
+	if ( !found )
+	{
+		Log::Warn( "loadgen: can't resolve %s", address );
+		return false;
+	}
+
+	if ( found == 2 )
+	{
+		loadServerAddress.port = BigShort( PORT_SERVER );
+	}
+
+	int now = Sys::Milliseconds();
+
+	for ( int i = 0; i < count; i++ )
+	{
+		auto client = Util::make_unique<loadClient_t>();
+		client->socket = NET_OpenClientSocket( loadServerAddress );
+
+		if ( client->socket < 0 )
+		{
+			Log::Warn( "loadgen: could only open %d client sockets", i );
+			break;
+		}
+
+		// the server tells clients from the same address apart with the qport
+		client->qport = ( 0x4000 + i ) & 0xffff;
+		LoadGen_Reset( *client, now );
+		loadClients.push_back( std::move( client ) );
+	}
+
+	loadStats = {};
+	loadStats.startTime = now;
+	loadStats.lastServerTime = svs.time;
+
+	Log::Notice( "loadgen: connecting %d clients to %s", int( loadClients.size() ), Net::AddressToString( loadServerAddress, true ) );
+	return !loadClients.empty();
+}
+
+class LoadGenCmd : public Cmd::StaticCmd
+{
+public:
+	LoadGenCmd() : StaticCmd( "loadgen", Cmd::SERVER, "connects synthetic clients to load test the server" ) {}
+
+	void Run( const Cmd::Args &args ) const override
+	{
+		int count;
+
+		if ( args.Argc() < 2 || args.Argc() > 3 || !Str::ParseInt( count, args.Argv( 1 ) ) || count < 0 )
+		{
+			PrintUsage( args, "<clients> [address]", "stops the current test and connects that many clients, 0 to only stop" );
+			return;
+		}
+
+		LoadGen_Stop();
+
+		if ( count == 0 )
+		{
+			return;
+		}
+
+		if ( args.Argc() == 2 && !com_sv_running.Get() )
+		{
+			Print( "Start a map first, or give the address of another server" );
+			return;
+		}
+
+		LoadGen_Start( count, args.Argc() == 3 ? args.Argv( 2 ) : "127.0.0.1:" + Cvar::GetValue( "net_port" ) );
+	}
+};
+static LoadGenCmd loadGenCmdRegistration;
+
+/*
+=======================================================================
+
+CLIENT INTERFACE, see null_client.cpp
+
+=======================================================================
+*/
+
+void CL_Shutdown()
+{
+	LoadGen_Stop();
+}
+
+void CL_Init()
+{
+	cl_shownet = Cvar_Get( "cl_shownet", "0", CVAR_TEMP );
+}
+
+void CL_MouseEvent( int, int )
+{
+}
+
+void CL_MousePosEvent( int, int )
+{
+}
+
+void CL_FocusEvent( bool )
+{
+}
+
+// Runs after the server frame, like the real client
+void CL_Frame( int )
+{
+	static byte data[ MAX_MSGLEN ];
+
+	if ( loadClients.empty() )
+	{
+		return;
+	}
+
+	if ( svs.time != loadStats.lastServerTime )
+	{
+		loadStats.lastServerTime = svs.time;
+		loadStats.serverFrames++;
+		loadStats.frameUsec += svs.lastFrameUsec;
+		loadStats.sendUsec += svs.lastSendUsec;
+		loadStats.maxFrameUsec = std::max( loadStats.maxFrameUsec, svs.lastFrameUsec );
+	}
+
+	int now = Sys::Milliseconds();
+
+	for ( size_t i = 0; i < loadClients.size(); i++ )
+	{
+		loadClient_t &client = *loadClients[ i ];
+		msg_t        msg;
+
+		MSG_Init( &msg, data, sizeof( data ) );
+
+		while ( NET_GetClientPacket( client.socket, &msg ) )
+		{
+			LoadGen_PacketEvent( client, i, &msg );
+			MSG_Init( &msg, data, sizeof( data ) );
+		}
+
+		if ( client.state < loadClientState_t::CONNECTED )
+		{
+			LoadGen_SendConnectionPacket( client, i, now );
+		}
+		else
+		{
+			LoadGen_WritePacket( client, i, now );
+		}
+	}
+
+	int interval = loadgen_reportInterval.Get();
+
+	if ( interval && now - loadStats.startTime >= interval * 1000 )
+	{
+		LoadGen_Report();
+	}
+}
+
+void CL_PacketEvent( const netadr_t&, msg_t* )
+{
+}
+
+void CL_MapLoading()
+{
+}
+
+void CL_JoystickEvent( int, int )
+{
+}
@@ -0,0 +1,348 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <chrono>
+#include <algorithm>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "qcommon/qcommon.h"
+
+namespace {
+
+struct Field
+{
+	int bits;
+	int value;
+};
+
+// A mix of the widths used by the delta encoders, including sign extended ones
+std::vector<Field> RandomFields( int count )
+{
+	static const int widths[] = { 1, 2, 3, 4, 5, 7, 8, 10, 12, 16, 18, 24, 32, -8, -16 };
+	std::mt19937 rng( 1234 );
+	std::vector<Field> fields;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		int bits = widths[ rng() % ARRAY_LEN( widths ) ];
+		int value = rng();
+
+		if ( std::abs( bits ) < 32 )
+		{
+			value &= ( 1 << std::abs( bits ) ) - 1;
+		}
+
+		if ( bits < 0 && ( value & ( 1 << ( -bits - 1 ) ) ) )
+		{
+			value |= ~0u << -bits;
+		}
+
+		fields.push_back( { bits, value } );
+	}
+
+	return fields;
+}
+
+void WriteFields( msg_t *msg, byte *buffer, int size, const std::vector<Field> &fields )
+{
+	MSG_Init( msg, buffer, size );
+
+	for ( const Field &field : fields )
+	{
+		MSG_WriteBits( msg, field.value, field.bits );
+	}
+}
+
+class MsgTest : public ::testing::Test
+{
+protected:
+	void TearDown() override
+	{
+		Cvar::SetValue( "msg_huffmanTables", "1" );
+		Cvar::SetValue( "msg_deltaMasks", "1" );
+	}
+};
+
+// A pair of states where a few random words changed, or all of them. Small values
+// survive the encoding of any field, others may be truncated to the field's width.
+template<typename State>
+void RandomStatePair( std::mt19937 &rng, State *from, State *to, int numWords, bool smallValues )
+{
+	int *fromWords = reinterpret_cast<int *>( from );
+	int *toWords = reinterpret_cast<int *>( to );
+
+	for ( int i = 0; i < numWords; i++ )
+	{
+		fromWords[ i ] = rng() % 4 ? rng() % 256 : rng();
+	}
+
+	memcpy( to, from, numWords * 4 );
+	int changes = rng() % 8 ? rng() % 8 : numWords;
+
+	for ( int i = 0; i < changes; i++ )
+	{
+		int value = smallValues ? rng() % 256 : rng() % 3 ? Util::bit_cast<int>( float( int( rng() % 10000 ) - 5000 ) ) : rng();
+		toWords[ rng() % numWords ] = rng() % 4 ? value : 0;
+	}
+}
+
+// Encoding with the changed word masks must give the same bits as comparing field by field
+TEST_F(MsgTest, DeltaEntityMasksMatchGeneric)
+{
+	std::mt19937 rng( 1234 );
+	static byte maskData[ 256 ], genericData[ 256 ];
+	msg_t maskMsg, genericMsg;
+
+	for ( int i = 0; i < 20000; i++ )
+	{
+		entityState_t from, to;
+		bool smallValues = i % 2;
+		RandomStatePair( rng, &from, &to, sizeof( entityState_t ) / 4, smallValues );
+		from.number = to.number = rng() % MAX_GENTITIES;
+		bool force = rng() % 2;
+
+		Cvar::SetValue( "msg_deltaMasks", "1" );
+		MSG_Init( &maskMsg, maskData, sizeof( maskData ) );
+		MSG_WriteDeltaEntity( &maskMsg, &from, &to, force );
+
+		Cvar::SetValue( "msg_deltaMasks", "0" );
+		MSG_Init( &genericMsg, genericData, sizeof( genericData ) );
+		MSG_WriteDeltaEntity( &genericMsg, &from, &to, force );
+
+		ASSERT_EQ( maskMsg.bit, genericMsg.bit );
+		ASSERT_EQ( 0, memcmp( maskData, genericData, genericMsg.cursize ) );
+
+		if ( !maskMsg.cursize )
+		{
+			continue;
+		}
+
+		entityState_t read;
+		MSG_BeginReading( &maskMsg );
+		int number = MSG_ReadBits( &maskMsg, GENTITYNUM_BITS );
+		ASSERT_EQ( to.number, number );
+		MSG_ReadDeltaEntity( &maskMsg, &from, &read, number );
+		ASSERT_EQ( maskMsg.readcount, maskMsg.cursize );
+
+		if ( smallValues )
+		{
+			ASSERT_EQ( 0, memcmp( &to, &read, sizeof( to ) ) );
+		}
+	}
+}
+
+TEST_F(MsgTest, DeltaPlayerstateMasksMatchGeneric)
+{
+	// some of each kind of field, leaving a few words out of the table
+	int size = offsetof( OpaquePlayerState, END ) + 40 * PLAYERSTATE_FIELD_SIZE;
+	int numWords = size / PLAYERSTATE_FIELD_SIZE;
+	static const int widths[] = { 0, 8, 16, 32, -16, 24 };
+	NetcodeTable table;
+
+	for ( int word = 0; word < numWords; word++ )
+	{
+		if ( word == 10 )
+		{
+			table.push_back( { "stats", word * PLAYERSTATE_FIELD_SIZE, STATS_GROUP_FIELD, 0 } );
+			word += STATS_GROUP_NUM_STATS - 1;
+		}
+		else if ( word % 7 != 3 )
+		{
+			table.push_back( { "field", word * PLAYERSTATE_FIELD_SIZE, widths[ word % ARRAY_LEN( widths ) ], 0 } );
+		}
+	}
+
+	std::shuffle( table.begin(), table.end(), std::mt19937( 42 ) );
+
+	std::mt19937 rng( 1234 );
+	static byte maskData[ 1024 ], genericData[ 1024 ];
+	msg_t maskMsg, genericMsg;
+
+	for ( int i = 0; i < 20000; i++ )
+	{
+		OpaquePlayerState from, to;
+		RandomStatePair( rng, &from, &to, numWords, false );
+
+		Cvar::SetValue( "msg_deltaMasks", "1" );
+		MSG_Init( &maskMsg, maskData, sizeof( maskData ) );
+		MSG_WriteDeltaPlayerstate( &maskMsg, &from, &to, table, size );
+
+		Cvar::SetValue( "msg_deltaMasks", "0" );
+		MSG_Init( &genericMsg, genericData, sizeof( genericData ) );
+		MSG_WriteDeltaPlayerstate( &genericMsg, &from, &to, table, size );
+
+		ASSERT_FALSE( maskMsg.overflowed );
+		ASSERT_EQ( maskMsg.cursize, genericMsg.cursize );
+		ASSERT_EQ( maskMsg.bit, genericMsg.bit );
+		ASSERT_EQ( 0, memcmp( maskData, genericData, genericMsg.cursize ) );
+
+		OpaquePlayerState read;
+		MSG_BeginReading( &maskMsg );
+		MSG_ReadDeltaPlayerstate( &maskMsg, &from, &read, table, size );
+		ASSERT_EQ( maskMsg.readcount, maskMsg.cursize );
+	}
+}
+
+// Times the encoding of mostly unchanged entities with and without msg_deltaMasks
+TEST_F(MsgTest, DISABLED_DeltaEntityBenchmark)
+{
+	std::mt19937 rng( 1234 );
+	std::vector<std::pair<entityState_t, entityState_t>> pairs( 1000 );
+
+	for ( auto &pair : pairs )
+	{
+		RandomStatePair( rng, &pair.first, &pair.second, sizeof( entityState_t ) / 4, true );
+
+		// most entities don't change between snapshots
+		if ( rng() % 4 )
+		{
+			pair.second = pair.first;
+		}
+
+		pair.first.number = pair.second.number = rng() % MAX_GENTITIES;
+	}
+
+	static byte data[ MAX_MSGLEN ];
+	msg_t msg;
+
+	for ( const char *useMasks : { "0", "1" } )
+	{
+		Cvar::SetValue( "msg_deltaMasks", useMasks );
+
+		auto start = std::chrono::steady_clock::now();
+		for ( int i = 0; i < 100; i++ )
+		{
+			MSG_Init( &msg, data, sizeof( data ) );
+
+			for ( auto &pair : pairs )
+			{
+				MSG_WriteDeltaEntity( &msg, &pair.first, &pair.second, false );
+			}
+		}
+		auto written = std::chrono::steady_clock::now();
+
+		using us = std::chrono::microseconds;
+		printf( "msg_deltaMasks %s: %d entity deltas in %ld us\n", useMasks, int( 100 * pairs.size() ),
+			long( std::chrono::duration_cast<us>( written - start ).count() ) );
+	}
+}
+
+TEST_F(MsgTest, HuffmanTablesMatchTree)
+{
+	std::vector<Field> fields = RandomFields( 2000 );
+	static byte tableData[ MAX_MSGLEN ], treeData[ MAX_MSGLEN ];
+	msg_t tableMsg, treeMsg;
+
+	Cvar::SetValue( "msg_huffmanTables", "1" );
+	WriteFields( &tableMsg, tableData, sizeof( tableData ), fields );
+
+	Cvar::SetValue( "msg_huffmanTables", "0" );
+	WriteFields( &treeMsg, treeData, sizeof( treeData ), fields );
+
+	ASSERT_FALSE( tableMsg.overflowed );
+	ASSERT_EQ( tableMsg.bit, treeMsg.bit );
+	ASSERT_EQ( tableMsg.cursize, treeMsg.cursize );
+	ASSERT_EQ( 0, memcmp( tableData, treeData, treeMsg.cursize ) );
+
+	for ( const char *useTables : { "0", "1" } )
+	{
+		Cvar::SetValue( "msg_huffmanTables", useTables );
+		MSG_BeginReading( &treeMsg );
+
+		for ( const Field &field : fields )
+		{
+			ASSERT_EQ( field.value, MSG_ReadBits( &treeMsg, field.bits ) );
+		}
+
+		EXPECT_EQ( treeMsg.readcount, treeMsg.cursize );
+	}
+}
+
+// Appending after bits written earlier must keep them intact
+TEST_F(MsgTest, HuffmanTablesUnaligned)
+{
+	static byte data[ 64 ];
+	msg_t msg;
+
+	Cvar::SetValue( "msg_huffmanTables", "1" );
+
+	for ( int offset = 1; offset < 8; offset++ )
+	{
+		memset( data, 0xff, sizeof( data ) );
+		MSG_Init( &msg, data, sizeof( data ) );
+		MSG_WriteBits( &msg, 0x55, offset );
+		MSG_WriteBits( &msg, 0x12345678, 32 );
+		MSG_WriteBits( &msg, -3, -5 );
+
+		MSG_BeginReading( &msg );
+		EXPECT_EQ( 0x55 & ( ( 1 << offset ) - 1 ), MSG_ReadBits( &msg, offset ) );
+		EXPECT_EQ( 0x12345678, MSG_ReadBits( &msg, 32 ) );
+		EXPECT_EQ( -3, MSG_ReadBits( &msg, -5 ) );
+	}
+}
+
+// Times packing and unpacking fields with and without msg_huffmanTables
+TEST_F(MsgTest, DISABLED_HuffmanBenchmark)
+{
+	std::vector<Field> fields = RandomFields( 4000 );
+	static byte data[ MAX_MSGLEN ];
+	msg_t msg;
+
+	for ( const char *useTables : { "0", "1" } )
+	{
+		Cvar::SetValue( "msg_huffmanTables", useTables );
+
+		auto start = std::chrono::steady_clock::now();
+		for ( int i = 0; i < 50; i++ )
+		{
+			WriteFields( &msg, data, sizeof( data ), fields );
+		}
+		auto written = std::chrono::steady_clock::now();
+		int sum = 0;
+		for ( int i = 0; i < 50; i++ )
+		{
+			MSG_BeginReading( &msg );
+			for ( const Field &field : fields )
+			{
+				sum += MSG_ReadBits( &msg, field.bits );
+			}
+		}
+		auto read = std::chrono::steady_clock::now();
+
+		using us = std::chrono::microseconds;
+		printf( "msg_huffmanTables %s: write %ld us, read %ld us (%d)\n", useTables,
+			long( std::chrono::duration_cast<us>( written - start ).count() ),
+			long( std::chrono::duration_cast<us>( read - written ).count() ), sum );
+	}
+}
+
+} // namespace
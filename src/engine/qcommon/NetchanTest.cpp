@@ -0,0 +1,106 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "qcommon/qcommon.h"
+
+namespace {
+
+class NetchanTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		netadr_t loopback = {};
+		loopback.type = netadrtype_t::NA_LOOPBACK;
+		Netchan_Setup( netsrc_t::NS_SERVER, server.get(), loopback, 0 );
+		Netchan_Setup( netsrc_t::NS_CLIENT, client.get(), loopback, 0 );
+		MSG_Init( &msg, buffer, sizeof( buffer ) );
+	}
+
+	// Sends a message from the server and returns it as reassembled by the
+	// client, along with the number of packets it took
+	std::string Transfer( const std::string &data, int *packets )
+	{
+		Netchan_Transmit( server.get(), data.size(), reinterpret_cast<const byte *>( data.data() ) );
+
+		while ( server->unsentFragments )
+		{
+			Netchan_TransmitNextFragment( server.get() );
+		}
+
+		std::string received;
+		netadr_t from;
+		*packets = 0;
+
+		while ( NET_GetLoopPacket( netsrc_t::NS_CLIENT, &from, &msg ) )
+		{
+			++*packets;
+
+			if ( Netchan_Process( client.get(), &msg ) )
+			{
+				EXPECT_TRUE( received.empty() );
+				received.assign( reinterpret_cast<char *>( msg.data + msg.readcount ), msg.cursize - msg.readcount );
+			}
+		}
+
+		return received;
+	}
+
+	std::unique_ptr<netchan_t> server{ new netchan_t };
+	std::unique_ptr<netchan_t> client{ new netchan_t };
+	byte buffer[ MAX_MSGLEN ];
+	msg_t msg;
+};
+
+TEST_F( NetchanTest, Fragments )
+{
+	// around the loopback fragment size, including an exact multiple of
+	// it which needs an empty final fragment
+	for ( int length : { 0, 100, 1351, 1352, 1353, 2704, 5000, MAX_MSGLEN - 4 } )
+	{
+		SCOPED_TRACE( length );
+		std::string data( length, '\0' );
+
+		for ( int i = 0; i < length; i++ )
+		{
+			data[ i ] = i * 7 + length;
+		}
+
+		int packets;
+		ASSERT_EQ( Transfer( data, &packets ), data );
+		ASSERT_EQ( packets, length < 1352 ? 1 : length / 1352 + 1 );
+	}
+}
+
+} // namespace
@@ -40,6 +40,7 @@ Maryland 20850 USA.
 #include "qcommon.h"
 
 #include "common/Defs.h"
+#include "common/Profiler.h"
 
 #include "client/keys.h"
 #include "framework/Application.h"
@@ -284,7 +285,13 @@ std::unique_ptr<Sys::EventBase> Com_GetEvent()
 		Com_QueueEvent( Util::make_unique<Sys::ConsoleInputEvent>( s ) );
 	}
 
-	// check for network packets
+	// check for network packets, unless Com_EventLoop reads them in batches
+	// or from the network thread
+	if ( Sys_CanBatchPackets() || Sys_NetThreadRunning() )
+	{
+		return nullptr;
+	}
+
 	msg_t netmsg;
 	netadr_t adr;
 	MSG_Init( &netmsg, sys_packetReceived, sizeof( sys_packetReceived ) );
@@ -311,7 +318,7 @@ std::unique_ptr<Sys::EventBase> Com_GetEvent()
 Com_RunAndTimeServerPacket
 =================
 */
-static void Com_RunAndTimeServerPacket( const netadr_t *evFrom, msg_t *buf )
+static void Com_RunAndTimeServerPacket( const netadr_t *evFrom, msg_t *buf, int receiveTime )
 {
 	int t1, t2, msec;
 
@@ -331,7 +338,14 @@ static void Com_RunAndTimeServerPacket( const netadr_t *evFrom, msg_t *buf )
 
 		if ( com_speeds->integer == 3 )
 		{
-			Log::Notice( "SV_PacketEvent time: %i", msec );
+			if ( receiveTime )
+			{
+				Log::Notice( "SV_PacketEvent time: %i, queued for %i", msec, t1 - receiveTime );
+			}
+			else
+			{
+				Log::Notice( "SV_PacketEvent time: %i", msec );
+			}
 		}
 	}
 }
@@ -353,7 +367,7 @@ static void HandleConsoleInputEvent(const Sys::ConsoleInputEvent& event)
 	}
 }
 
-static void HandlePacketEvent(const Sys::PacketEvent& event)
+static void HandlePacket( const netadr_t& adr, msg_t *buf, int receiveTime = 0 )
 {
 	// this cvar allows simulation of connections that
 	// drop a lot of packets.  Note that loopback connections
@@ -367,6 +381,19 @@ static void HandlePacketEvent(const Sys::PacketEvent& event)
 			return; // drop this packet
 		}
 	}
+
+	if ( com_sv_running.Get() )
+	{
+		Com_RunAndTimeServerPacket( &adr, buf, receiveTime );
+	}
+	else
+	{
+		CL_PacketEvent( adr, buf );
+	}
+}
+
+static void HandlePacketEvent(const Sys::PacketEvent& event)
+{
 	msg_t buf;
 	byte bufData[ MAX_MSGLEN ];
 	MSG_Init( &buf, bufData, sizeof( bufData ) );
@@ -384,13 +411,74 @@ static void HandlePacketEvent(const Sys::PacketEvent& event)
 	buf.cursize = event.data.size();
 	memcpy( buf.data, event.data.data(), buf.cursize );
 
-	if ( com_sv_running.Get() )
+	HandlePacket( event.adr, &buf );
+}
+
+static const int PACKET_BATCH_SIZE = 32;
+
+/*
+=================
+Com_ReceivePacketBatches
+
+Drains the sockets with batched reads into a preallocated ring of
+message buffers and handles the packets in place, without going through
+the event queue. The buffers are MAX_MSGLEN bytes so the netchan can
+reassemble fragments in them.
+
+Handling a packet may run Com_EventLoop again, which must not reuse the
+buffers of the packets still being handled, so nested calls receive one
+packet at a time into their own buffer.
+=================
+*/
+static void Com_ReceivePacketBatches()
+{
+	static byte     packetBuffers[ PACKET_BATCH_SIZE ][ MAX_MSGLEN ];
+	static msg_t    packets[ PACKET_BATCH_SIZE ];
+	static netadr_t packetFrom[ PACKET_BATCH_SIZE ];
+	static int      depth = 0;
+
+	if ( depth > 0 )
 	{
-		Com_RunAndTimeServerPacket( &event.adr, &buf );
+		byte     bufData[ MAX_MSGLEN ];
+		msg_t    buf;
+		netadr_t from;
+
+		MSG_Init( &buf, bufData, sizeof( bufData ) );
+
+		while ( Sys_GetPacket( &from, &buf ) )
+		{
+			HandlePacket( from, &buf );
+			MSG_Init( &buf, bufData, sizeof( bufData ) );
+		}
+
+		return;
 	}
-	else
+
+	// a drop while handling a packet unwinds through here
+	struct depthGuard_t
+	{
+		depthGuard_t() { depth++; }
+		~depthGuard_t() { depth--; }
+	} depthGuard;
+
+	while ( true )
 	{
-		CL_PacketEvent( event.adr, &buf );
+		for ( int i = 0; i < PACKET_BATCH_SIZE; i++ )
+		{
+			MSG_Init( &packets[ i ], packetBuffers[ i ], sizeof( packetBuffers[ i ] ) );
+		}
+
+		int count = Sys_GetPackets( packetFrom, packets, PACKET_BATCH_SIZE );
+
+		for ( int i = 0; i < count; i++ )
+		{
+			HandlePacket( packetFrom[ i ], &packets[ i ] );
+		}
+
+		if ( count < PACKET_BATCH_SIZE )
+		{
+			return;
+		}
 	}
 }
 
@@ -423,6 +511,25 @@ void Com_EventLoop()
 				CL_MouseEvent( mouseX, mouseY );
 			}
 
+			if ( Sys_NetThreadRunning() )
+			{
+				int receiveTime;
+
+				// only the packets queued so far, the network thread keeps
+				// adding more during a flood
+				int queued = Sys_NumQueuedPackets();
+
+				while ( queued-- > 0 && Sys_GetQueuedPacket( &evFrom, &buf, &receiveTime ) )
+				{
+					HandlePacket( evFrom, &buf, receiveTime );
+					MSG_Init( &buf, bufData, sizeof( bufData ) );
+				}
+			}
+			else if ( Sys_CanBatchPackets() )
+			{
+				Com_ReceivePacketBatches();
+			}
+
 			// manually send packet events for the loopback channel
 			while ( NET_GetLoopPacket( netsrc_t::NS_CLIENT, &evFrom, &buf ) )
 			{
@@ -434,7 +541,7 @@ void Com_EventLoop()
 				// if the server just shut down, flush the events
 				if ( com_sv_running.Get() )
 				{
-					Com_RunAndTimeServerPacket( &evFrom, &buf );
+					Com_RunAndTimeServerPacket( &evFrom, &buf, 0 );
 				}
 			}
 
@@ -796,6 +903,9 @@ void Com_Frame()
 	static int      watchdogTime = 0;
 	static bool watchWarn = false;
 
+	Profiler::NewFrame();
+	PROFILE_ZONE( "Com_Frame" );
+
 	// bk001204 - init to zero.
 	//  also:  might be clobbered by `longjmp' or `vfork'
 	timeBeforeFirstEvents = 0;
@@ -1023,16 +1133,11 @@ void Com_Frame()
 	//
 	if ( showTraceStats.Get() )
 	{
-		extern int c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
-		extern int c_pointcontents;
-
-		Log::Notice( "%4i traces  (%ib %ip %it) %4i points", c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces,
-		            c_pointcontents );
-		c_traces = 0;
-		c_brush_traces = 0;
-		c_patch_traces = 0;
-		c_trisoup_traces = 0;
-		c_pointcontents = 0;
+		extern std::atomic<int> c_traces, c_brush_traces, c_patch_traces, c_trisoup_traces;
+		extern std::atomic<int> c_pointcontents;
+
+		Log::Notice( "%4i traces  (%ib %ip %it) %4i points", c_traces.exchange( 0 ), c_brush_traces.exchange( 0 ),
+		             c_patch_traces.exchange( 0 ), c_trisoup_traces.exchange( 0 ), c_pointcontents.exchange( 0 ) );
 	}
 
 	// old net chan encryption key
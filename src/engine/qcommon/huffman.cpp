@@ -39,7 +39,9 @@ Maryland 20850 USA.
 #include "qcommon/q_shared.h"
 #include "qcommon.h"
 
-static int bloc = 0;
+// thread local so that messages can be encoded from several threads at once,
+// see SV_SendClientSnapshotsParallel
+static thread_local int bloc = 0;
 
 //bani - optimized version
 //clears data along the way so we don't have to memset() it ahead of time
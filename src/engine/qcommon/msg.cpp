@@ -39,6 +39,33 @@ Maryland 20850 USA.
 static huffman_t msgHuff;
 static bool  msgInit = false;
 
+static Cvar::Cvar<bool> msg_huffmanTables("msg_huffmanTables",
+	"encode and decode network messages with Huffman lookup tables instead of walking the tree", Cvar::NONE, true);
+
+/*
+The Huffman tree built from msg_hData never changes, so each symbol's code can
+be computed once and written with a single store, and most codes can be decoded
+with a single lookup on the next HUFF_LOOKUP_BITS bits of the stream. Bits are
+stored starting from the lowest bit of each byte, so in both tables the first
+bit of a code is its lowest bit.
+*/
+struct huffCode_t
+{
+	uint32_t bits;
+	int      length;
+};
+
+struct huffLookup_t
+{
+	uint16_t symbol;
+	uint8_t  length; // 0 if the code is longer than HUFF_LOOKUP_BITS
+};
+
+static const int HUFF_LOOKUP_BITS = 11;
+static huffCode_t msgHuffCodes[ HMAX ];
+static huffLookup_t msgHuffLookup[ 1 << HUFF_LOOKUP_BITS ];
+static bool msgHuffTablesValid = false;
+
 /*
 ==============================================================================
 
@@ -135,6 +162,69 @@ bit functions
 =============================================================================
 */
 
+/*
+=============
+MSG_PutBits
+
+Writes up to 57 bits at once in bitstream mode, keeping the bits already
+written to the current byte and clearing the rest like Huff_putBit does.
+=============
+*/
+static void MSG_PutBits( msg_t *msg, uint64_t value, int bits )
+{
+	byte *out = msg->data + ( msg->bit >> 3 );
+	int  shift = msg->bit & 7;
+	int  numBytes = ( shift + bits + 7 ) >> 3;
+
+	value = ( value << shift ) | ( out[ 0 ] & ( ( 1 << shift ) - 1 ) );
+
+#ifdef Q3_LITTLE_ENDIAN
+	if ( msg->maxsize - ( msg->bit >> 3 ) >= 8 )
+	{
+		memcpy( out, &value, 8 );
+	}
+	else
+#endif
+	{
+		for ( int i = 0; i < numBytes; i++ )
+		{
+			out[ i ] = value >> ( 8 * i );
+		}
+	}
+
+	msg->bit += bits;
+}
+
+/*
+=============
+MSG_PeekBits
+
+Returns the next 57 or more bits of a bitstream, reading 0 past the end of the buffer.
+=============
+*/
+static uint64_t MSG_PeekBits( const msg_t *msg )
+{
+	const byte *in = msg->data + ( msg->bit >> 3 );
+	int available = msg->maxsize - ( msg->bit >> 3 );
+	uint64_t value = 0;
+
+#ifdef Q3_LITTLE_ENDIAN
+	if ( available >= 8 )
+	{
+		memcpy( &value, in, 8 );
+	}
+	else
+#endif
+	{
+		for ( int i = 0; i < std::min( available, 8 ); i++ )
+		{
+			value |= uint64_t( in[ i ] ) << ( 8 * i );
+		}
+	}
+
+	return value >> ( msg->bit & 7 );
+}
+
 // negative bit values include signs
 void MSG_WriteBits( msg_t *msg, int value, int bits )
 {
@@ -188,6 +278,36 @@ void MSG_WriteBits( msg_t *msg, int value, int bits )
 			Sys::Drop( "can't read %d bits", bits );
 		}
 	}
+	else if ( msgHuffTablesValid && msg_huffmanTables.Get() )
+	{
+		uint32_t remaining = value & ( 0xffffffff >> ( 32 - bits ) );
+		int      nbits = bits & 7;
+
+		// the bits that don't fill a byte are sent as they are, the bytes are Huffman coded
+		uint64_t acc = remaining & ( ( 1 << nbits ) - 1 );
+		int      accBits = nbits;
+		remaining >>= nbits;
+
+		for ( i = nbits; i < bits; i += 8 )
+		{
+			const huffCode_t &code = msgHuffCodes[ remaining & 0xff ];
+			remaining >>= 8;
+
+			if ( accBits + code.length > 57 )
+			{
+				MSG_PutBits( msg, acc, accBits );
+				acc = 0;
+				accBits = 0;
+			}
+
+			acc |= uint64_t( code.bits ) << accBits;
+			accBits += code.length;
+		}
+
+		MSG_PutBits( msg, acc, accBits );
+
+		msg->cursize = ( msg->bit >> 3 ) + 1;
+	}
 	else
 	{
 		value &= ( 0xffffffff >> ( 32 - bits ) );
@@ -220,6 +340,59 @@ void MSG_WriteBits( msg_t *msg, int value, int bits )
 	}
 }
 
+/*
+=============
+MSG_WriteBitstream
+
+Appends bits that were already written by MSG_WriteBits to another message
+in bitstream mode. The compressed encoding of a value doesn't depend on the
+bit position it starts at, so the result is the same as repeating the writes.
+The source bits past the end must be zero, as MSG_WriteBits leaves them.
+=============
+*/
+void MSG_WriteBitstream( msg_t *msg, const byte *data, int bits )
+{
+	if ( bits == 0 )
+	{
+		return;
+	}
+
+	int numBytes = ( bits + 7 ) >> 3;
+
+	if ( msg->maxsize - msg->cursize < numBytes + 32 )
+	{
+		msg->overflowed = true;
+		return;
+	}
+
+	byte *out = msg->data + ( msg->bit >> 3 );
+	int shift = msg->bit & 7;
+
+	if ( !shift )
+	{
+		memcpy( out, data, numBytes );
+	}
+	else
+	{
+		// keep the bits already written to the current byte
+		int carry = out[ 0 ] & ( ( 1 << shift ) - 1 );
+
+		for ( int i = 0; i < numBytes; i++ )
+		{
+			out[ i ] = carry | ( data[ i ] << shift );
+			carry = data[ i ] >> ( 8 - shift );
+		}
+
+		if ( ( ( shift + bits + 7 ) >> 3 ) > numBytes )
+		{
+			out[ numBytes ] = carry;
+		}
+	}
+
+	msg->bit += bits;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
 int MSG_ReadBits( msg_t *msg, int bits )
 {
 	int      value;
@@ -268,6 +441,32 @@ int MSG_ReadBits( msg_t *msg, int bits )
 			Sys::Drop( "can't read %d bits", bits );
 		}
 	}
+	else if ( msgHuffTablesValid && msg_huffmanTables.Get() )
+	{
+		int nbits = bits & 7;
+
+		value = MSG_PeekBits( msg ) & ( ( 1 << nbits ) - 1 );
+		msg->bit += nbits;
+
+		for ( i = nbits; i < bits; i += 8 )
+		{
+			const huffLookup_t &entry = msgHuffLookup[ MSG_PeekBits( msg ) & ( ( 1 << HUFF_LOOKUP_BITS ) - 1 ) ];
+
+			if ( entry.length )
+			{
+				get = entry.symbol;
+				msg->bit += entry.length;
+			}
+			else
+			{
+				Huff_offsetReceive( msgHuff.decompressor.tree, &get, msg->data, &msg->bit );
+			}
+
+			value |= get << i;
+		}
+
+		msg->readcount = ( msg->bit >> 3 ) + 1;
+	}
 	else
 	{
 		for ( i = 0; i < ( bits & 7 ); i++ )
@@ -756,6 +955,87 @@ void MSG_ReadDeltaUsercmd( msg_t *msg, usercmd_t *from, usercmd_t *to )
 /*
 =============================================================================
 
+Changed field masks
+
+All the fields of entity and player states are 32 bits, so instead of going
+through the field table and comparing each field through its offset, the
+delta writers compare the two states a word at a time into a bitmask of the
+words that changed. For entities, a table built once maps those words to
+their position in entityStateFields, so the writer gets the changed fields
+in table order and only visits those. Most entities don't change from one
+snapshot to the next, so this mostly replaces a walk of the whole table with
+a few vector compares. The wire format is the same either way.
+
+=============================================================================
+*/
+
+static Cvar::Cvar<bool> msg_deltaMasks("msg_deltaMasks",
+	"find the changed fields of entity and player states by comparing them a word at a time", Cvar::NONE, true);
+
+static const int MAX_STATE_WORDS = MAX_PLAYERSTATE_SIZE / 4;
+static_assert( sizeof( entityState_t ) / 4 <= MAX_STATE_WORDS, "entityState_t doesn't fit in a changed words mask" );
+
+struct changedWords_t
+{
+	uint64_t bits[ ( MAX_STATE_WORDS + 63 ) / 64 ];
+
+	bool Test( int word ) const
+	{
+		return ( bits[ word / 64 ] >> ( word % 64 ) ) & 1;
+	}
+};
+
+static void MSG_CompareWords( changedWords_t *changed, const void *from, const void *to, int numWords )
+{
+	const int *a = static_cast<const int *>( from );
+	const int *b = static_cast<const int *>( to );
+	int       i = 0;
+
+	memset( changed->bits, 0, sizeof( changed->bits ) );
+
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse2)
+	// groups of 4 words never straddle two 64 bit masks
+	for ( ; i + 4 <= numWords; i += 4 )
+	{
+		__m128i equal = _mm_cmpeq_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i *>( a + i ) ),
+		                                 _mm_loadu_si128( reinterpret_cast<const __m128i *>( b + i ) ) );
+		uint64_t different = ~_mm_movemask_ps( _mm_castsi128_ps( equal ) ) & 0xf;
+		changed->bits[ i / 64 ] |= different << ( i % 64 );
+	}
+#endif
+
+	for ( ; i < numWords; i++ )
+	{
+		if ( a[ i ] != b[ i ] )
+		{
+			changed->bits[ i / 64 ] |= uint64_t( 1 ) << ( i % 64 );
+		}
+	}
+}
+
+// Whether a field of numWords words at the given offset differs, either from the
+// mask or by comparing the states directly
+static bool MSG_FieldChanged( const changedWords_t *changed, const void *from, const void *to, int offset, int numWords )
+{
+	if ( !changed )
+	{
+		return memcmp( ( const byte * ) from + offset, ( const byte * ) to + offset, numWords * 4 ) != 0;
+	}
+
+	for ( int word = offset / 4; word < offset / 4 + numWords; word++ )
+	{
+		if ( changed->Test( word ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+=============================================================================
+
 entityState_t communication
 
 =============================================================================
@@ -877,6 +1157,46 @@ void MSG_PrioritiseEntitystateFields()
 static const int FLOAT_INT_BITS = 13;
 static const int FLOAT_INT_BIAS = ( 1 << ( FLOAT_INT_BITS - 1 ) );
 
+// The position in entityStateFields of each word of entityState_t, -1 for the number
+static std::array<int, sizeof( entityState_t ) / 4> MSG_EntityWordFields()
+{
+	std::array<int, sizeof( entityState_t ) / 4> wordFields;
+	wordFields.fill( -1 );
+
+	for ( size_t i = 0; i < ARRAY_LEN( entityStateFields ); i++ )
+	{
+		wordFields[ entityStateFields[ i ].offset / 4 ] = i;
+	}
+
+	return wordFields;
+}
+
+static uint64_t MSG_EntityChangedFields( const entityState_t *from, const entityState_t *to )
+{
+	static_assert( ARRAY_LEN( entityStateFields ) <= 64, "entityStateFields don't fit in a 64 bit mask" );
+	static const std::array<int, sizeof( entityState_t ) / 4> wordFields = MSG_EntityWordFields();
+
+	changedWords_t changed;
+	MSG_CompareWords( &changed, from, to, wordFields.size() );
+
+	uint64_t changedFields = 0;
+
+	for ( size_t n = 0; n < ARRAY_LEN( changed.bits ); n++ )
+	{
+		for ( uint64_t bits = changed.bits[ n ]; bits; bits &= bits - 1 )
+		{
+			int field = wordFields[ n * 64 + CountTrailingZeroes( bits ) ];
+
+			if ( field >= 0 )
+			{
+				changedFields |= uint64_t( 1 ) << field;
+			}
+		}
+	}
+
+	return changedFields;
+}
+
 /*
 ==================
 MSG_WriteDeltaEntity
@@ -894,7 +1214,7 @@ void MSG_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, b
 	netField_t *field;
 	int        trunc;
 	float      fullFloat;
-	int        *fromF, *toF;
+	int        *toF;
 
 	const int numFields = ARRAY_LEN(entityStateFields);
 
@@ -929,17 +1249,36 @@ void MSG_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, b
 
 	lc = 0;
 
-	// build the change vector as bytes so it is endian independent
-	for ( i = 0, field = entityStateFields; i < numFields; i++, field++ )
-	{
-		fromF = ( int * )( ( byte * ) from + field->offset );
-		toF = ( int * )( ( byte * ) to + field->offset );
+	// bit i is set when entityStateFields[ i ] changed
+	uint64_t changedFields = 0;
 
-		if ( *fromF != *toF )
+	if ( msg_deltaMasks.Get() )
+	{
+		changedFields = MSG_EntityChangedFields( from, to );
+	}
+	else
+	{
+		for ( i = 0, field = entityStateFields; i < numFields; i++, field++ )
 		{
-			lc = i + 1;
+			if ( MSG_FieldChanged( nullptr, from, to, field->offset, 1 ) )
+			{
+				changedFields |= uint64_t( 1 ) << i;
+			}
+		}
+	}
+
+	// the usage statistics are not worth synchronizing when snapshots
+	// are encoded on worker threads
+	bool countUsage = changedFields && Sys::OnMainThread();
+
+	for ( uint64_t bits = changedFields; bits; bits &= bits - 1 )
+	{
+		i = CountTrailingZeroes( bits );
+		lc = i + 1;
 
-			field->used++;
+		if ( countUsage )
+		{
+			entityStateFields[ i ].used++;
 		}
 	}
 
@@ -968,10 +1307,9 @@ void MSG_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, b
 
 	for ( i = 0, field = entityStateFields; i < lc; i++, field++ )
 	{
-		fromF = ( int * )( ( byte * ) from + field->offset );
 		toF = ( int * )( ( byte * ) to + field->offset );
 
-		if ( *fromF == *toF )
+		if ( !( ( changedFields >> i ) & 1 ) )
 		{
 			MSG_WriteBits( msg, 0, 1 );  // no change
 			continue;
@@ -1066,7 +1404,7 @@ void MSG_ReadDeltaEntity( msg_t *msg, const entityState_t *from, entityState_t *
 	int        i, lc;
 	int        numFields;
 	netField_t *field;
-	int        *fromF, *toF;
+	int        *toF;
 	int        print;
 	int        trunc;
 	int        startBit, endBit;
@@ -1127,19 +1465,19 @@ void MSG_ReadDeltaEntity( msg_t *msg, const entityState_t *from, entityState_t *
 		print = 0;
 	}
 
+	// unchanged fields keep their old value
+	if ( to != from )
+	{
+		*to = *from;
+	}
+
 	to->number = number;
 
 	for ( i = 0, field = entityStateFields; i < lc; i++, field++ )
 	{
-		fromF = ( int * )( ( byte * ) from + field->offset );
 		toF = ( int * )( ( byte * ) to + field->offset );
 
-		if ( !MSG_ReadBits( msg, 1 ) )
-		{
-			// no change
-			*toF = *fromF;
-		}
-		else
+		if ( MSG_ReadBits( msg, 1 ) )
 		{
 			if ( field->bits == 0 )
 			{
@@ -1195,14 +1533,6 @@ void MSG_ReadDeltaEntity( msg_t *msg, const entityState_t *from, entityState_t *
 		}
 	}
 
-	for ( i = lc, field = &entityStateFields[ lc ]; i < numFields; i++, field++ )
-	{
-		fromF = ( int * )( ( byte * ) from + field->offset );
-		toF = ( int * )( ( byte * ) to + field->offset );
-		// no change
-		*toF = *fromF;
-	}
-
 	if ( print )
 	{
 		if ( msg->bit == 0 )
@@ -1256,6 +1586,7 @@ void MSG_InitNetcodeTables(NetcodeTable playerStateTable, int psSize) {
 	playerStateFields = std::move(playerStateTable);
 	playerStateSize = psSize;
 }
+
 // TODO: add function to clear
 
 
@@ -1337,6 +1668,11 @@ MSG_WriteDeltaPlayerstate
 =============
 */
 void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to )
+{
+	MSG_WriteDeltaPlayerstate( msg, from, to, playerStateFields, playerStateSize );
+}
+
+void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to, NetcodeTable &fields, int psSize )
 {
 	int           lc;
 	int        *fromF, *toF;
@@ -1345,13 +1681,13 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlaye
 	int        startBit, endBit;
 	int        print;
 
-	if ( playerStateFields.empty() )
+	if ( fields.empty() )
 		Sys::Drop( "no netcode table" );
 
 	OpaquePlayerState dummy;
 	if ( !from )
 	{
-		memset( &dummy, 0, playerStateSize );
+		memset( &dummy, 0, psSize );
 		from = &dummy;
 	}
 
@@ -1376,23 +1712,45 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlaye
 		print = 0;
 	}
 
-	int numFields = playerStateFields.size();
+	int numFields = fields.size();
 
 	lc = 0;
 
-	for ( int i = 0; i < numFields; i++ )
+	changedWords_t  changedWords;
+	changedWords_t *changed = nullptr;
+
+	if ( msg_deltaMasks.Get() )
 	{
-		netField_t* field = &playerStateFields[i];
-		fromF = ( int * )( ( byte * ) from + field->offset );
-		toF = ( int * )( ( byte * ) to + field->offset );
+		MSG_CompareWords( &changedWords, from, to, psSize / 4 );
+		changed = &changedWords;
+	}
 
-		if (field->bits == STATS_GROUP_FIELD
-			? memcmp(fromF, toF, sizeof(int) * STATS_GROUP_NUM_STATS)
-			: *fromF != *toF )
-		{
-			lc = i + 1;
+	auto fieldChanged = [&]( const netField_t &field ) {
+		return MSG_FieldChanged( changed, from, to, field.offset,
+		                         field.bits == STATS_GROUP_FIELD ? STATS_GROUP_NUM_STATS : 1 );
+	};
 
-			field->used++;
+	// see MSG_WriteDeltaEntity
+	if ( Sys::OnMainThread() )
+	{
+		for ( int i = 0; i < numFields; i++ )
+		{
+			if ( fieldChanged( fields[ i ] ) )
+			{
+				lc = i + 1;
+				fields[ i ].used++;
+			}
+		}
+	}
+	else
+	{
+		for ( int i = numFields; i > 0; i-- )
+		{
+			if ( fieldChanged( fields[ i - 1 ] ) )
+			{
+				lc = i;
+				break;
+			}
 		}
 	}
 
@@ -1400,7 +1758,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlaye
 
 	for ( int i = 0; i < lc; i++ )
 	{
-		netField_t* field = &playerStateFields[i];
+		netField_t* field = &fields[i];
 		fromF = ( int * )( ( byte * ) from + field->offset );
 		toF = ( int * )( ( byte * ) to + field->offset );
 
@@ -1409,7 +1767,7 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlaye
 			WriteStatsGroup(msg, fromF, toF);
 			continue;
 		}
-		if ( *fromF == *toF )
+		if ( !fieldChanged( *field ) )
 		{
 			MSG_WriteBits( msg, 0, 1 );  // no change
 			continue;
@@ -1487,23 +1845,28 @@ MSG_ReadDeltaPlayerstate
 ===================
 */
 void MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to )
+{
+	MSG_ReadDeltaPlayerstate( msg, from, to, playerStateFields, playerStateSize );
+}
+
+void MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to, const NetcodeTable &fields, int psSize )
 {
 	int           lc;
 	int           startBit, endBit;
 	int           print;
-	int           *fromF, *toF;
+	int           *toF;
 	int           trunc;
 
-	if (playerStateFields.empty())
+	if (fields.empty())
 		Sys::Drop("no netcode table");
 
 	OpaquePlayerState dummy;
 	if ( !from )
 	{
-		memset( &dummy, 0, playerStateSize );
+		memset( &dummy, 0, psSize );
 		from = &dummy;
 	}
-	memcpy( to, from, playerStateSize );
+	memcpy( to, from, psSize );
 
 	if ( msg->bit == 0 )
 	{
@@ -1526,7 +1889,7 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayer
 		print = 0;
 	}
 
-	int numFields = playerStateFields.size();
+	int numFields = fields.size();
 	lc = MSG_ReadByte( msg );
 
 	if ( lc > numFields || lc < 0 )
@@ -1536,19 +1899,11 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayer
 
 	for ( int i = 0; i < lc; i++ )
 	{
-		netField_t* field = &playerStateFields[i];
-		fromF = ( int * )( ( byte * ) from + field->offset );
+		const netField_t* field = &fields[i];
 		toF = ( int * )( ( byte * ) to + field->offset );
 
-		if ( !MSG_ReadBits( msg, 1 ) )
-		{
-			// no change
-			if (field->bits == STATS_GROUP_FIELD)
-				memcpy(toF, fromF, sizeof(int) * STATS_GROUP_NUM_STATS);
-			else
-				*toF = *fromF;
-		}
-		else
+		// unchanged fields were copied from the old state above
+		if ( MSG_ReadBits( msg, 1 ) )
 		{
 			if ( field->bits == 0 )
 			{
@@ -1869,6 +2224,47 @@ static const int msg_hData[ 256 ] =
 	13504, // 255
 };
 
+static void MSG_initHuffmanTables()
+{
+	msgHuffTablesValid = false;
+
+	for ( int ch = 0; ch < HMAX; ch++ )
+	{
+		huffCode_t &code = msgHuffCodes[ ch ];
+		code.bits = 0;
+		code.length = 0;
+
+		// walk up to the root, the last bit found is the first one sent
+		for ( const node_t *node = msgHuff.compressor.loc[ ch ]; node->parent; node = node->parent )
+		{
+			if ( code.length == 32 )
+			{
+				return;
+			}
+
+			code.bits = ( code.bits << 1 ) | ( node->parent->right == node );
+			code.length++;
+		}
+	}
+
+	for ( int prefix = 0; prefix < ( 1 << HUFF_LOOKUP_BITS ); prefix++ )
+	{
+		const node_t *node = msgHuff.decompressor.tree;
+		int length = 0;
+
+		while ( node->symbol == INTERNAL_NODE && length < HUFF_LOOKUP_BITS )
+		{
+			node = ( prefix >> length ) & 1 ? node->right : node->left;
+			length++;
+		}
+
+		msgHuffLookup[ prefix ].symbol = node->symbol;
+		msgHuffLookup[ prefix ].length = node->symbol == INTERNAL_NODE ? 0 : length;
+	}
+
+	msgHuffTablesValid = true;
+}
+
 void MSG_initHuffman()
 {
 	int i, j;
@@ -1884,6 +2280,8 @@ void MSG_initHuffman()
 			Huff_addRef( &msgHuff.decompressor, ( byte ) i );  /* Do update */
 		}
 	}
+
+	MSG_initHuffmanTables();
 }
 
 //===========================================================================
@@ -43,7 +43,7 @@ packet header
 4 outgoing sequence.  high bit will be set if this is a fragmented message
 [2  qport (only for client to server)]
 [2  fragment start byte]
-[2  fragment length. if < FRAGMENT_SIZE, this is the last fragment]
+[2  fragment length. if shorter than the first fragment, this is the last fragment]
 
 if the sequence number is -1, the packet should be handled as an out-of-band
 message instead of as part of a netcon.
@@ -63,6 +63,10 @@ static const int MAX_PACKETLEN = 1400; // max size of a network packet
 
 static const int FRAGMENT_SIZE = ( MAX_PACKETLEN - 100 );
 
+// largest fragment that still fits in a packet with the fragment header,
+// keeping the 32 bytes of slack the MSG_Write functions require
+static const int MAX_FRAGMENT_SIZE = ( MAX_PACKETLEN - 48 );
+
 static const int FRAGMENT_BIT  = ( 1 << 31 );
 
 cvar_t      *showpackets;
@@ -70,6 +74,11 @@ cvar_t      *showdrop;
 static Cvar::Cvar<int> qport(
 	"net_qport", "random 16-bit value used to uniquely identify clients behind NAT",
 	Cvar::NONE, -1);
+// Receivers take the fragment size from the first fragment of each message,
+// but older engines expect FRAGMENT_SIZE: only change this with up to date peers.
+static Cvar::Range<Cvar::Cvar<int>> net_fragmentSize(
+	"net_fragmentSize", "size of the fragments of large messages, lower it if the path MTU is small",
+	Cvar::NONE, FRAGMENT_SIZE, 512, MAX_FRAGMENT_SIZE);
 
 static const char *const netsrcString[ 2 ] =
 {
@@ -113,6 +122,23 @@ void Netchan_Setup( netsrc_t sock, netchan_t *chan, const netadr_t& adr, int qpo
 	chan->outgoingSequence = 1;
 }
 
+/*
+=================
+Netchan_FragmentSize
+
+Loopback packets never leave the process, so they don't have an MTU
+=================
+*/
+static int Netchan_FragmentSize( const netchan_t *chan )
+{
+	if ( chan->remoteAddress.type == netadrtype_t::NA_LOOPBACK )
+	{
+		return MAX_FRAGMENT_SIZE;
+	}
+
+	return net_fragmentSize.Get();
+}
+
 /*
 =================
 Netchan_TransmitNextFragment
@@ -138,7 +164,7 @@ void Netchan_TransmitNextFragment( netchan_t *chan )
 	}
 
 	// copy the reliable message to the packet first
-	fragmentLength = FRAGMENT_SIZE;
+	fragmentLength = chan->unsentFragmentSize;
 
 	if ( chan->unsentFragmentStart  + fragmentLength > chan->unsentLength )
 	{
@@ -167,7 +193,7 @@ void Netchan_TransmitNextFragment( netchan_t *chan )
 	// that is exactly the fragment length still needs to send
 	// a second packet of zero length so that the other side
 	// can tell there aren't more to follow
-	if ( chan->unsentFragmentStart == chan->unsentLength && fragmentLength != FRAGMENT_SIZE )
+	if ( chan->unsentFragmentStart == chan->unsentLength && fragmentLength != chan->unsentFragmentSize )
 	{
 		chan->outgoingSequence++;
 		chan->unsentFragments = false;
@@ -186,6 +212,7 @@ void Netchan_Transmit( netchan_t *chan, int length, const byte *data )
 {
 	msg_t send;
 	byte  send_buf[ MAX_PACKETLEN ];
+	int   fragmentSize = Netchan_FragmentSize( chan );
 
 	if ( length > MAX_MSGLEN )
 	{
@@ -195,9 +222,10 @@ void Netchan_Transmit( netchan_t *chan, int length, const byte *data )
 	chan->unsentFragmentStart = 0;
 
 	// fragment large reliable messages
-	if ( length >= FRAGMENT_SIZE )
+	if ( length >= fragmentSize )
 	{
 		chan->unsentFragments = true;
+		chan->unsentFragmentSize = fragmentSize;
 		chan->unsentLength = length;
 		memcpy( chan->unsentBuffer, data, length );
 
@@ -370,7 +398,8 @@ bool Netchan_Process( netchan_t *chan, msg_t *msg )
 
 		// copy the fragment to the fragment buffer
 		if ( fragmentLength < 0 || msg->readcount + fragmentLength > msg->cursize ||
-		     chan->fragmentLength + fragmentLength > (int) sizeof( chan->fragmentBuffer ) )
+		     chan->fragmentLength + fragmentLength > (int) sizeof( chan->fragmentBuffer ) ||
+		     ( fragmentStart == 0 && fragmentLength == 0 ) )
 		{
 			if ( showdrop->integer || showpackets->integer )
 			{
@@ -381,18 +410,25 @@ bool Netchan_Process( netchan_t *chan, msg_t *msg )
 			return false;
 		}
 
+		// messages are only fragmented when they don't fit in one fragment, so the
+		// first fragment is never the last one and tells the sender's fragment size
+		if ( fragmentStart == 0 )
+		{
+			chan->fragmentSize = fragmentLength;
+		}
+
 		memcpy( chan->fragmentBuffer + chan->fragmentLength,
 		            msg->data + msg->readcount, fragmentLength );
 
 		chan->fragmentLength += fragmentLength;
 
 		// if this wasn't the last fragment, don't process anything
-		if ( fragmentLength == FRAGMENT_SIZE )
+		if ( fragmentLength == chan->fragmentSize )
 		{
 			return false;
 		}
 
-		if ( chan->fragmentLength > msg->maxsize )
+		if ( chan->fragmentLength + 4 > msg->maxsize )
 		{
 			Log::Notice( "%s: fragmentLength %i > msg->maxsize"
 			            , NET_AdrToString( chan->remoteAddress ),
@@ -437,8 +473,8 @@ LOOPBACK BUFFERS FOR LOCAL PLAYER
 */
 
 // there needs to be enough loopback messages to hold a complete
-// gamestate of maximum size
-static const int MAX_LOOPBACK = 16;
+// gamestate of maximum size, which sv_fragmentBurst sends all at once
+static const int MAX_LOOPBACK = 32;
 
 struct loopmsg_t
 {
@@ -34,11 +34,17 @@ Maryland 20850 USA.
 
 #include "qcommon/q_shared.h"
 #include "qcommon/qcommon.h"
+#include "qcommon/sys.h"
 #include <common/FileSystem.h>
 #include "engine/framework/Application.h"
 #include "engine/framework/Network.h"
 #include "server/server.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #ifdef _WIN32
 #       include <winsock2.h>
 #       include <ws2tcpip.h>
@@ -74,6 +80,7 @@ namespace net {
 		constexpr auto address_not_available = WSAEADDRNOTAVAIL;
 		constexpr auto address_family_not_supported = WSAEAFNOSUPPORT;
 		constexpr auto connection_reset = WSAECONNRESET;
+		constexpr auto connection_refused = WSAECONNREFUSED;
 	}  // namespace errc
 }  // namespace net
 
@@ -118,6 +125,7 @@ namespace net {
 		constexpr auto address_not_available = EADDRNOTAVAIL;
 		constexpr auto address_family_not_supported = EAFNOSUPPORT;
 		constexpr auto connection_reset = ECONNRESET;
+		constexpr auto connection_refused = ECONNREFUSED;
 	}  // namespace errc
 }  // namespace net
 
@@ -141,6 +149,12 @@ static cvar_t              *net_port6;
 static cvar_t              *net_mcast6addr;
 static cvar_t              *net_mcast6iface;
 
+static Cvar::Cvar<bool> net_batchPackets(
+	"net_batchPackets", "receive and send UDP packets in batches where the platform supports it", Cvar::NONE, true );
+
+static Cvar::Cvar<bool> net_thread(
+	"net_thread", "receive the packets of a dedicated server on a separate thread, applied on net_restart", Cvar::NONE, false );
+
 static struct sockaddr     socksRelayAddr;
 
 static SOCKET              ip_socket = INVALID_SOCKET;
@@ -698,10 +712,519 @@ bool Sys_GetPacket( netadr_t *net_from, msg_t *net_message )
 	return false;
 }
 
+#ifdef __linux__
+static const int MAX_PACKET_BATCH = 64;
+
+/*
+==================
+NET_ReceiveBatch
+
+Receives up to count packets from a socket with a single system call
+==================
+*/
+static int NET_ReceiveBatch( SOCKET socket, netadr_t *net_from, msg_t *net_messages, int count )
+{
+	struct mmsghdr          headers[ MAX_PACKET_BATCH ];
+	struct iovec            iovecs[ MAX_PACKET_BATCH ];
+	struct sockaddr_storage from[ MAX_PACKET_BATCH ];
+
+	count = std::min( count, MAX_PACKET_BATCH );
+
+	for ( int i = 0; i < count; i++ )
+	{
+		iovecs[ i ].iov_base = net_messages[ i ].data;
+		iovecs[ i ].iov_len = net_messages[ i ].maxsize;
+		memset( &headers[ i ], 0, sizeof( headers[ i ] ) );
+		headers[ i ].msg_hdr.msg_name = &from[ i ];
+		headers[ i ].msg_hdr.msg_namelen = sizeof( from[ i ] );
+		headers[ i ].msg_hdr.msg_iov = &iovecs[ i ];
+		headers[ i ].msg_hdr.msg_iovlen = 1;
+	}
+
+	int ret = recvmmsg( socket, headers, count, MSG_DONTWAIT, nullptr );
+
+	if ( ret == SOCKET_ERROR )
+	{
+		int err = socketError;
+
+		if ( err != net::errc::resource_unavailable_try_again && err != net::errc::connection_reset )
+		{
+			Log::Notice( "NET_GetPackets: %s", NET_ErrorString() );
+		}
+
+		return 0;
+	}
+
+	// drop the oversize packets, moving the following ones down
+	int received = 0;
+
+	for ( int i = 0; i < ret; i++ )
+	{
+		netadr_t adr;
+		int length = headers[ i ].msg_len;
+
+		SockadrToNetadr( ( struct sockaddr * ) &from[ i ], &adr );
+
+		if ( length == net_messages[ i ].maxsize || ( headers[ i ].msg_hdr.msg_flags & MSG_TRUNC ) )
+		{
+			Log::Notice( "Oversize packet from %s", NET_AdrToString( adr ) );
+			continue;
+		}
+
+		std::swap( net_messages[ received ], net_messages[ i ] );
+		net_from[ received ] = adr;
+		net_messages[ received ].readcount = 0;
+		net_messages[ received ].cursize = length;
+		received++;
+	}
+
+	return received;
+}
+#endif
+
+/*
+==================
+Sys_CanBatchPackets
+==================
+*/
+bool Sys_CanBatchPackets()
+{
+#ifdef __linux__
+	// the SOCKS relay header is only handled by Sys_GetPacket; clients
+	// receive few packets and can run nested event loops while handling them
+	return net_batchPackets.Get() && !usingSocks && Com_IsDedicatedServer();
+#else
+	return false;
+#endif
+}
+
+/*
+==================
+Sys_GetPackets
+
+Never called by the game logic, just the system event loop
+==================
+*/
+int Sys_GetPackets( netadr_t *net_from, msg_t *net_messages, int count )
+{
+	int received = 0;
+
+#ifdef __linux__
+	for ( SOCKET socket : { ip_socket, ip6_socket, multicast6_socket } )
+	{
+		if ( socket == INVALID_SOCKET || received == count )
+		{
+			continue;
+		}
+
+		if ( socket == multicast6_socket && socket == ip6_socket )
+		{
+			continue;
+		}
+
+		received += NET_ReceiveBatch( socket, net_from + received, net_messages + received, count - received );
+	}
+#else
+	Q_UNUSED( net_from );
+	Q_UNUSED( net_messages );
+	Q_UNUSED( count );
+#endif
+
+	return received;
+}
+
+//=============================================================================
+
+// Single producer, single consumer ring of the packets received by the
+// network thread: only the network thread moves the head and only the main
+// thread moves the tail.
+static const int NET_QUEUE_SIZE = 1024; // must be a power of two
+
+// Client packets are fragmented well below this, anything larger is dropped
+static const int MAX_QUEUED_RECEIVE = 4096;
+
+struct receivedPacket_t
+{
+	netadr_t from;
+	int      time;
+	int      length;
+	byte     data[ MAX_QUEUED_RECEIVE ];
+};
+
+static std::unique_ptr<receivedPacket_t[]> receivedPackets;
+static std::atomic<uint32_t>               receivedHead{ 0 };
+static std::atomic<uint32_t>               receivedTail{ 0 };
+static std::atomic<int>                    receivedDropped{ 0 };
+
+static std::thread             netThread;
+static std::atomic<bool>       netThreadQuit{ false };
+static std::mutex              netWakeMutex;
+static std::condition_variable netWake;
+
+/*
+==================
+NET_WaitForPacket
+
+Blocks until one of the sockets is readable or msec have passed
+==================
+*/
+static void NET_WaitForPacket( int msec )
+{
+	struct timeval timeout;
+
+	fd_set         fdset;
+	SOCKET         highestfd = INVALID_SOCKET;
+
+	FD_ZERO( &fdset );
+
+	for ( SOCKET socket : { ip_socket, ip6_socket, multicast6_socket } )
+	{
+		if ( socket != INVALID_SOCKET )
+		{
+			FD_SET( socket, &fdset );
+
+			if ( highestfd == INVALID_SOCKET || socket > highestfd )
+			{
+				highestfd = socket;
+			}
+		}
+	}
+
+	if ( highestfd == INVALID_SOCKET )
+	{
+		std::this_thread::sleep_for( std::chrono::milliseconds( msec ) );
+		return;
+	}
+
+	timeout.tv_sec = msec / 1000;
+	timeout.tv_usec = ( msec % 1000 ) * 1000;
+	select( highestfd + 1, &fdset, nullptr, nullptr, &timeout );
+}
+
+/*
+==================
+NET_ThreadMain
+==================
+*/
+static const int NET_THREAD_BATCH = 32;
+
+static void NET_ThreadMain( bool batch )
+{
+	std::unique_ptr<byte[]> buffers( new byte[ NET_THREAD_BATCH * MAX_MSGLEN ] );
+	msg_t    messages[ NET_THREAD_BATCH ];
+	netadr_t from[ NET_THREAD_BATCH ];
+
+	while ( !netThreadQuit.load( std::memory_order_relaxed ) )
+	{
+		// wake up regularly to check whether we must quit
+		NET_WaitForPacket( 100 );
+
+		int count = 0;
+
+		for ( int i = 0; i < NET_THREAD_BATCH; i++ )
+		{
+			MSG_Init( &messages[ i ], buffers.get() + i * MAX_MSGLEN, MAX_MSGLEN );
+		}
+
+		if ( batch )
+		{
+			count = Sys_GetPackets( from, messages, NET_THREAD_BATCH );
+		}
+		else
+		{
+			while ( count < NET_THREAD_BATCH && Sys_GetPacket( &from[ count ], &messages[ count ] ) )
+			{
+				count++;
+			}
+		}
+
+		int time = Sys::Milliseconds();
+		bool queued = false;
+
+		for ( int i = 0; i < count; i++ )
+		{
+			const byte *data = messages[ i ].data + messages[ i ].readcount;
+			int length = messages[ i ].cursize - messages[ i ].readcount;
+
+			if ( length > MAX_QUEUED_RECEIVE )
+			{
+				receivedDropped++;
+				continue;
+			}
+
+			if ( !SV_FilterPacket( from[ i ], data, length, time ) )
+			{
+				continue;
+			}
+
+			uint32_t head = receivedHead.load( std::memory_order_relaxed );
+
+			if ( head - receivedTail.load( std::memory_order_acquire ) == NET_QUEUE_SIZE )
+			{
+				receivedDropped++;
+				continue;
+			}
+
+			receivedPacket_t *packet = &receivedPackets[ head & ( NET_QUEUE_SIZE - 1 ) ];
+			packet->from = from[ i ];
+			packet->time = time;
+			packet->length = length;
+			memcpy( packet->data, data, length );
+			receivedHead.store( head + 1, std::memory_order_release );
+			queued = true;
+		}
+
+		if ( queued )
+		{
+			// taking the lock makes sure NET_Sleep is either not checking
+			// the queue yet or already waiting
+			{
+				std::lock_guard<std::mutex> lock( netWakeMutex );
+			}
+
+			netWake.notify_one();
+		}
+	}
+}
+
+/*
+==================
+NET_StartThread
+==================
+*/
+static void NET_StartThread()
+{
+	if ( !receivedPackets )
+	{
+		receivedPackets.reset( new receivedPacket_t[ NET_QUEUE_SIZE ] );
+	}
+
+	receivedHead = 0;
+	receivedTail = 0;
+	receivedDropped = 0;
+	netThreadQuit = false;
+	netThread = std::thread( NET_ThreadMain, Sys_CanBatchPackets() );
+}
+
+/*
+==================
+NET_StopThread
+
+Must be called before the sockets are closed
+==================
+*/
+static void NET_StopThread()
+{
+	if ( !netThread.joinable() )
+	{
+		return;
+	}
+
+	netThreadQuit = true;
+	netThread.join();
+}
+
+bool Sys_NetThreadRunning()
+{
+	return netThread.joinable();
+}
+
+/*
+==================
+Sys_NumQueuedPackets
+==================
+*/
+int Sys_NumQueuedPackets()
+{
+	int dropped = receivedDropped.exchange( 0 );
+
+	if ( dropped )
+	{
+		Log::Notice( "Network thread dropped %i packets", dropped );
+	}
+
+	return receivedHead.load( std::memory_order_acquire ) - receivedTail.load( std::memory_order_relaxed );
+}
+
+/*
+==================
+Sys_GetQueuedPacket
+==================
+*/
+bool Sys_GetQueuedPacket( netadr_t *net_from, msg_t *net_message, int *receiveTime )
+{
+	uint32_t tail = receivedTail.load( std::memory_order_relaxed );
+
+	if ( tail == receivedHead.load( std::memory_order_acquire ) )
+	{
+		return false;
+	}
+
+	const receivedPacket_t *packet = &receivedPackets[ tail & ( NET_QUEUE_SIZE - 1 ) ];
+	*net_from = packet->from;
+	*receiveTime = packet->time;
+	memcpy( net_message->data, packet->data, packet->length );
+	net_message->cursize = packet->length;
+	net_message->readcount = 0;
+	receivedTail.store( tail + 1, std::memory_order_release );
+	return true;
+}
+
 //=============================================================================
 
 static char socksBuf[ 4096 ];
 
+#ifdef __linux__
+// packets larger than this are never queued
+static const int MAX_QUEUED_PACKETLEN = 1536;
+
+struct queuedPacket_t
+{
+	SOCKET                  socket;
+	netadrtype_t            type;
+	struct sockaddr_storage addr;
+	socklen_t               addrlen;
+	int                     length;
+	byte                    data[ MAX_QUEUED_PACKETLEN ];
+};
+
+static queuedPacket_t queuedPackets[ MAX_PACKET_BATCH ];
+static int            numQueuedPackets = 0;
+#endif
+
+static int            packetBatchDepth = 0;
+
+/*
+==================
+NET_SendError
+==================
+*/
+static void NET_SendError( int err, int family, netadrtype_t type )
+{
+	// wouldblock is silent
+	if ( err == net::errc::resource_unavailable_try_again )
+	{
+		return;
+	}
+
+	// some PPP links do not allow broadcasts and return an error
+	if ( ( err == net::errc::address_not_available ) && ( ( type == netadrtype_t::NA_BROADCAST ) ) )
+	{
+		return;
+	}
+
+	if ( family == AF_INET )
+	{
+		Log::Notice( "Sys_SendPacket (ipv4): %s", NET_ErrorString() );
+	}
+	else if ( family == AF_INET6 )
+	{
+		Log::Notice( "Sys_SendPacket (ipv6): %s", NET_ErrorString() );
+	}
+	else
+	{
+		Log::Notice( "Sys_SendPacket (%i): %s", family , NET_ErrorString() );
+	}
+}
+
+#ifdef __linux__
+/*
+==================
+NET_FlushPacketBatch
+
+Sends the queued packets with one system call per run of packets going
+through the same socket
+==================
+*/
+static void NET_FlushPacketBatch()
+{
+	struct mmsghdr headers[ MAX_PACKET_BATCH ];
+	struct iovec   iovecs[ MAX_PACKET_BATCH ];
+
+	for ( int i = 0; i < numQueuedPackets; i++ )
+	{
+		queuedPacket_t *packet = &queuedPackets[ i ];
+
+		iovecs[ i ].iov_base = packet->data;
+		iovecs[ i ].iov_len = packet->length;
+		memset( &headers[ i ], 0, sizeof( headers[ i ] ) );
+		headers[ i ].msg_hdr.msg_name = &packet->addr;
+		headers[ i ].msg_hdr.msg_namelen = packet->addrlen;
+		headers[ i ].msg_hdr.msg_iov = &iovecs[ i ];
+		headers[ i ].msg_hdr.msg_iovlen = 1;
+	}
+
+	int start = 0;
+
+	while ( start < numQueuedPackets )
+	{
+		SOCKET socket = queuedPackets[ start ].socket;
+		int end = start + 1;
+
+		while ( end < numQueuedPackets && queuedPackets[ end ].socket == socket )
+		{
+			end++;
+		}
+
+		while ( start < end )
+		{
+			int ret = sendmmsg( socket, headers + start, end - start, 0 );
+
+			if ( ret == SOCKET_ERROR )
+			{
+				// skip the packet that failed, like sendto would have dropped it
+				NET_SendError( socketError, queuedPackets[ start ].addr.ss_family, queuedPackets[ start ].type );
+				start++;
+				continue;
+			}
+
+			start += ret;
+		}
+	}
+
+	numQueuedPackets = 0;
+}
+
+/*
+==================
+NET_QueuePacket
+==================
+*/
+static void NET_QueuePacket( SOCKET socket, int length, const void *data, const netadr_t& to,
+                             const struct sockaddr_storage& addr, socklen_t addrlen )
+{
+	if ( numQueuedPackets == MAX_PACKET_BATCH )
+	{
+		NET_FlushPacketBatch();
+	}
+
+	queuedPacket_t *packet = &queuedPackets[ numQueuedPackets++ ];
+	packet->socket = socket;
+	packet->type = to.type;
+	packet->addr = addr;
+	packet->addrlen = addrlen;
+	packet->length = length;
+	memcpy( packet->data, data, length );
+}
+#endif
+
+namespace Sys {
+PacketBatch::PacketBatch()
+{
+	packetBatchDepth++;
+}
+
+PacketBatch::~PacketBatch()
+{
+	if ( --packetBatchDepth == 0 )
+	{
+#ifdef __linux__
+		NET_FlushPacketBatch();
+#endif
+	}
+}
+} // namespace Sys
+
 /*
 ==================
 Sys_SendPacket
@@ -744,47 +1267,133 @@ void Sys_SendPacket( int length, const void *data, const netadr_t& to )
 		memcpy( &socksBuf[ 10 ], data, length );
 		ret = sendto( ip_socket, ( const char* )socksBuf, length + 10, 0, &socksRelayAddr, sizeof( socksRelayAddr ) );
 	}
-	else
+	else if ( addr.ss_family == AF_INET || addr.ss_family == AF_INET6 )
 	{
-		if ( addr.ss_family == AF_INET )
-		{
-			ret = sendto( ip_socket, ( const char* )data, length, 0, ( struct sockaddr * ) &addr, sizeof( struct sockaddr_in ) );
-		}
-		else if ( addr.ss_family == AF_INET6 )
+		SOCKET socket = addr.ss_family == AF_INET ? ip_socket : ip6_socket;
+		socklen_t addrlen = addr.ss_family == AF_INET ? sizeof( struct sockaddr_in ) : sizeof( struct sockaddr_in6 );
+
+#ifdef __linux__
+		if ( packetBatchDepth > 0 && length <= MAX_QUEUED_PACKETLEN && net_batchPackets.Get() )
 		{
-			ret = sendto( ip6_socket, ( const char* )data, length, 0, ( struct sockaddr * ) &addr, sizeof( struct sockaddr_in6 ) );
+			NET_QueuePacket( socket, length, data, to, addr, addrlen );
+			return;
 		}
+
+		// keep the packets to the same address in order
+		NET_FlushPacketBatch();
+#endif
+
+		ret = sendto( socket, ( const char* )data, length, 0, ( struct sockaddr * ) &addr, addrlen );
 	}
 
 	if ( ret == SOCKET_ERROR )
+	{
+		NET_SendError( socketError, addr.ss_family, to.type );
+	}
+}
+
+/*
+==================
+Client sockets
+
+Extra sockets connected to a single server, for tools that act as many
+clients from one process. Each one gets its own port, so the server sees them
+as different clients. The handles are indices, not system sockets.
+==================
+*/
+static std::vector<SOCKET> clientSockets;
+
+int NET_OpenClientSocket( const netadr_t& server )
+{
+	struct sockaddr_storage addr;
+
+	if ( server.type != netadrtype_t::NA_IP && server.type != netadrtype_t::NA_IP6 )
+	{
+		Log::Warn( "NET_OpenClientSocket: bad address type" );
+		return -1;
+	}
+
+	memset( &addr, 0, sizeof( addr ) );
+	NetadrToSockadr( &server, ( struct sockaddr * ) &addr );
+
+	SOCKET newsocket = socket( addr.ss_family, SOCK_DGRAM, IPPROTO_UDP );
+	u_long _true = 1;
+
+	if ( newsocket == INVALID_SOCKET )
+	{
+		Log::Warn( "NET_OpenClientSocket: socket: %s", NET_ErrorString() );
+		return -1;
+	}
+
+	// connecting binds a free port and filters out packets from anyone else
+	socklen_t addrlen = addr.ss_family == AF_INET ? sizeof( struct sockaddr_in ) : sizeof( struct sockaddr_in6 );
+
+	if ( ioctlsocket( newsocket, FIONBIO, &_true ) == SOCKET_ERROR ||
+	     connect( newsocket, ( struct sockaddr * ) &addr, addrlen ) == SOCKET_ERROR )
+	{
+		Log::Warn( "NET_OpenClientSocket: %s", NET_ErrorString() );
+		closesocket( newsocket );
+		return -1;
+	}
+
+	auto slot = std::find( clientSockets.begin(), clientSockets.end(), INVALID_SOCKET );
+
+	if ( slot == clientSockets.end() )
+	{
+		clientSockets.push_back( newsocket );
+		return clientSockets.size() - 1;
+	}
+
+	*slot = newsocket;
+	return slot - clientSockets.begin();
+}
+
+void NET_CloseClientSocket( int socket )
+{
+	closesocket( clientSockets[ socket ] );
+	clientSockets[ socket ] = INVALID_SOCKET;
+}
+
+void NET_SendClientPacket( int socket, int length, const void *data )
+{
+	if ( send( clientSockets[ socket ], ( const char * ) data, length, 0 ) == SOCKET_ERROR )
 	{
 		int err = socketError;
 
-		// wouldblock is silent
-		if ( err == net::errc::resource_unavailable_try_again )
+		// the server may not be listening yet
+		if ( err != net::errc::resource_unavailable_try_again && err != net::errc::connection_refused )
 		{
-			return;
+			Log::Notice( "NET_SendClientPacket: %s", NET_ErrorString() );
 		}
+	}
+}
 
-		// some PPP links do not allow broadcasts and return an error
-		if ( ( err == net::errc::address_not_available ) && ( ( to.type == netadrtype_t::NA_BROADCAST ) ) )
-		{
-			return;
-		}
+bool NET_GetClientPacket( int socket, msg_t *net_message )
+{
+	int ret = recv( clientSockets[ socket ], ( char * ) net_message->data, net_message->maxsize, 0 );
 
-		if ( addr.ss_family == AF_INET )
-		{
-			Log::Notice( "Sys_SendPacket (ipv4): %s", NET_ErrorString() );
-		}
-		else if ( addr.ss_family == AF_INET6 )
-		{
-			Log::Notice( "Sys_SendPacket (ipv6): %s", NET_ErrorString() );
-		}
-		else
+	if ( ret == SOCKET_ERROR )
+	{
+		int err = socketError;
+
+		if ( err != net::errc::resource_unavailable_try_again && err != net::errc::connection_refused &&
+		     err != net::errc::connection_reset )
 		{
-			Log::Notice( "Sys_SendPacket (%i): %s", addr.ss_family , NET_ErrorString() );
+			Log::Notice( "NET_GetClientPacket: %s", NET_ErrorString() );
 		}
+
+		return false;
 	}
+
+	if ( ret == net_message->maxsize )
+	{
+		Log::Notice( "Oversize packet on client socket %i", socket );
+		return false;
+	}
+
+	net_message->readcount = 0;
+	net_message->cursize = ret;
+	return true;
 }
 
 //=============================================================================
@@ -1740,6 +2349,11 @@ void NET_EnableNetworking( bool serverMode )
 	NET_OpenIP( serverMode );
 	NET_SetMulticast6();
 	SV_NET_Config();
+
+	if ( net_thread.Get() && Application::GetTraits().isServer )
+	{
+		NET_StartThread();
+	}
 }
 
 void NET_DisableNetworking()
@@ -1751,6 +2365,12 @@ void NET_DisableNetworking()
 
 	networkingEnabled = false;
 
+	NET_StopThread();
+
+#ifdef __linux__
+	NET_FlushPacketBatch();
+#endif
+
 	if ( ip_socket != INVALID_SOCKET )
 	{
 		closesocket( ip_socket );
@@ -1849,6 +2469,15 @@ void NET_Sleep( int msec )
 		return;
 	}
 
+	if ( Sys_NetThreadRunning() )
+	{
+		std::unique_lock<std::mutex> lock( netWakeMutex );
+		netWake.wait_for( lock, std::chrono::milliseconds( msec ), [] {
+			return receivedHead.load( std::memory_order_acquire ) != receivedTail.load( std::memory_order_relaxed );
+		} );
+		return;
+	}
+
 	FD_ZERO( &fdset );
 
 	if ( ip_socket != INVALID_SOCKET )
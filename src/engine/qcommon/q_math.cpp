@@ -3348,3 +3348,231 @@ void TransEndLerp( transform_t *t )
 }
 #endif
 
+
+/*
+=================
+Skeletal animation kernels
+
+The SSE variant of TransLerpSoA works on 4 bones at once and does the same
+operations in the same order as the SSE transform functions in q_shared.h,
+so that it gives the same results. The other variants are plain loops over
+those functions.
+=================
+*/
+
+void TransToSoA( const transform_t *in, int numBones, float *out )
+{
+	int stride = TransSoAStride( numBones );
+
+	for ( int i = 0; i < stride; i++ )
+	{
+		transform_t t;
+
+		// padding bones are identities, the kernels run over them
+		if ( i < numBones )
+		{
+			t = in[ i ];
+		}
+		else
+		{
+			TransInit( &t );
+		}
+
+		out[ 0 * stride + i ] = t.rot[ 0 ];
+		out[ 1 * stride + i ] = t.rot[ 1 ];
+		out[ 2 * stride + i ] = t.rot[ 2 ];
+		out[ 3 * stride + i ] = t.rot[ 3 ];
+		out[ 4 * stride + i ] = t.trans[ 0 ];
+		out[ 5 * stride + i ] = t.trans[ 1 ];
+		out[ 6 * stride + i ] = t.trans[ 2 ];
+		out[ 7 * stride + i ] = t.scale;
+	}
+}
+
+#if defined(DAEMON_USE_ARCH_INTRINSICS_i686_sse)
+void TransLerpSoA( const float *from, const float *to, float frac,
+                   int numBones, transform_t *out )
+{
+	int stride = TransSoAStride( numBones );
+	__m128 zero = _mm_setzero_ps();
+	__m128 signBit = _mm_set1_ps( -0.0f );
+	__m128 w1 = _mm_set1_ps( 1.0f - frac );
+	__m128 w2 = _mm_set1_ps( frac );
+
+	for ( int i = 0; i < numBones; i += 4 )
+	{
+		__m128 q[ 4 ], ts[ 4 ];
+
+		__m128 f[ 4 ];
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			f[ c ] = _mm_load_ps( from + c * stride + i );
+		}
+
+		// from the zeroed transform of TransStartLerp, where the dot product
+		// in TransAddWeight is -0, flipping the rotation, when all the
+		// components are negative
+		__m128 w = _mm_xor_ps( w1, _mm_and_ps( _mm_and_ps( _mm_and_ps( f[ 0 ], f[ 1 ] ),
+		                                                   _mm_and_ps( f[ 2 ], f[ 3 ] ) ), signBit ) );
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			q[ c ] = _mm_add_ps( zero, _mm_mul_ps( w, f[ c ] ) );
+			ts[ c ] = _mm_add_ps( zero, _mm_mul_ps( w1, _mm_load_ps( from + ( c + 4 ) * stride + i ) ) );
+		}
+
+		__m128 t[ 4 ];
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			t[ c ] = _mm_load_ps( to + c * stride + i );
+		}
+
+		// take the shortest path, like sseDot4 in TransAddWeight
+		__m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( t[ 0 ], q[ 0 ] ), _mm_mul_ps( t[ 1 ], q[ 1 ] ) ),
+		                       _mm_add_ps( _mm_mul_ps( t[ 2 ], q[ 2 ] ), _mm_mul_ps( t[ 3 ], q[ 3 ] ) ) );
+		w = _mm_xor_ps( w2, _mm_and_ps( d, signBit ) );
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			q[ c ] = _mm_add_ps( q[ c ], _mm_mul_ps( w, t[ c ] ) );
+			ts[ c ] = _mm_add_ps( ts[ c ], _mm_mul_ps( w2, _mm_load_ps( to + ( c + 4 ) * stride + i ) ) );
+		}
+
+		// sseQuatNormalize
+		__m128 p = _mm_add_ps( _mm_add_ps( _mm_mul_ps( q[ 0 ], q[ 0 ] ), _mm_mul_ps( q[ 1 ], q[ 1 ] ) ),
+		                       _mm_add_ps( _mm_mul_ps( q[ 2 ], q[ 2 ] ), _mm_mul_ps( q[ 3 ], q[ 3 ] ) ) );
+		__m128 r = _mm_rsqrt_ps( p );
+		__m128 h = _mm_mul_ps( _mm_set1_ps( 0.5f ), r );
+		r = _mm_mul_ps( _mm_mul_ps( r, r ), p );
+		r = _mm_sub_ps( _mm_set1_ps( 3.0f ), r );
+		r = _mm_mul_ps( h, r );
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			q[ c ] = _mm_mul_ps( q[ c ], r );
+		}
+
+		_MM_TRANSPOSE4_PS( q[ 0 ], q[ 1 ], q[ 2 ], q[ 3 ] );
+		_MM_TRANSPOSE4_PS( ts[ 0 ], ts[ 1 ], ts[ 2 ], ts[ 3 ] );
+
+		for ( int k = 0; k < 4 && i + k < numBones; k++ )
+		{
+			out[ i + k ].sseRot = q[ k ];
+			out[ i + k ].sseTransScale = ts[ k ];
+		}
+	}
+}
+
+void SkinPositions( const transform_t *bones, int numBones,
+                    const byte *blendIndexes, const byte *blendWeights,
+                    const float *positions, int numVertexes,
+                    float *out, size_t outStride )
+{
+	// columns of the 3x4 matrix of each bone, the last one is the translation
+	__m128 matrices[ 256 ][ 4 ];
+	numBones = std::min( numBones, 256 );
+
+	for ( int i = 0; i < numBones; i++ )
+	{
+		const transform_t &t = bones[ i ];
+		__m128 scale = sseSwizzle( t.sseTransScale, WWWW );
+
+		// the rotation is linear, so it is the transform of the unit vectors
+		matrices[ i ][ 0 ] = _mm_mul_ps( sseQuatTransform( t.sseRot, _mm_setr_ps( 1.0f, 0.0f, 0.0f, 0.0f ) ), scale );
+		matrices[ i ][ 1 ] = _mm_mul_ps( sseQuatTransform( t.sseRot, _mm_setr_ps( 0.0f, 1.0f, 0.0f, 0.0f ) ), scale );
+		matrices[ i ][ 2 ] = _mm_mul_ps( sseQuatTransform( t.sseRot, _mm_setr_ps( 0.0f, 0.0f, 1.0f, 0.0f ) ), scale );
+		matrices[ i ][ 3 ] = first_XYZ_second_W( t.sseTransScale, _mm_setzero_ps() );
+	}
+
+	const __m128 weightFactor = _mm_set1_ps( 1.0f / 255.0f );
+	byte *dest = reinterpret_cast<byte *>( out );
+
+	for ( int v = 0; v < numVertexes; v++, blendIndexes += 4, blendWeights += 4, positions += 3, dest += outStride )
+	{
+		__m128 m[ 4 ] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			if ( blendWeights[ k ] == 0 || blendIndexes[ k ] >= numBones )
+			{
+				continue;
+			}
+
+			__m128 w = _mm_mul_ps( _mm_set1_ps( blendWeights[ k ] ), weightFactor );
+			const __m128 *bone = matrices[ blendIndexes[ k ] ];
+
+			for ( int c = 0; c < 4; c++ )
+			{
+				m[ c ] = _mm_add_ps( m[ c ], _mm_mul_ps( w, bone[ c ] ) );
+			}
+		}
+
+		__m128 p = _mm_add_ps( _mm_add_ps( _mm_mul_ps( m[ 0 ], _mm_set1_ps( positions[ 0 ] ) ),
+		                                   _mm_mul_ps( m[ 1 ], _mm_set1_ps( positions[ 1 ] ) ) ),
+		                       _mm_add_ps( _mm_mul_ps( m[ 2 ], _mm_set1_ps( positions[ 2 ] ) ), m[ 3 ] ) );
+
+		sseStoreVec3( p, reinterpret_cast<float *>( dest ) );
+	}
+}
+#else
+void TransLerpSoA( const float *from, const float *to, float frac,
+                   int numBones, transform_t *out )
+{
+	int stride = TransSoAStride( numBones );
+
+	for ( int i = 0; i < numBones; i++ )
+	{
+		transform_t a, b;
+
+		for ( int c = 0; c < 4; c++ )
+		{
+			a.rot[ c ] = from[ c * stride + i ];
+			b.rot[ c ] = to[ c * stride + i ];
+		}
+
+		for ( int c = 0; c < 3; c++ )
+		{
+			a.trans[ c ] = from[ ( c + 4 ) * stride + i ];
+			b.trans[ c ] = to[ ( c + 4 ) * stride + i ];
+		}
+
+		a.scale = from[ 7 * stride + i ];
+		b.scale = to[ 7 * stride + i ];
+
+		TransStartLerp( &out[ i ] );
+		TransAddWeight( 1.0f - frac, &a, &out[ i ] );
+		TransAddWeight( frac, &b, &out[ i ] );
+		TransEndLerp( &out[ i ] );
+	}
+}
+
+void SkinPositions( const transform_t *bones, int numBones,
+                    const byte *blendIndexes, const byte *blendWeights,
+                    const float *positions, int numVertexes,
+                    float *out, size_t outStride )
+{
+	const float weightFactor = 1.0f / 255.0f;
+	byte *dest = reinterpret_cast<byte *>( out );
+
+	for ( int v = 0; v < numVertexes; v++, blendIndexes += 4, blendWeights += 4, positions += 3, dest += outStride )
+	{
+		vec3_t position = {};
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			if ( blendWeights[ k ] == 0 || blendIndexes[ k ] >= numBones )
+			{
+				continue;
+			}
+
+			vec3_t tmp;
+			TransformPoint( &bones[ blendIndexes[ k ] ], positions, tmp );
+			VectorMA( position, blendWeights[ k ] * weightFactor, tmp, position );
+		}
+
+		VectorCopy( position, reinterpret_cast<float *>( dest ) );
+	}
+}
+#endif
@@ -28,6 +28,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ===========================================================================
 */
 
+#include <chrono>
+#include <random>
+
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -205,6 +208,178 @@ TEST(QMathTransformTest, TransInverse)
         {-0.4833702, 0.42157, 0.7551386, -0.1356377}, {1.244436,1.155842,-0.5278334}, 0.4);
 }
 
+// A skeleton the size of the player models, not a multiple of 4 bones
+constexpr int NUM_BONES = 61;
+
+std::vector<transform_t> RandomPose(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<transform_t> pose(NUM_BONES);
+    for (transform_t& t : pose) {
+        quat_t q = {unit(rng), unit(rng), unit(rng), unit(rng)};
+        vec3_t v = {20.0f * unit(rng), 20.0f * unit(rng), 20.0f * unit(rng)};
+        QuatNormalize(q);
+        TransInitRotationQuat(q, &t);
+        TransAddScale(1.25f + 0.75f * unit(rng), &t);
+        TransAddTranslation(v, &t);
+    }
+    return pose;
+}
+
+// The kernels do the same operations as the functions for a single transform
+void ExpectSameTransform(const transform_t& expected, const transform_t& actual)
+{
+    for (int c = 0; c < 4; c++) {
+        EXPECT_FLOAT_EQ(expected.rot[c], actual.rot[c]);
+    }
+    for (int c = 0; c < 3; c++) {
+        EXPECT_FLOAT_EQ(expected.trans[c], actual.trans[c]);
+    }
+    EXPECT_FLOAT_EQ(expected.scale, actual.scale);
+}
+
+struct SkinnedMesh {
+    std::vector<float> positions;
+    std::vector<byte> blendIndexes;
+    std::vector<byte> blendWeights;
+};
+
+SkinnedMesh RandomMesh(std::mt19937& rng, int numVertexes)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    SkinnedMesh mesh;
+    for (int v = 0; v < numVertexes; v++) {
+        int numWeights = 1 + rng() % 4;
+        int left = 255;
+        for (int c = 0; c < 3; c++) {
+            mesh.positions.push_back(30.0f * unit(rng));
+        }
+        for (int k = 0; k < 4; k++) {
+            int weight = k == numWeights - 1 ? left : k < numWeights ? rng() % (left + 1) : 0;
+            left -= weight;
+            mesh.blendIndexes.push_back(rng() % NUM_BONES);
+            mesh.blendWeights.push_back(weight);
+        }
+    }
+    return mesh;
+}
+
+// What the CPU path of IQM surfaces did for each vertex
+void SkinPositionsScalar(const transform_t* bones, const SkinnedMesh& mesh, float* out)
+{
+    for (size_t v = 0; v < mesh.positions.size() / 3; v++) {
+        vec3_t position = {};
+        for (int k = 0; k < 4; k++) {
+            if (mesh.blendWeights[4 * v + k] == 0) {
+                continue;
+            }
+            vec3_t tmp;
+            TransformPoint(&bones[mesh.blendIndexes[4 * v + k]], &mesh.positions[3 * v], tmp);
+            VectorMA(position, mesh.blendWeights[4 * v + k] * (1.0f / 255.0f), tmp, position);
+        }
+        VectorCopy(position, &out[3 * v]);
+    }
+}
+
+TEST(QMathTransformTest, TransLerpSoA)
+{
+    std::mt19937 rng(1234);
+    std::vector<transform_t> from = RandomPose(rng), to = RandomPose(rng);
+    std::vector<float> fromSoA(8 * TransSoAStride(NUM_BONES)), toSoA(fromSoA.size());
+    TransToSoA(from.data(), NUM_BONES, fromSoA.data());
+    TransToSoA(to.data(), NUM_BONES, toSoA.data());
+
+    for (float frac : {0.0f, 0.3f, 0.5f, 0.99f, 1.0f}) {
+        SCOPED_TRACE(frac);
+        std::vector<transform_t> out(NUM_BONES);
+        TransLerpSoA(fromSoA.data(), toSoA.data(), frac, NUM_BONES, out.data());
+
+        for (int i = 0; i < NUM_BONES; i++) {
+            transform_t expected;
+            TransStartLerp(&expected);
+            TransAddWeight(1.0f - frac, &from[i], &expected);
+            TransAddWeight(frac, &to[i], &expected);
+            TransEndLerp(&expected);
+            ExpectSameTransform(expected, out[i]);
+        }
+    }
+}
+
+TEST(QMathTransformTest, SkinPositions)
+{
+    std::mt19937 rng(9012);
+    std::vector<transform_t> bones = RandomPose(rng);
+    SkinnedMesh mesh = RandomMesh(rng, 1000);
+    std::vector<float> expected(3 * 1000);
+    SkinPositionsScalar(bones.data(), mesh, expected.data());
+
+    // with a stride, like in the vertexes of a surface
+    std::vector<float> out(4 * 1000);
+    SkinPositions(bones.data(), NUM_BONES, mesh.blendIndexes.data(), mesh.blendWeights.data(),
+        mesh.positions.data(), 1000, out.data(), 4 * sizeof(float));
+
+    // the positions go up to about 100, the matrices round differently
+    for (int v = 0; v < 1000; v++) {
+        for (int c = 0; c < 3; c++) {
+            EXPECT_NEAR(expected[3 * v + c], out[4 * v + c], 1e-3f);
+        }
+    }
+}
+
+TEST(QMathTransformTest, DISABLED_SkeletonBenchmark)
+{
+    std::mt19937 rng(3456);
+    std::vector<transform_t> from = RandomPose(rng), to = RandomPose(rng), out(NUM_BONES);
+    std::vector<float> fromSoA(8 * TransSoAStride(NUM_BONES)), toSoA(fromSoA.size());
+    TransToSoA(from.data(), NUM_BONES, fromSoA.data());
+    TransToSoA(to.data(), NUM_BONES, toSoA.data());
+
+    using Clock = std::chrono::steady_clock;
+    auto perMicrosecond = [](int count, Clock::duration time) {
+        return count / std::max(1.0, double(std::chrono::duration_cast<std::chrono::microseconds>(time).count()));
+    };
+
+    const int skeletons = 20000;
+    Clock::time_point start = Clock::now();
+    for (int n = 0; n < skeletons; n++) {
+        float frac = (n % 100) / 100.0f;
+        for (int i = 0; i < NUM_BONES; i++) {
+            TransStartLerp(&out[i]);
+            TransAddWeight(1.0f - frac, &from[i], &out[i]);
+            TransAddWeight(frac, &to[i], &out[i]);
+            TransEndLerp(&out[i]);
+        }
+    }
+    Clock::time_point lerped = Clock::now();
+    for (int n = 0; n < skeletons; n++) {
+        TransLerpSoA(fromSoA.data(), toSoA.data(), (n % 100) / 100.0f, NUM_BONES, out.data());
+    }
+    Clock::time_point lerpedSoA = Clock::now();
+
+    int bones = skeletons * NUM_BONES;
+    printf("lerp: %.1f Mbones/s per bone, %.1f Mbones/s SoA\n",
+        perMicrosecond(bones, lerped - start), perMicrosecond(bones, lerpedSoA - lerped));
+
+    const int numVertexes = 5000, meshes = 200;
+    SkinnedMesh mesh = RandomMesh(rng, numVertexes);
+    std::vector<float> positions(3 * numVertexes);
+
+    start = Clock::now();
+    for (int n = 0; n < meshes; n++) {
+        SkinPositionsScalar(from.data(), mesh, positions.data());
+    }
+    Clock::time_point skinned = Clock::now();
+    for (int n = 0; n < meshes; n++) {
+        SkinPositions(from.data(), NUM_BONES, mesh.blendIndexes.data(), mesh.blendWeights.data(),
+            mesh.positions.data(), numVertexes, positions.data(), 3 * sizeof(float));
+    }
+    Clock::time_point skinnedKernel = Clock::now();
+
+    int vertexes = meshes * numVertexes;
+    printf("skinning: %.1f Mverts/s per weight, %.1f Mverts/s with matrices\n",
+        perMicrosecond(vertexes, skinned - start), perMicrosecond(vertexes, skinnedKernel - skinned));
+}
+
 TEST(QSharedMathTest, InverseSquareRoot)
 {
     constexpr float relativeTolerance = 5.0e-6;
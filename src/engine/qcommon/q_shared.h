@@ -1487,6 +1487,30 @@ inline vec_t VectorNormalize2( const vec3_t v, vec3_t out )
 	void TransEndLerp( transform_t *t );
 #endif
 
+//=============================================
+// skeletal animation kernels, working on a whole skeleton or mesh at once
+
+	// Poses can be stored as a structure of arrays so that the kernels work
+	// on several bones at once: 8 arrays (rotation x, y, z, w, translation
+	// x, y, z, scale) of TransSoAStride( numBones ) floats, aligned on 16 bytes.
+	inline int TransSoAStride( int numBones ) {
+		return ( numBones + 3 ) & ~3;
+	}
+	void TransToSoA( const transform_t *in, int numBones, float *out );
+
+	// Same as TransStartLerp, TransAddWeight( 1 - frac, from ),
+	// TransAddWeight( frac, to ) and TransEndLerp for every bone
+	void TransLerpSoA( const float *from, const float *to, float frac,
+			   int numBones, transform_t *out );
+
+	// Positions of vertexes deformed by up to 4 weighted bones, written every
+	// outStride bytes. Matches the sum of TransformPoint for each weight up to
+	// rounding, the bones are turned into matrices first.
+	void SkinPositions( const transform_t *bones, int numBones,
+			    const byte *blendIndexes, const byte *blendWeights,
+			    const float *positions, int numVertexes,
+			    float *out, size_t outStride );
+
 //=============================================================================
 
 	char       *COM_SkipPath( char *pathname );
@@ -65,6 +65,7 @@ struct usercmd_t;
 struct entityState_t;
 
 void  MSG_WriteBits( msg_t *msg, int value, int bits );
+void  MSG_WriteBitstream( msg_t *msg, const byte *data, int bits );
 
 void  MSG_WriteChar( msg_t *sb, int c );
 void  MSG_WriteByte( msg_t *sb, int c );
@@ -98,6 +99,9 @@ void  MSG_ReadDeltaEntity( msg_t *msg, const entityState_t *from, entityState_t
 void MSG_InitNetcodeTables(NetcodeTable playerStateTable, int playerStateSize);
 void  MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to );
 void  MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to );
+// with a given table instead of the one from MSG_InitNetcodeTables
+void  MSG_WriteDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to, NetcodeTable &fields, int psSize );
+void  MSG_ReadDeltaPlayerstate( msg_t *msg, OpaquePlayerState *from, OpaquePlayerState *to, const NetcodeTable &fields, int psSize );
 
 //============================================================================
 
@@ -166,6 +170,12 @@ void       NET_LeaveMulticast6();
 
 void       NET_Sleep( int msec );
 
+// sockets of their own for tools that act as many clients, see net_ip.cpp
+int        NET_OpenClientSocket( const netadr_t& server );
+void       NET_CloseClientSocket( int socket );
+void       NET_SendClientPacket( int socket, int length, const void *data );
+bool       NET_GetClientPacket( int socket, msg_t *net_message );
+
 //----(SA)  increased for larger submodel entity counts
 #define MAX_MSGLEN           32768 // max length of a message, which may
 //#define   MAX_MSGLEN              16384       // max length of a message, which may
@@ -193,12 +203,14 @@ struct netchan_t
     // incoming fragment assembly buffer
     int  fragmentSequence;
     int  fragmentLength;
+    int  fragmentSize; // size of the non-final fragments, taken from the first one
     byte fragmentBuffer[ MAX_MSGLEN ];
 
     // outgoing fragment buffer
     // we need to space out the sending of large fragmented messages
     bool unsentFragments;
     int      unsentFragmentStart;
+    int      unsentFragmentSize;
     int      unsentLength;
     byte     unsentBuffer[ MAX_MSGLEN ];
 };
@@ -665,6 +677,7 @@ void     SV_Shutdown( const char *finalmsg );
 void     SV_QuickShutdown( const char *finalmsg );
 void     SV_Frame( int msec );
 void     SV_PacketEvent( const netadr_t& from, msg_t *msg );
+bool     SV_FilterPacket( const netadr_t& from, const byte *data, int length, int time );
 int      SV_FrameMsec();
 
 /*
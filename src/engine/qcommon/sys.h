@@ -46,6 +46,36 @@ Maryland 20850 USA.
 void Sys_SendPacket(int length, const void *data, const netadr_t& to);
 bool Sys_GetPacket(netadr_t *net_from, msg_t *net_message);
 
+// Whether Sys_GetPackets can be used instead of Sys_GetPacket
+bool Sys_CanBatchPackets();
+
+// Receives up to count packets with as few system calls as possible. The
+// messages must be initialized with their buffers; the buffers of dropped
+// packets may be moved after the received ones. Returns the number of
+// packets received.
+int Sys_GetPackets(netadr_t *net_from, msg_t *net_messages, int count);
+
+// The network thread of a dedicated server receives the packets, drops
+// the ones SV_FilterPacket rejects and queues the others for the main
+// thread, which gets them with Sys_GetQueuedPacket. Sys_NumQueuedPackets
+// tells how many are waiting, so the main thread can stop there instead of
+// racing the network thread during a flood.
+bool Sys_NetThreadRunning();
+int Sys_NumQueuedPackets();
+bool Sys_GetQueuedPacket(netadr_t *net_from, msg_t *net_message, int *receiveTime);
+
+namespace Sys {
+// While a PacketBatch is alive, Sys_SendPacket queues the packets and they
+// are all sent when the outermost batch is destroyed.
+class PacketBatch {
+public:
+    PacketBatch();
+    ~PacketBatch();
+    PacketBatch(const PacketBatch&) = delete;
+    PacketBatch& operator=(const PacketBatch&) = delete;
+};
+} // namespace Sys
+
 bool Sys_StringToAdr(const char *s, netadr_t *a, netadrtype_t family);
 
 bool Sys_IsLANAddress(const netadr_t& adr);
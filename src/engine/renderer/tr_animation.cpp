@@ -941,7 +941,8 @@ static int IQMBuildSkeleton( refSkeleton_t *skel, skelAnimation_t *skelAnim,
 {
 	int            i;
 	IQAnim_t       *anim;
-	transform_t    *newPose, *oldPose;
+	float          *newPose, *oldPose;
+	transform_t    lerped[ MAX_BONES ];
 	vec3_t         mins, maxs;
 
 	anim = skelAnim->iqm;
@@ -959,8 +960,11 @@ static int IQMBuildSkeleton( refSkeleton_t *skel, skelAnimation_t *skelAnim,
 	}
 
 	// compute frame pointers
-	oldPose = &anim->poses[ startFrame * anim->num_joints ];
-	newPose = &anim->poses[ endFrame * anim->num_joints ];
+	int frameSize = 8 * TransSoAStride( anim->num_joints );
+	oldPose = &anim->posesSoA[ startFrame * frameSize ];
+	newPose = &anim->posesSoA[ endFrame * frameSize ];
+
+	TransLerpSoA( oldPose, newPose, frac, anim->num_joints, lerped );
 
 	// calculate a bounding box in the current coordinate system
 	if( anim->bounds ) {
@@ -977,10 +981,7 @@ static int IQMBuildSkeleton( refSkeleton_t *skel, skelAnimation_t *skelAnim,
 #endif
 	for ( i = 0; i < anim->num_joints; i++ )
 	{
-		TransStartLerp( &skel->bones[ i ].t );
-		TransAddWeight( 1.0f - frac, &oldPose[ i ], &skel->bones[ i ].t );
-		TransAddWeight( frac, &newPose[ i ], &skel->bones[ i ].t );
-		TransEndLerp( &skel->bones[ i ].t );
+		skel->bones[ i ].t = lerped[ i ];
 
 #if defined( REFBONE_NAMES )
 		Q_strncpyz( skel->bones[ i ].name, boneNames, sizeof( skel->bones[ i ].name ) );
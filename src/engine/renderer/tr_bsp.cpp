@@ -467,6 +467,39 @@ static std::vector<std::string> R_LoadExternalLightmaps( const char *mapName )
 	return {};
 }
 
+/*
+===============
+R_GetWorldImageNames
+
+Lists the image files the world is going to register: the external
+lightmaps and the images used by the shaders of the BSP.
+===============
+*/
+static std::vector<std::string> R_GetWorldImageNames( const char *bspName, bool externalLightmaps )
+{
+	std::vector<std::string> imageNames;
+
+	if ( externalLightmaps )
+	{
+		char mapName[ MAX_QPATH ];
+
+		Q_strncpyz( mapName, bspName, sizeof( mapName ) );
+		COM_StripExtension3( mapName, mapName, sizeof( mapName ) );
+
+		for ( const std::string& filename : R_LoadExternalLightmaps( mapName ) )
+		{
+			imageNames.push_back( Str::Format( "%s/%s", mapName, filename ) );
+		}
+	}
+
+	for ( int i = 0; i < s_worldData.numShaders; i++ )
+	{
+		R_GetShaderImageNames( s_worldData.shaders[ i ].shader, imageNames );
+	}
+
+	return imageNames;
+}
+
 /*
 ===============
 R_LoadLightmaps
@@ -4695,6 +4728,30 @@ static void SetConstUniforms() {
 	pushBuffer.PushGlobalUniforms();
 }
 
+class BenchmarkImageDecodingCmd : public Cmd::StaticCmd
+{
+public:
+	BenchmarkImageDecodingCmd() : StaticCmd( "benchmarkImageDecoding", Cmd::RENDERER,
+		"decode the images of the current map serially then in parallel, without uploading them" ) {}
+
+	void Run( const Cmd::Args & ) const override
+	{
+		if ( !tr.world )
+		{
+			Print( "No map loaded" );
+			return;
+		}
+
+		std::vector<std::string> imageNames = R_GetWorldImageNames( tr.world->name, true );
+		std::sort( imageNames.begin(), imageNames.end() );
+		imageNames.erase( std::unique( imageNames.begin(), imageNames.end() ), imageNames.end() );
+
+		std::pair<int, int> times = R_BenchmarkImageDecoding( imageNames );
+		Print( "%d images of %s: %d ms serial, %d ms parallel", imageNames.size(), tr.world->name, times.first, times.second );
+	}
+};
+static BenchmarkImageDecodingCmd benchmarkImageDecodingCmdRegistration;
+
 /*
 =================
 RE_LoadWorldMap
@@ -4812,6 +4869,17 @@ void RE_LoadWorldMap( const char *name )
 
 	R_LoadShaders( &header->lumps[ LUMP_SHADERS ] );
 
+	// decode the images of the map ahead of their registration, R_LoadLightmaps
+	// loads the external lightmaps unless they are only needed for HDR lighting
+	{
+		bool lightMapping = r_precomputedLighting->integer && tr.lightMode == lightMode_t::MAP;
+		bool externalLightmaps = !header->lumps[ LUMP_LIGHTMAPS ].filelen
+			&& ( tr.worldDeluxeMapping || ( lightMapping && !tr.worldHDR_RGBE ) );
+
+		R_ClearPrefetchedImages();
+		R_PrefetchImages( R_GetWorldImageNames( name, externalLightmaps ) );
+	}
+
 	R_LoadLightmaps( &header->lumps[ LUMP_LIGHTMAPS ], name );
 
 	R_LoadPlanes( &header->lumps[ LUMP_PLANES ] );
@@ -4842,6 +4910,9 @@ void RE_LoadWorldMap( const char *name )
 		FinishSkybox();
 	}
 
+	// all the world images are registered now
+	R_ClearPrefetchedImages();
+
 	s_worldData.dataSize = ( byte * ) ri.Hunk_Alloc( 0, ha_pref::h_low ) - startMarker;
 	// only set tr.world now that we know the entire level has loaded properly
 	tr.world = &s_worldData;
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // tr_cmds.c
 #include "tr_local.h"
 #include "GLUtils.h"
+#include "common/Profiler.h"
 
 volatile bool            renderThreadActive;
 
@@ -97,6 +98,8 @@ int c_blockedOnMain;
 
 void R_IssueRenderCommands( bool runPerformanceCounters )
 {
+	PROFILE_ZONE( "R_IssueRenderCommands" );
+
 	renderCommandList_t *cmdList;
 
 	cmdList = &backEndData[ tr.smpFrame ]->commands;
@@ -26,11 +26,16 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "tr_local.h"
 #include <iomanip>
 #include "Material.h"
+#include "framework/ThreadPool.h"
 
 static Cvar::Cvar<bool> r_allowImageParamMismatch(
 	"r_allowImageParamMismatch", "reuse images when requested with different parameters",
 	Cvar::NONE, false);
 
+static Cvar::Range<Cvar::Cvar<int>> r_imagePrefetchThreads( "r_imagePrefetchThreads",
+	"worker threads decoding the images of a map before they are registered, 0 to decode them one by one",
+	Cvar::NONE, 0, 0, ThreadPool::MAX_WORKERS );
+
 int                  gl_filter_min = GL_LINEAR_MIPMAP_NEAREST;
 int                  gl_filter_max = GL_LINEAR;
 
@@ -1647,20 +1652,22 @@ struct imageExtLoader_t
 	const char *name;
 	imageLoader_t imageLoader;
 	bool cubemap;
+	// the loader may run outside of the main thread (no Sys::Drop, no hunk memory, no dependency on the image bits)
+	bool threadSafe;
 };
 
 /* The ordering indicates the order of preference used when
 there are multiple images of different formats available. */
 static const imageExtLoader_t imageLoaders[] =
 {
-	{ "webp", "WebP", LoadWEBP, false },
-	{ "png",  "PNG",  LoadPNG,  false },
-	{ "tga",  "TGA",  LoadTGA,  false },
-	{ "jpg",  "JPEG", LoadJPG,  false },
-	{ "jpeg", "JPEG", LoadJPG,  false },
-	{ "dds",  "DDS",  LoadDDS,  false },
-	{ "crn",  "CRN",  LoadCRN,  true  },
-	{ "ktx",  "KTX",  LoadKTX,  true  },
+	{ "webp", "WebP", LoadWEBP, false, true  },
+	{ "png",  "PNG",  LoadPNG,  false, true  },
+	{ "tga",  "TGA",  LoadTGA,  false, false },
+	{ "jpg",  "JPEG", LoadJPG,  false, false },
+	{ "jpeg", "JPEG", LoadJPG,  false, false },
+	{ "dds",  "DDS",  LoadDDS,  false, true  },
+	{ "crn",  "CRN",  LoadCRN,  true,  true  },
+	{ "ktx",  "KTX",  LoadKTX,  true,  false },
 };
 
 /*
@@ -1719,8 +1726,14 @@ bool R_HasImageLoader( const char *baseName ) {
 	return R_FindImageLoader( baseName, &prefix ) != nullptr;
 }
 
-static void R_LoadImageWithLoader( const char* fileName, const char* altName, const imageExtLoader_t *loader, byte **pic, int *width, int *height, int *numLayers, int *numMips, int *bits, byte alphaByte )
+static void R_LoadImageWithLoader( const char* fileName, const char* altName, const imageExtLoader_t *loader, byte **pic, int *width, int *height, int *numLayers, int *numMips, int *bits, byte alphaByte, bool *deferred )
 {
+	if ( deferred && !loader->threadSafe )
+	{
+		*deferred = true;
+		return;
+	}
+
 	Log::Debug( "Found %s image candidate '%s': %s", loader->name, fileName, altName );
 	loader->imageLoader( altName, pic, width, height, numLayers, numMips, bits, alphaByte );
 
@@ -1736,11 +1749,15 @@ R_LoadImage
 
 Loads any of the supported image types into a canonical
 32 bit format.
+
+When deferred is not null the image is being prefetched outside of the
+main thread: if it needs a loader that is not thread-safe, nothing is
+loaded and *deferred is set.
 =================
 */
 static void R_LoadImage( const char *name, byte **pic, int *width, int *height,
 			 int *numLayers, int *numMips,
-			 int *bits )
+			 int *bits, bool *deferred = nullptr )
 {
 	*pic = nullptr;
 	*width = *height = 0;
@@ -1770,9 +1787,9 @@ static void R_LoadImage( const char *name, byte **pic, int *width, int *height,
 				the file can exist with another extension and it will tested right after that. */
 				if ( FS::PakPath::FileExists( name ) )
 				{
-					R_LoadImageWithLoader( name, name, &loader, pic, width, height, numLayers, numMips, bits, alphaByte );
+					R_LoadImageWithLoader( name, name, &loader, pic, width, height, numLayers, numMips, bits, alphaByte, deferred );
 
-					if ( *pic )
+					if ( *pic || ( deferred && *deferred ) )
 					{
 						return;
 					}
@@ -1794,7 +1811,7 @@ static void R_LoadImage( const char *name, byte **pic, int *width, int *height,
 	if ( loader )
 	{
 		std::string altName = Str::Format( "%s%s.%s", prefix, name, loader->ext );
-		R_LoadImageWithLoader( name, altName.c_str(), loader, pic, width, height, numLayers, numMips, bits, alphaByte );
+		R_LoadImageWithLoader( name, altName.c_str(), loader, pic, width, height, numLayers, numMips, bits, alphaByte, deferred );
 		return;
 	}
 
@@ -1810,9 +1827,171 @@ static void R_LoadImage( const char *name, byte **pic, int *width, int *height,
 		if ( loader )
 		{
 			std::string altName = Str::Format( "%s%s.%s", prefix, baseName, loader->ext );
-			R_LoadImageWithLoader( name, altName.c_str(), loader, pic, width, height, numLayers, numMips, bits, alphaByte );
+			R_LoadImageWithLoader( name, altName.c_str(), loader, pic, width, height, numLayers, numMips, bits, alphaByte, deferred );
+		}
+	}
+}
+
+/* Images decoded by R_PrefetchImages, waiting for R_FindImageFile
+to create them. A null pic records a file that failed to load. */
+struct prefetchedImage_t
+{
+	byte *pic[ MAX_TEXTURE_MIPS * MAX_TEXTURE_LAYERS ];
+	int width, height, numLayers, numMips, bits;
+};
+
+static std::unordered_map<std::string, prefetchedImage_t, Str::IHash, Str::IEqual> r_prefetchedImages;
+
+static bool R_IsImageLoaded( const char *imageName )
+{
+	for ( image_t *image = r_imageHashTable[ GenerateImageHashValue( imageName ) ]; image; image = image->next )
+	{
+		if ( !Q_strnicmp( imageName, image->name, sizeof( image->name ) ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+===============
+R_DecodeImages
+
+Runs the image loaders for the given files on the thread pool and
+returns the decoded images, except the ones that need a loader which
+can only run on the main thread.
+===============
+*/
+static std::vector<std::pair<std::string, prefetchedImage_t>> R_DecodeImages( const std::vector<std::string> &imageNames, int numThreads )
+{
+	std::vector<prefetchedImage_t> images( imageNames.size() );
+	std::unique_ptr<bool[]> deferred( new bool[ imageNames.size() ]() );
+
+	ThreadPool::ParallelFor( numThreads, imageNames.size(), [ & ]( int i ) {
+		prefetchedImage_t &image = images[ i ];
+		image.pic[ 0 ] = nullptr;
+		image.numLayers = image.numMips = image.bits = 0;
+		R_LoadImage( imageNames[ i ].c_str(), image.pic, &image.width, &image.height,
+			&image.numLayers, &image.numMips, &image.bits, &deferred[ i ] );
+	} );
+
+	std::vector<std::pair<std::string, prefetchedImage_t>> decoded;
+	decoded.reserve( imageNames.size() );
+
+	for ( size_t i = 0; i < imageNames.size(); i++ )
+	{
+		if ( !deferred[ i ] )
+		{
+			decoded.emplace_back( imageNames[ i ], images[ i ] );
 		}
 	}
+
+	return decoded;
+}
+
+/*
+===============
+R_PrefetchImages
+
+Decodes the image files that are about to be registered in parallel,
+R_FindImageFile then only has to upload them. Images which are already
+loaded are skipped.
+===============
+*/
+void R_PrefetchImages( const std::vector<std::string> &imageNames )
+{
+	int numThreads = r_imagePrefetchThreads.Get();
+
+	if ( !numThreads )
+	{
+		return;
+	}
+
+	std::unordered_set<std::string, Str::IHash, Str::IEqual> seen;
+	std::vector<std::string> pending;
+
+	for ( const std::string &imageName : imageNames )
+	{
+		if ( imageName.empty() || imageName.size() >= MAX_QPATH
+			|| r_prefetchedImages.count( imageName ) || R_IsImageLoaded( imageName.c_str() ) )
+		{
+			continue;
+		}
+
+		if ( seen.insert( imageName ).second )
+		{
+			pending.push_back( imageName );
+		}
+	}
+
+	if ( pending.empty() )
+	{
+		return;
+	}
+
+	int start = Sys::Milliseconds();
+
+	for ( auto &image : R_DecodeImages( pending, numThreads ) )
+	{
+		r_prefetchedImages.emplace( std::move( image ) );
+	}
+
+	Log::Debug( "Prefetched %d images in %d ms", pending.size(), Sys::Milliseconds() - start );
+}
+
+static void R_FreeDecodedImage( prefetchedImage_t &image )
+{
+	if ( image.pic[ 0 ] )
+	{
+		Z_Free( image.pic[ 0 ] );
+	}
+}
+
+/*
+===============
+R_ClearPrefetchedImages
+
+Frees the prefetched images that were not used.
+===============
+*/
+void R_ClearPrefetchedImages()
+{
+	for ( auto &entry : r_prefetchedImages )
+	{
+		R_FreeDecodedImage( entry.second );
+	}
+
+	r_prefetchedImages.clear();
+}
+
+/*
+===============
+R_BenchmarkImageDecoding
+
+Decodes the given images serially then on the thread pool and returns
+the wall time of both runs, in milliseconds. Nothing is uploaded.
+===============
+*/
+std::pair<int, int> R_BenchmarkImageDecoding( const std::vector<std::string> &imageNames )
+{
+	std::pair<int, int> times;
+
+	for ( int pass = 0; pass < 2; pass++ )
+	{
+		int numThreads = pass ? std::max( r_imagePrefetchThreads.Get(), 1 ) : 0;
+		int start = Sys::Milliseconds();
+		auto decoded = R_DecodeImages( imageNames, numThreads );
+		( pass ? times.second : times.first ) = Sys::Milliseconds() - start;
+
+		for ( auto &image : decoded )
+		{
+			R_FreeDecodedImage( image.second );
+		}
+	}
+
+	return times;
 }
 
 /*
@@ -1894,7 +2073,23 @@ image_t *R_FindImageFile( const char *imageName, imageParams_t &imageParams )
 	byte *pic[ MAX_TEXTURE_MIPS * MAX_TEXTURE_LAYERS ];
 	pic[ 0 ] = nullptr;
 
-	R_LoadImage( imageName, pic, &width, &height, &numLayers, &numMips, &imageParams.bits );
+	auto prefetched = r_prefetchedImages.find( imageName );
+
+	if ( prefetched != r_prefetchedImages.end() )
+	{
+		const prefetchedImage_t &entry = prefetched->second;
+		std::copy( std::begin( entry.pic ), std::end( entry.pic ), pic );
+		width = entry.width;
+		height = entry.height;
+		numLayers = entry.numLayers;
+		numMips = entry.numMips;
+		imageParams.bits |= entry.bits;
+		r_prefetchedImages.erase( prefetched );
+	}
+	else
+	{
+		R_LoadImage( imageName, pic, &width, &height, &numLayers, &numMips, &imageParams.bits );
+	}
 
 	if ( *pic )
 	{
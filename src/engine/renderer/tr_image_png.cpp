@@ -168,14 +168,15 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height,
 	*height = h;
 	*pic = out = ( byte * ) Z_Malloc( w * h * 4 );
 
-	row_pointers = ( png_bytep * ) ri.Hunk_AllocateTempMemory( sizeof( png_bytep ) * h );
+	// not hunk memory, images may be decoded outside of the main thread
+	row_pointers = ( png_bytep * ) Z_Malloc( sizeof( png_bytep ) * h );
 
 	// set a new exception handler
 	if ( setjmp( png_jmpbuf( png ) ) )
 	{
 		Log::Warn("PNG image '%s' has second exception handler called [libpng v.'%s']",
 			name, PNG_LIBPNG_VER_STRING );
-		ri.Hunk_FreeTempMemory( row_pointers );
+		Z_Free( row_pointers );
 		png_destroy_read_struct( &png, ( png_infopp ) & info, ( png_infopp ) nullptr );
 		return;
 	}
@@ -194,7 +195,7 @@ void LoadPNG( const char *name, byte **pic, int *width, int *height,
 	// clean up after the read, and free any memory allocated
 	png_destroy_read_struct( &png, &info, ( png_infopp ) nullptr );
 
-	ri.Hunk_FreeTempMemory( row_pointers );
+	Z_Free( row_pointers );
 }
 
 /*
@@ -2016,6 +2016,7 @@ enum
 		// skeleton data
 		int             *jointParents;
 		transform_t     *poses;
+		float           *posesSoA; // the same for TransLerpSoA, see TransToSoA
 		float           *bounds;
 		char            *name;
 		char            *jointNames;
@@ -3000,6 +3001,10 @@ void GL_CompressedTexSubImage3D( GLenum target, GLint level, GLint xOffset, GLin
 	image_t *R_FindImageFile( const char *name, imageParams_t &imageParams );
 	image_t *R_FindCubeImage( const char *name, imageParams_t &imageParams );
 
+	void R_PrefetchImages( const std::vector<std::string> &imageNames );
+	void R_ClearPrefetchedImages();
+	std::pair<int, int> R_BenchmarkImageDecoding( const std::vector<std::string> &imageNames );
+
 	image_t *R_CreateImage( const char *name, const byte **pic, int width, int height, int numMips, const imageParams_t &imageParams,
 		const uint32_t samples = 0, const bool fixedSampleLocations = true );
 
@@ -3028,6 +3033,7 @@ void GL_CompressedTexSubImage3D( GLenum target, GLint level, GLint xOffset, GLin
 	qhandle_t RE_RegisterShaderFromImage( const char *name, image_t *image );
 
 	shader_t  *R_FindShader( const char *name, int flags );
+	void      R_GetShaderImageNames( const char *name, std::vector<std::string> &imageNames );
 	shader_t  *R_GetShaderByHandle( qhandle_t hShader );
 	const char *RE_GetShaderNameFromHandle( qhandle_t shader );
 	void      R_InitShaders();
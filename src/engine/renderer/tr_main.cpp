@@ -1742,6 +1742,48 @@ void R_AddDrawSurf( surfaceType_t *surface, shader_t *shader, int lightmapNum, i
 
 static uint32_t currentView = 0;
 
+/*
+=================
+R_RadixSortDrawSurfs
+
+Sorts the keys alone, then moves each surface once, instead of moving
+the whole surfaces around in a comparison sort. Small views are still
+sorted in place.
+=================
+*/
+static void R_RadixSortDrawSurfs( drawSurf_t *drawSurfs, int numDrawSurfs )
+{
+	if ( size_t( numDrawSurfs ) < Util::RADIX_SORT_MIN_COUNT )
+	{
+		std::sort( drawSurfs, drawSurfs + numDrawSurfs,
+		           []( const drawSurf_t &a, const drawSurf_t &b ) {
+		               return a.sort < b.sort;
+		           } );
+		return;
+	}
+
+	// reused from view to view, portal views sort after their parent view is done with them
+	static std::vector<Util::SortKey> keys, scratch;
+	static std::vector<drawSurf_t> unsorted;
+
+	keys.resize( numDrawSurfs );
+	scratch.resize( numDrawSurfs );
+
+	for ( int i = 0; i < numDrawSurfs; i++ )
+	{
+		keys[ i ] = { drawSurfs[ i ].sort, uint32_t( i ) };
+	}
+
+	const Util::SortKey *sorted = Util::RadixSort( keys.data(), scratch.data(), numDrawSurfs );
+
+	unsorted.assign( drawSurfs, drawSurfs + numDrawSurfs );
+
+	for ( int i = 0; i < numDrawSurfs; i++ )
+	{
+		drawSurfs[ i ] = unsorted[ sorted[ i ].index ];
+	}
+}
+
 /*
 =================
 R_SortDrawSurfs
@@ -1769,10 +1811,7 @@ static void R_SortDrawSurfs()
 		tr.viewParms.numDrawSurfs = MAX_DRAWSURFS;
 	}
 
-	std::sort( tr.viewParms.drawSurfs, tr.viewParms.drawSurfs + tr.viewParms.numDrawSurfs,
-	           []( const drawSurf_t &a, const drawSurf_t &b ) {
-	               return a.sort < b.sort;
-	           } );
+	R_RadixSortDrawSurfs( tr.viewParms.drawSurfs, tr.viewParms.numDrawSurfs );
 
 	// compute the offsets of the first surface of each SS_* type
 	sort = Util::ordinal( shaderSort_t::SS_BAD ) - 1;
@@ -144,6 +144,8 @@ qhandle_t RE_RegisterModel( const char *name )
 
 		loaded = false;
 		std::error_code err;
+		// The IQM loader byte-swaps and sanitizes the buffer in place, so it
+		// can't use a read-only view of the pak mapping
 		std::string buffer = FS::PakPath::ReadFile( name, err );
 
 		if ( !err )
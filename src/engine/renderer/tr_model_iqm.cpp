@@ -483,6 +483,7 @@ bool R_LoadIQModel( model_t *mod, const void *buffer, int filesize,
 	char			*str;
 	int		len;
 	transform_t		*trans, *poses;
+	float			*posesSoA;
 	float			*bounds;
 	size_t			size, len_names;
 	IQModel_t		*IQModel;
@@ -505,6 +506,8 @@ bool R_LoadIQModel( model_t *mod, const void *buffer, int filesize,
 	size += header->num_joints * sizeof( transform_t );
 	size = PAD( size, 16 );
 	size += header->num_joints * header->num_frames * sizeof( transform_t );
+	if(header->ofs_poses)
+		size += header->num_frames * 8 * TransSoAStride( header->num_poses ) * sizeof(float);
 	if(header->ofs_bounds)
 		size += header->num_frames * 6 * sizeof(float);	// model bounds
 	size += header->num_vertexes * 3 * sizeof(float);	// positions
@@ -548,8 +551,11 @@ bool R_LoadIQModel( model_t *mod, const void *buffer, int filesize,
 	if( header->ofs_poses ) {
 		poses = (transform_t *)ptr;
 		ptr = poses + header->num_poses * header->num_frames;
+		posesSoA = (float *)ptr;
+		ptr = posesSoA + header->num_frames * 8 * TransSoAStride( header->num_poses );
 	} else {
 		poses = nullptr;
+		posesSoA = nullptr;
 	}
 
 	if( header->ofs_bounds ) {
@@ -616,8 +622,10 @@ bool R_LoadIQModel( model_t *mod, const void *buffer, int filesize,
 		IQAnim->jointParents = IQModel->jointParents;
 		if( poses ) {
 			IQAnim->poses    = poses + anim->first_frame * header->num_poses;
+			IQAnim->posesSoA = posesSoA + anim->first_frame * 8 * TransSoAStride( header->num_poses );
 		} else {
 			IQAnim->poses    = nullptr;
+			IQAnim->posesSoA = nullptr;
 		}
 		if( bounds ) {
 			IQAnim->bounds   = bounds + anim->first_frame * 6;
@@ -727,6 +735,9 @@ bool R_LoadIQModel( model_t *mod, const void *buffer, int filesize,
 			TransAddScale( scale[0], trans );
 			TransAddTranslation( translate, trans );
 		}
+
+		TransToSoA( trans - header->num_poses, header->num_poses,
+			    posesSoA + i * 8 * TransSoAStride( header->num_poses ) );
 	}
 
 	u8vec4_t *weights = nullptr;
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 // tr_scene.c
 #include "tr_local.h"
 #include "Material.h"
+#include "common/Profiler.h"
 
 static Cvar::Cvar<bool> r_drawDynamicLights(
 	"r_drawDynamicLights", "render dynamic lights (if realtime lighting is enabled)", Cvar::NONE, true );
@@ -487,6 +488,8 @@ void RE_RenderScene( const refdef_t *fd )
 		return;
 	}
 
+	PROFILE_ZONE( "RE_RenderScene" );
+
 	GLIMP_LOGCOMMENT( "====== RE_RenderScene =====" );
 
 	if ( r_norefresh->integer )
@@ -5972,6 +5972,77 @@ static const char    *FindShaderInShaderText( const char *shaderName )
 	return nullptr;
 }
 
+/*
+====================
+R_GetShaderImageNames
+
+Lists the image files that loading the given shader is likely to need,
+without parsing the shader, so that they can be prefetched. It is only
+a guess: images derived from other names are not listed.
+====================
+*/
+void R_GetShaderImageNames( const char *name, std::vector<std::string> &imageNames )
+{
+	static const char *const mapKeywords[] = {
+		"map", "clampmap", "diffuseMap", "normalMap", "heightMap", "specularMap", "physicalMap", "glowMap",
+	};
+
+	char strippedName[ MAX_QPATH ];
+	COM_StripExtension3( name, strippedName, sizeof( strippedName ) );
+
+	const char *text = FindShaderInShaderText( strippedName );
+
+	// implicit shaders are made of the image with the same name
+	if ( !text )
+	{
+		imageNames.emplace_back( strippedName );
+		return;
+	}
+
+	int depth = 0;
+	bool expectMap = false;
+
+	while ( true )
+	{
+		const char *token = COM_ParseExt2( &text, true );
+
+		if ( !token[ 0 ] )
+		{
+			break;
+		}
+
+		if ( !strcmp( token, "{" ) )
+		{
+			depth++;
+		}
+		else if ( !strcmp( token, "}" ) )
+		{
+			if ( --depth <= 0 )
+			{
+				break;
+			}
+		}
+		else if ( expectMap )
+		{
+			// skip built-in images and image expressions
+			if ( token[ 0 ] != '$' && token[ 0 ] != '*' && !strchr( token, '(' ) )
+			{
+				imageNames.emplace_back( token );
+			}
+		}
+
+		expectMap = false;
+
+		for ( const char *keyword : mapKeywords )
+		{
+			if ( !Q_stricmp( token, keyword ) )
+			{
+				expectMap = true;
+			}
+		}
+	}
+}
+
 static void ClearGlobalShader()
 {
 	ResetStruct( shader );
@@ -1249,35 +1249,13 @@ void Tess_SurfaceIQM( srfIQModel_t *surf ) {
 
 		if ( tess.skipTangents )
 		{
-			byte *modelBlendIndex = model->blendIndexes + 4 * firstVertex;
-			byte *modelBlendWeight = model->blendWeights + 4 * firstVertex;
+			SkinPositions( bones, model->num_joints,
+				model->blendIndexes + 4 * firstVertex, model->blendWeights + 4 * firstVertex,
+				modelPosition, surf->num_vertexes, tessVertex->xyz, sizeof( shaderVertex_t ) );
 
 			for ( ; tessVertex < lastVertex; tessVertex++,
-				modelPosition += 3, modelNormal += 3,
-				modelTangent += 3, modelBitangent += 3,
 				modelTexcoord += 2 )
 			{
-				vec3_t position = {};
-
-				byte *lastBlendIndex = modelBlendIndex + 4;
-
-				for ( ; modelBlendIndex < lastBlendIndex; modelBlendIndex++,
-					modelBlendWeight++ )
-				{
-					if ( *modelBlendWeight == 0 )
-					{
-						continue;
-					}
-
-					float weight = *modelBlendWeight * weightFactor;
-					vec3_t tmp;
-
-					TransformPoint( &bones[ *modelBlendIndex ], modelPosition, tmp );
-					VectorMA( position, weight, tmp, position );
-				}
-
-				VectorCopy( position, tessVertex->xyz );
-
 				Vector2Copy( modelTexcoord, tessVertex->texCoords );
 			}
 		}
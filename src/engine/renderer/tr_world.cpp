@@ -25,40 +25,63 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "tr_local.h"
 #include "gl_shader.h"
 #include "Material.h"
+#include "framework/ThreadPool.h"
 
 static Cvar::Modified<Cvar::Cvar<bool>> r_showCluster(
 	"r_showCluster", "print PVS cluster at current location", Cvar::CHEAT, false );
 
+static Cvar::Range<Cvar::Cvar<int>> r_worldThreads( "r_worldThreads",
+	"worker threads culling the BSP subtrees of a view, 0 to walk the world on the main thread",
+	Cvar::NONE, 0, 0, ThreadPool::MAX_WORKERS );
+static Cvar::Cvar<bool> r_verifyWorldThreads( "r_verifyWorldThreads",
+	"also walk the world on the main thread and warn if the threaded walk added different surfaces",
+	Cvar::CHEAT, false );
+
 /*
 ================
-R_CullSurface
+R_ClassifySurface
 
 Tries to back face cull surfaces before they are lighted or
 added to the sorting list.
 
 This will also allow mirrors on both sides of a model without recursion.
+
+Returns the cullStat_t bits of the tests that were made, so the
+performance counters can be updated by the caller, which may not be on
+the main thread.
 ================
 */
-static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBits )
+enum cullStat_t
+{
+	CS_CULLED = BIT( 0 ),
+	CS_PLANE_IN = BIT( 1 ),
+	CS_PLANE_OUT = BIT( 2 ),
+	CS_BOX_IN = BIT( 3 ),
+	CS_BOX_CLIP = BIT( 4 ),
+	CS_BOX_OUT = BIT( 5 ),
+};
+
+static int R_ClassifySurface( surfaceType_t *surface, shader_t *shader, int planeBits )
 {
 	srfGeneric_t *gen;
 	float        d;
+	int          stats = 0;
 
 	// allow culling to be disabled
 	if ( r_nocull->integer )
 	{
-		return false;
+		return 0;
 	}
 
 	// ydnar: made surface culling generic, inline with q3map2 surface classification
 	if ( *surface == surfaceType_t::SF_GRID && r_nocurves->integer )
 	{
-		return true;
+		return CS_CULLED;
 	}
 
 	if ( *surface != surfaceType_t::SF_FACE && *surface != surfaceType_t::SF_TRIANGLES && *surface != surfaceType_t::SF_VBO_MESH && *surface != surfaceType_t::SF_GRID )
 	{
-		return true;
+		return CS_CULLED;
 	}
 
 	// get generic surface
@@ -77,20 +100,18 @@ static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBi
 		{
 			if ( d < -8.0f )
 			{
-				tr.pc.c_plane_cull_out++;
-				return true;
+				return CS_CULLED | CS_PLANE_OUT;
 			}
 		}
 		else if ( shader->cullType == CT_BACK_SIDED )
 		{
 			if ( d > 8.0f )
 			{
-				tr.pc.c_plane_cull_out++;
-				return true;
+				return CS_CULLED | CS_PLANE_OUT;
 			}
 		}
 
-		tr.pc.c_plane_cull_in++;
+		stats |= CS_PLANE_IN;
 	}
 
 	if ( planeBits )
@@ -108,21 +129,41 @@ static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBi
 
 		if ( cull == CULL_OUT )
 		{
-			tr.pc.c_box_cull_out++;
-			return true;
+			return stats | CS_CULLED | CS_BOX_OUT;
 		}
 		else if ( cull == CULL_CLIP )
 		{
-			tr.pc.c_box_cull_clip++;
+			stats |= CS_BOX_CLIP;
 		}
 		else
 		{
-			tr.pc.c_box_cull_in++;
+			stats |= CS_BOX_IN;
 		}
 	}
 
 	// must be visible
-	return false;
+	return stats;
+}
+
+static void R_CountCullStats( int stats )
+{
+	tr.pc.c_plane_cull_in += !!( stats & CS_PLANE_IN );
+	tr.pc.c_plane_cull_out += !!( stats & CS_PLANE_OUT );
+	tr.pc.c_box_cull_in += !!( stats & CS_BOX_IN );
+	tr.pc.c_box_cull_clip += !!( stats & CS_BOX_CLIP );
+	tr.pc.c_box_cull_out += !!( stats & CS_BOX_OUT );
+}
+
+/*
+================
+R_CullSurface
+================
+*/
+static bool R_CullSurface( surfaceType_t *surface, shader_t *shader, int planeBits )
+{
+	int stats = R_ClassifySurface( surface, shader, planeBits );
+	R_CountCullStats( stats );
+	return stats & CS_CULLED;
 }
 
 /*
@@ -206,6 +247,22 @@ void R_AddBSPModelSurfaces( trRefEntity_t *ent )
 =============================================================
 */
 
+static void R_ExtendVisBounds( vec3_t visBounds[ 2 ], const vec3_t mins, const vec3_t maxs )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( mins[ i ] < visBounds[ 0 ][ i ] )
+		{
+			visBounds[ 0 ][ i ] = mins[ i ];
+		}
+
+		if ( maxs[ i ] > visBounds[ 1 ][ i ] )
+		{
+			visBounds[ 1 ][ i ] = maxs[ i ];
+		}
+	}
+}
+
 static void R_AddLeafSurfaces( bspNode_t *node, int planeBits )
 {
 	int          c;
@@ -215,35 +272,7 @@ static void R_AddLeafSurfaces( bspNode_t *node, int planeBits )
 	tr.pc.c_leafs++;
 
 	// add to z buffer bounds
-	if ( node->mins[ 0 ] < tr.viewParms.visBounds[ 0 ][ 0 ] )
-	{
-		tr.viewParms.visBounds[ 0 ][ 0 ] = node->mins[ 0 ];
-	}
-
-	if ( node->mins[ 1 ] < tr.viewParms.visBounds[ 0 ][ 1 ] )
-	{
-		tr.viewParms.visBounds[ 0 ][ 1 ] = node->mins[ 1 ];
-	}
-
-	if ( node->mins[ 2 ] < tr.viewParms.visBounds[ 0 ][ 2 ] )
-	{
-		tr.viewParms.visBounds[ 0 ][ 2 ] = node->mins[ 2 ];
-	}
-
-	if ( node->maxs[ 0 ] > tr.viewParms.visBounds[ 1 ][ 0 ] )
-	{
-		tr.viewParms.visBounds[ 1 ][ 0 ] = node->maxs[ 0 ];
-	}
-
-	if ( node->maxs[ 1 ] > tr.viewParms.visBounds[ 1 ][ 1 ] )
-	{
-		tr.viewParms.visBounds[ 1 ][ 1 ] = node->maxs[ 1 ];
-	}
-
-	if ( node->maxs[ 2 ] > tr.viewParms.visBounds[ 1 ][ 2 ] )
-	{
-		tr.viewParms.visBounds[ 1 ][ 2 ] = node->maxs[ 2 ];
-	}
+	R_ExtendVisBounds( tr.viewParms.visBounds, node->mins, node->maxs );
 
 	// add the individual surfaces
 	mark = tr.world->markSurfaces + node->firstMarkSurface;
@@ -265,50 +294,68 @@ static void R_AddLeafSurfaces( bspNode_t *node, int planeBits )
 
 /*
 ================
-R_RecursiveWorldNode
+R_CullNode
+
+Returns true if nothing in the node can be visible, else removes from
+planeBits the frustum planes that all of the node is in front of
 ================
 */
-static void R_RecursiveWorldNode( bspNode_t *node, int planeBits )
+static bool R_CullNode( const bspNode_t *node, int &planeBits )
 {
-	do
+	// if the node wasn't marked as potentially visible, exit
+	if ( node->visCounts[ tr.visIndex ] != tr.visCounts[ tr.visIndex ] )
 	{
-		// if the node wasn't marked as potentially visible, exit
-		if ( node->visCounts[ tr.visIndex ] != tr.visCounts[ tr.visIndex ] )
-		{
-			return;
-		}
+		return true;
+	}
 
-		if ( node->contents != -1 && !node->numMarkSurfaces )
-		{
-			// don't waste time dealing with this empty leaf
-			return;
-		}
+	if ( node->contents != -1 && !node->numMarkSurfaces )
+	{
+		// don't waste time dealing with this empty leaf
+		return true;
+	}
 
-		// if the bounding volume is outside the frustum, nothing
-		// inside can be visible
-		if ( !r_nocull->integer )
-		{
-			int i;
-			int r;
+	// if the bounding volume is outside the frustum, nothing
+	// inside can be visible
+	if ( !r_nocull->integer )
+	{
+		int i;
+		int r;
 
-			for ( i = 0; i < FRUSTUM_PLANES; i++ )
+		for ( i = 0; i < FRUSTUM_PLANES; i++ )
+		{
+			if ( planeBits & ( 1 << i ) )
 			{
-				if ( planeBits & ( 1 << i ) )
-				{
-					r = BoxOnPlaneSide( node->mins, node->maxs, &tr.viewParms.frustum[ i ] );
+				r = BoxOnPlaneSide( node->mins, node->maxs, &tr.viewParms.frustum[ i ] );
 
-					if ( r == 2 )
-					{
-						return; // culled
-					}
+				if ( r == 2 )
+				{
+					return true; // culled
+				}
 
-					if ( r == 1 )
-					{
-						planeBits &= ~( 1 << i );  // all descendants will also be in front
-					}
+				if ( r == 1 )
+				{
+					planeBits &= ~( 1 << i );  // all descendants will also be in front
 				}
 			}
 		}
+	}
+
+	return false;
+}
+
+/*
+================
+R_RecursiveWorldNode
+================
+*/
+static void R_RecursiveWorldNode( bspNode_t *node, int planeBits )
+{
+	do
+	{
+		if ( R_CullNode( node, planeBits ) )
+		{
+			return;
+		}
 
 		backEndData[ tr.smpFrame ]->traversalList[ backEndData[ tr.smpFrame ]->traversalLength++ ] = node;
 
@@ -336,6 +383,267 @@ static void R_RecursiveWorldNode( bspNode_t *node, int planeBits )
 	}
 }
 
+/*
+=============================================================
+
+        THREADED WORLD WALK
+
+The top of the BSP tree is split in subtrees that are walked on the
+thread pool. The workers only cull nodes and surfaces into the buffers
+of their subtree. The main thread then adds the surfaces in the order of
+R_RecursiveWorldNode, so the draw surfaces and their sort keys are the
+same as with the serial walk.
+
+=============================================================
+*/
+
+struct worldSurface_t
+{
+	bspSurface_t *view;
+	bspSurface_t *mark;
+	int          stats; // cullStat_t bits
+};
+
+struct worldJob_t
+{
+	bspNode_t *node; // root of the subtree, nullptr for a node visited while splitting
+	int       planeBits;
+
+	std::vector<bspNode_t *>     nodes; // in traversal order
+	std::vector<worldSurface_t> surfaces;
+	vec3_t                      visBounds[ 2 ];
+	int                         leafs;
+};
+
+// reused from view to view to keep the capacity of the buffers
+static std::vector<worldJob_t> worldJobs;
+static size_t                  numWorldJobs;
+
+static worldJob_t *R_NewWorldJob( bspNode_t *node, int planeBits )
+{
+	if ( numWorldJobs == worldJobs.size() )
+	{
+		worldJobs.emplace_back();
+	}
+
+	worldJob_t *job = &worldJobs[ numWorldJobs++ ];
+	job->node = node;
+	job->planeBits = planeBits;
+	job->nodes.clear();
+	job->surfaces.clear();
+	ClearBounds( job->visBounds[ 0 ], job->visBounds[ 1 ] );
+	job->leafs = 0;
+	return job;
+}
+
+/*
+================
+R_SplitWorldNode
+
+Walks the first levels of the tree on the main thread and queues the
+subtrees below them, in the order R_RecursiveWorldNode visits them
+================
+*/
+static void R_SplitWorldNode( bspNode_t *node, int planeBits, int depth )
+{
+	if ( !depth || node->contents != -1 )
+	{
+		R_NewWorldJob( node, planeBits );
+		return;
+	}
+
+	if ( R_CullNode( node, planeBits ) )
+	{
+		return;
+	}
+
+	R_NewWorldJob( nullptr, planeBits )->nodes.push_back( node );
+
+	float d = DotProduct(tr.viewParms.orientation.viewOrigin, node->plane->normal) - node->plane->dist;
+
+	uint32_t side = d <= 0;
+
+	R_SplitWorldNode( node->children[ side ], planeBits, depth - 1 );
+	R_SplitWorldNode( node->children[ side ^ 1 ], planeBits, depth - 1 );
+}
+
+/*
+================
+R_WalkWorldNode
+
+Same as R_RecursiveWorldNode, but only records the visited nodes and
+the classified surfaces in the job, so it can run on a worker thread
+================
+*/
+static void R_WalkWorldNode( worldJob_t *job, bspNode_t *node, int planeBits )
+{
+	do
+	{
+		if ( R_CullNode( node, planeBits ) )
+		{
+			return;
+		}
+
+		job->nodes.push_back( node );
+
+		if ( node->contents != -1 )
+		{
+			break;
+		}
+
+		float d = DotProduct(tr.viewParms.orientation.viewOrigin, node->plane->normal) - node->plane->dist;
+
+		uint32_t side = d <= 0;
+
+		R_WalkWorldNode( job, node->children[ side ], planeBits );
+
+		node = node->children[ side ^ 1 ];
+	}
+	while ( true );
+
+	if ( !node->numMarkSurfaces )
+	{
+		return;
+	}
+
+	job->leafs++;
+	R_ExtendVisBounds( job->visBounds, node->mins, node->maxs );
+
+	bspSurface_t **mark = tr.world->markSurfaces + node->firstMarkSurface;
+	bspSurface_t **view = tr.world->viewSurfaces + node->firstMarkSurface;
+
+	// surfaces spanning multiple leafs are classified in each of them,
+	// the main thread keeps the result of the first one like the serial walk
+	for ( int i = 0; i < node->numMarkSurfaces; i++ )
+	{
+		job->surfaces.push_back( { view[ i ], mark[ i ], R_ClassifySurface( view[ i ]->data, view[ i ]->shader, planeBits ) } );
+	}
+}
+
+/*
+================
+R_ThreadedWorldNode
+================
+*/
+static void R_ThreadedWorldNode( bspNode_t *root, int numThreads )
+{
+	// a few subtrees per worker to balance the load
+	int depth = 0;
+
+	while ( ( 1 << depth ) < 8 * numThreads )
+	{
+		depth++;
+	}
+
+	numWorldJobs = 0;
+	R_SplitWorldNode( root, FRUSTUM_CLIPALL, depth );
+
+	ThreadPool::ParallelFor( numThreads, numWorldJobs, []( int i ) {
+		worldJob_t *job = &worldJobs[ i ];
+
+		if ( job->node )
+		{
+			R_WalkWorldNode( job, job->node, job->planeBits );
+		}
+	} );
+
+	backEndData_t *data = backEndData[ tr.smpFrame ];
+
+	for ( size_t i = 0; i < numWorldJobs; i++ )
+	{
+		const worldJob_t *job = &worldJobs[ i ];
+
+		for ( bspNode_t *node : job->nodes )
+		{
+			data->traversalList[ data->traversalLength++ ] = node;
+		}
+
+		if ( job->leafs )
+		{
+			tr.pc.c_leafs += job->leafs;
+			R_ExtendVisBounds( tr.viewParms.visBounds, job->visBounds[ 0 ], job->visBounds[ 1 ] );
+		}
+
+		for ( const worldSurface_t &surface : job->surfaces )
+		{
+			bspSurface_t *surf = surface.view;
+
+			// the surface may have already been added if it
+			// spans multiple leafs
+			if ( surf->viewCount != tr.viewCountNoReset )
+			{
+				surf->viewCount = tr.viewCountNoReset;
+				R_CountCullStats( surface.stats );
+
+				if ( !( surface.stats & CS_CULLED ) )
+				{
+					R_AddDrawSurf( surf->data, surf->shader, surf->lightmapNum, surf->fogIndex, true, surface.mark->portalNum );
+				}
+			}
+
+			surface.mark->viewCount = tr.viewCountNoReset;
+		}
+	}
+}
+
+/*
+================
+R_VerifyThreadedWorldNode
+
+Walks the world serially, then again on the thread pool, and complains
+if the second walk did not add the same draw surfaces
+================
+*/
+static void R_VerifyThreadedWorldNode( bspNode_t *root, int numThreads )
+{
+	backEndData_t *data = backEndData[ tr.smpFrame ];
+	int firstDrawSurf = tr.refdef.numDrawSurfs;
+
+	R_RecursiveWorldNode( root, FRUSTUM_CLIPALL );
+
+	std::vector<drawSurf_t> serialSurfs;
+
+	for ( int i = firstDrawSurf; i < tr.refdef.numDrawSurfs; i++ )
+	{
+		serialSurfs.push_back( tr.refdef.drawSurfs[ i & DRAWSURF_MASK ] );
+	}
+
+	std::vector<bspNode_t *> serialNodes( data->traversalList, data->traversalList + data->traversalLength );
+
+	// start the view over, with new surface marks
+	tr.refdef.numDrawSurfs = firstDrawSurf;
+	data->traversalLength = 0;
+	ClearBounds( tr.viewParms.visBounds[ 0 ], tr.viewParms.visBounds[ 1 ] );
+	tr.viewCountNoReset++;
+
+	R_ThreadedWorldNode( root, numThreads );
+
+	if ( static_cast<size_t>( tr.refdef.numDrawSurfs - firstDrawSurf ) != serialSurfs.size() )
+	{
+		Log::Warn( "threaded world walk added %d surfaces instead of %d",
+			tr.refdef.numDrawSurfs - firstDrawSurf, int( serialSurfs.size() ) );
+		return;
+	}
+
+	for ( size_t i = 0; i < serialSurfs.size(); i++ )
+	{
+		const drawSurf_t &serial = serialSurfs[ i ];
+		const drawSurf_t &threaded = tr.refdef.drawSurfs[ ( firstDrawSurf + i ) & DRAWSURF_MASK ];
+
+		if ( threaded.sort != serial.sort || threaded.surface != serial.surface || threaded.shader != serial.shader
+		     || threaded.fog != serial.fog || threaded.portalNum != serial.portalNum )
+		{
+			Log::Warn( "threaded world walk added a different surface at %d", int( i ) );
+			return;
+		}
+	}
+
+	if ( !std::equal( serialNodes.begin(), serialNodes.end(), data->traversalList, data->traversalList + data->traversalLength ) )
+	{
+		Log::Warn( "threaded world walk visited different nodes" );
+	}
+}
+
 /*
 ===============
 R_PointInLeaf
@@ -603,5 +911,18 @@ void R_AddWorldSurfaces()
 	backEndData[ tr.smpFrame ]->traversalLength = 0;
 
 	// update visbounds and add surfaces that weren't cached with VBOs
-	R_RecursiveWorldNode( tr.world->nodes, FRUSTUM_CLIPALL );
+	int numThreads = r_worldThreads.Get();
+
+	if ( !numThreads )
+	{
+		R_RecursiveWorldNode( tr.world->nodes, FRUSTUM_CLIPALL );
+	}
+	else if ( r_verifyWorldThreads.Get() )
+	{
+		R_VerifyThreadedWorldNode( tr.world->nodes, numThreads );
+	}
+	else
+	{
+		R_ThreadedWorldNode( tr.world->nodes, numThreads );
+	}
 }
@@ -0,0 +1,227 @@
+/*
+===========================================================================
+Daemon BSD Source Code
+Copyright (c) 2026, Daemon Developers
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+	* Redistributions of source code must retain the above copyright
+	  notice, this list of conditions and the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright
+	  notice, this list of conditions and the following disclaimer in the
+	  documentation and/or other materials provided with the distribution.
+	* Neither the name of the Daemon developers nor the
+	  names of its contributors may be used to endorse or promote products
+	  derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL DAEMON DEVELOPERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+===========================================================================
+*/
+
+#include <chrono>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "server.h"
+
+namespace {
+
+netadr_t PublicAddress( int a, int b, int c, int d )
+{
+	netadr_t adr{};
+	adr.type = netadrtype_t::NA_IP;
+	adr.ip[ 0 ] = a;
+	adr.ip[ 1 ] = b;
+	adr.ip[ 2 ] = c;
+	adr.ip[ 3 ] = d;
+	adr.port = BigShort( 27960 );
+	return adr;
+}
+
+class ServerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		savedTime = svs.time;
+		savedClients = svs.clients;
+		savedNetworkScope = Cvar::GetValue( "sv_networkScope" );
+		svs.time = 100000;
+		ResetInfoBuckets();
+	}
+
+	void TearDown() override
+	{
+		svs.time = savedTime;
+		Cvar::SetValue( "sv_networkScope", savedNetworkScope );
+		if ( clients )
+		{
+			svs.clients = savedClients;
+			SV_UpdateClientIndex();
+		}
+		ResetInfoBuckets();
+	}
+
+	static void ResetInfoBuckets()
+	{
+		memset( &svs.infoLimiter, 0, sizeof( svs.infoLimiter ) );
+	}
+
+	// replaces the client slots until the end of the test, none of them connected
+	void UseFreeClients()
+	{
+		clients.reset( new client_t[ sv_maxClients.Get() ]() );
+		svs.clients = clients.get();
+		SV_UpdateClientIndex();
+	}
+
+	int savedTime;
+	client_t *savedClients;
+	std::string savedNetworkScope;
+	std::unique_ptr<client_t[]> clients;
+};
+
+TEST_F(ServerTest, DRDoSSubnetLimit)
+{
+	for ( int i = 0; i < INFO_SUBNET_QUERIES; i++ )
+	{
+		ASSERT_FALSE( SV_CheckDRDoS( PublicAddress( 198, 51, 100, i ) ) );
+	}
+
+	// the whole /24 shares the bucket, other subnets do not
+	ASSERT_TRUE( SV_CheckDRDoS( PublicAddress( 198, 51, 100, 200 ) ) );
+	ASSERT_FALSE( SV_CheckDRDoS( PublicAddress( 198, 51, 101, 1 ) ) );
+
+	// one query comes back after its share of the period
+	svs.time += INFO_RATE_PERIOD / INFO_SUBNET_QUERIES;
+	ASSERT_FALSE( SV_CheckDRDoS( PublicAddress( 198, 51, 100, 1 ) ) );
+	ASSERT_TRUE( SV_CheckDRDoS( PublicAddress( 198, 51, 100, 1 ) ) );
+}
+
+TEST_F(ServerTest, DRDoSGlobalLimit)
+{
+	for ( int i = 0; i < MAX_INFO_RECEIPTS; i++ )
+	{
+		ASSERT_FALSE( SV_CheckDRDoS( PublicAddress( 203, i, 113, 1 ) ) );
+	}
+
+	ASSERT_TRUE( SV_CheckDRDoS( PublicAddress( 203, 200, 113, 1 ) ) );
+
+	// queries blocked by the global limit do not use the subnet's tokens
+	svs.time += INFO_RATE_PERIOD;
+	for ( int i = 0; i < INFO_SUBNET_QUERIES; i++ )
+	{
+		ASSERT_FALSE( SV_CheckDRDoS( PublicAddress( 203, 200, 113, 1 ) ) );
+	}
+}
+
+TEST_F(ServerTest, FilterPacketLimitsAllConnectionless)
+{
+	auto filter = []( const netadr_t &from, const std::string &data, int time ) {
+		return SV_FilterPacket( from, reinterpret_cast<const byte *>( data.data() ), data.size(), time );
+	};
+	const std::string challenge = std::string( "\xff\xff\xff\xff" ) + "getchallenge";
+	const std::string info = std::string( "\xff\xff\xff\xff" ) + "getinfo xxx";
+	int time = 500000;
+
+	// junk shorter than a sequence number never reaches the main thread
+	ASSERT_FALSE( filter( PublicAddress( 198, 51, 110, 1 ), "ab", time ) );
+
+	for ( int i = 0; i < COMMAND_SUBNET_PACKETS; i++ )
+	{
+		ASSERT_TRUE( filter( PublicAddress( 198, 51, 110, 1 ), challenge, time ) );
+	}
+
+	ASSERT_FALSE( filter( PublicAddress( 198, 51, 110, 1 ), challenge, time ) );
+
+	// status queries are limited separately
+	ASSERT_TRUE( filter( PublicAddress( 198, 51, 110, 1 ), info, time ) );
+
+	// sequenced packets are left to SV_PacketEvent
+	ASSERT_TRUE( filter( PublicAddress( 198, 51, 110, 1 ), std::string( 16, '\x01' ), time ) );
+}
+
+TEST_F(ServerTest, FilterPacketSpoofedCommandFlood)
+{
+	auto filter = []( const netadr_t &from, const std::string &data, int time ) {
+		return SV_FilterPacket( from, reinterpret_cast<const byte *>( data.data() ), data.size(), time );
+	};
+	const std::string challenge = std::string( "\xff\xff\xff\xff" ) + "getchallenge";
+	const std::string connect = std::string( "\xff\xff\xff\xff" ) + "connect xxx";
+	int time = 600000;
+
+	// getchallenge from many more subnets than there are buckets
+	for ( int i = 0; i < 20 * MAX_INFO_BUCKETS; i++ )
+	{
+		filter( PublicAddress( 1 + i % 200, i / 200 % 256, i / 200 / 256, 1 ), challenge, time );
+	}
+
+	// a player can still connect
+	ASSERT_TRUE( filter( PublicAddress( 203, 0, 114, 7 ), challenge, time ) );
+	ASSERT_TRUE( filter( PublicAddress( 203, 0, 114, 7 ), connect, time + 100 ) );
+}
+
+// Replays a synthetic flood of status queries and junk sequenced packets,
+// mostly from a few subnets, through SV_PacketEvent and prints the packet rate.
+TEST_F(ServerTest, DISABLED_QueryFloodBenchmark)
+{
+	static const char *queries[] = { "getinfo xxx", "getstatus xxx", "getchallenge", "ping" };
+	const int count = 200000;
+	std::mt19937 rng( 1234 );
+	std::vector<std::pair<netadr_t, std::string>> packets;
+
+	for ( int i = 0; i < count; i++ )
+	{
+		netadr_t from = rng() % 4 ? PublicAddress( 198, 51, 100 + rng() % 4, rng() ) : PublicAddress( 1 + rng() % 200, rng(), rng(), rng() );
+		std::string data;
+
+		if ( rng() % 8 )
+		{
+			data = std::string( "\xff\xff\xff\xff" ) + queries[ rng() % ARRAY_LEN( queries ) ];
+		}
+		else
+		{
+			data = std::string( 16, '\0' );
+			for ( char &c : data )
+			{
+				c = rng();
+			}
+			data[ 0 ] = 0; // not connectionless
+		}
+
+		packets.emplace_back( from, std::move( data ) );
+	}
+
+	Cvar::SetValue( "sv_networkScope", "2" );
+	UseFreeClients();
+
+	static byte buffer[ MAX_MSGLEN ];
+	msg_t msg;
+	auto start = std::chrono::steady_clock::now();
+
+	for ( const auto &packet : packets )
+	{
+		MSG_Init( &msg, buffer, sizeof( buffer ) );
+		memcpy( buffer, packet.second.data(), packet.second.size() );
+		msg.cursize = packet.second.size();
+		SV_PacketEvent( packet.first, &msg );
+		svs.time += ( rng() % 100 ) == 0;
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>( end - start ).count();
+	printf( "SV_PacketEvent: %d packets in %.3f s, %.0f packets/s\n", count, seconds, count / seconds );
+}
+
+} // namespace
@@ -51,7 +51,6 @@ Maryland 20850 USA.
 struct svEntity_t
 {
 	entityState_t        baseline; // for delta compression of initial sighting
-	int                  snapshotCounter; // used to prevent double adding from portal views
 };
 
 enum class serverState_t
@@ -67,7 +66,6 @@ struct server_t
 	bool      restarting; // if true, send configstring changes during SS_LOADING
 	int           serverId; // changes each server start
 	int           restartedServerId; // serverId before a map_restart
-	int             snapshotCounter; // incremented for each snapshot built
 	int             timeResidual; // <= 1000 / sv_frame->value
 	int             nextFrameTime; // when time > nextFrameTime, process world
 
@@ -218,15 +216,35 @@ struct svstats_t
 	int    latched_packets;
 };
 
-struct receipt_t
+struct infoBucket_t
 {
-	netadr_t adr;
+	netadr_t adr; // masked to the subnet
+	int      tokens;
 	int      time;
 };
 
 // MAX_INFO_RECEIPTS is the maximum number of getstatus+getinfo responses that we send
-// in a two second time period.
-#define MAX_INFO_RECEIPTS 48
+// in a two second time period, INFO_SUBNET_QUERIES the maximum to a single subnet.
+#define INFO_RATE_PERIOD    2000
+#define MAX_INFO_RECEIPTS   48
+#define INFO_SUBNET_QUERIES 5
+
+// COMMAND_SUBNET_PACKETS is the maximum number of other connectionless commands
+// (getchallenge, connect, rcon...) a subnet may send in the same period when the
+// network thread filters them, enough for a few players connecting at once.
+#define COMMAND_SUBNET_PACKETS 10
+
+// must be a power of two
+#define MAX_INFO_BUCKETS    1024
+
+struct infoRateLimiter_t
+{
+	infoBucket_t buckets[ MAX_INFO_BUCKETS ];
+	int          globalTokens;
+	int          globalTime;
+	int          lastGlobalLogTime;
+	int          lastSpecificLogTime;
+};
 
 #define SERVER_PERFORMANCECOUNTER_FRAMES  600
 #define SERVER_PERFORMANCECOUNTER_SAMPLES 6
@@ -246,7 +264,7 @@ struct serverStatic_t
 	int           numSnapshotEntities; // sv_maxClients.Get()*PACKET_BACKUP*MAX_PACKET_ENTITIES
 	int           nextSnapshotEntities; // next snapshotEntities to use
 	std::unique_ptr<entityState_t[]> snapshotEntities; // [numSnapshotEntities]
-	receipt_t     infoReceipts[ MAX_INFO_RECEIPTS ];
+	infoRateLimiter_t infoLimiter;
 
 	int       sampleTimes[ SERVER_PERFORMANCECOUNTER_SAMPLES ];
 	int       currentSampleIndex;
@@ -254,6 +272,10 @@ struct serverStatic_t
 	int       currentFrameIndex;
 	int       serverLoad;
 	svstats_t stats;
+
+	// duration of the last simulated frame and of sending its snapshots, in microseconds
+	int       lastFrameUsec;
+	int       lastSendUsec;
 };
 
 //=============================================================================
@@ -331,6 +353,8 @@ void       SV_AddOperatorCommands();
 void       SV_RemoveOperatorCommands();
 
 void       SV_NET_Config();
+void       SV_UpdateClientIndex();
+bool       SV_CheckDRDoS( netadr_t from );
 
 void       SV_Heartbeat_f();
 void       SV_MasterHeartbeat( const char *hbname );
@@ -381,6 +405,7 @@ void SV_UpdateServerCommandsToClient( client_t *client, msg_t *msg );
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages();
 void SV_SendClientSnapshot( client_t *client );
+void SV_ClearEntityIndex();
 
 //bani
 void SV_SendClientIdle( client_t *client );
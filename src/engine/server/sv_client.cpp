@@ -195,6 +195,7 @@ void SV_DirectConnect( const netadr_t& from, const Cmd::Args& args )
 
 	// save the address
 	Netchan_Setup( netsrc_t::NS_SERVER, &new_client->netchan, from, qport );
+	SV_UpdateClientIndex();
 	// init the netchan queue
 
 	// Save the pubkey
@@ -411,6 +411,8 @@ void SV_ClearServer()
 	}
 
 	ResetStruct( sv );
+
+	SV_ClearEntityIndex();
 }
 
 /*
@@ -39,6 +39,7 @@ Maryland 20850 USA.
 #include "framework/Rcon.h"
 
 #include "common/Defs.h"
+#include "common/Profiler.h"
 #include "framework/CommandSystem.h"
 #include "framework/CvarSystem.h"
 #include "framework/Network.h"
@@ -616,115 +617,283 @@ static void SVC_Ping( const netadr_t& from, const Cmd::Args& )
 
 /*
 =================
-SV_CheckDRDoS
+SV_HashAddress
 
-DRDoS stands for "Distributed Reflected Denial of Service".
-See here: http://www.lemuria.org/security/application-drdos.html
+FNV-1a over the part of the address that NET_CompareBaseAdr looks at
+=================
+*/
+static uint32_t SV_HashAddress( const netadr_t& adr, uint32_t hash = 2166136261u )
+{
+	netadrtype_t type = NET_TYPE( adr.type );
+	const byte *bytes = nullptr;
+	int length = 0;
 
-Returns false if we're good.  true return value means we need to block.
-If the address isn't NA_IP, it's automatically denied.
+	if ( type == netadrtype_t::NA_IP )
+	{
+		bytes = adr.ip;
+		length = sizeof( adr.ip );
+	}
+	else if ( type == netadrtype_t::NA_IP6 )
+	{
+		bytes = adr.ip6;
+		length = sizeof( adr.ip6 );
+	}
+
+	hash = ( hash ^ Util::ordinal( type ) ) * 16777619u;
+
+	for ( int i = 0; i < length; i++ )
+	{
+		hash = ( hash ^ bytes[ i ] ) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+=================
+SV_TakeInfoToken
+
+Token bucket allowing a burst of up to queries and then queries per
+INFO_RATE_PERIOD. One query is worth INFO_RATE_PERIOD tokens and a bucket
+refills by its number of queries each millisecond, so everything stays in
+integers.
 =================
 */
-bool SV_CheckDRDoS( netadr_t from )
+static bool SV_TakeInfoToken( int *tokens, int *time, int now, int queries )
 {
-	int        i;
-	int        globalCount;
-	int        specificCount;
-	receipt_t  *receipt;
-	netadr_t   exactFrom;
-	int        oldest;
-	int        oldestTime;
-	static int lastGlobalLogTime = 0;
-	static int lastSpecificLogTime = 0;
+	int capacity = queries * INFO_RATE_PERIOD;
+	int elapsed = now - *time;
 
-	// Usually the network is smart enough to not allow incoming UDP packets
-	// with a source address being a spoofed LAN address.  Even if that's not
-	// the case, sending packets to other hosts in the LAN is not a big deal.
-	// NA_LOOPBACK qualifies as a LAN address.
-	if ( Sys_IsLANAddress( from ) ) { return false; }
+	// time does not go backwards, but a bucket may be older than a server restart
+	if ( !*time || elapsed < 0 || elapsed > INFO_RATE_PERIOD )
+	{
+		*tokens = capacity;
+	}
+	else
+	{
+		*tokens = std::min( capacity, *tokens + elapsed * queries );
+	}
+
+	*time = now;
+
+	if ( *tokens < INFO_RATE_PERIOD )
+	{
+		return false;
+	}
+
+	*tokens -= INFO_RATE_PERIOD;
+	return true;
+}
 
-	exactFrom = from;
+/*
+=================
+SV_MaskSubnet
 
-	if ( from.type == netadrtype_t::NA_IP )
+Reduces an address to its subnet, the unit of the rate limiters. Returns
+false for anything but IPv4 and IPv6.
+=================
+*/
+static bool SV_MaskSubnet( netadr_t *from )
+{
+	if ( from->type == netadrtype_t::NA_IP )
 	{
-		from.ip[ 3 ] = 0; // xx.xx.xx.0
+		from->ip[ 3 ] = 0; // xx.xx.xx.0
 	}
-	else if ( from.type == netadrtype_t::NA_IP6 )
+	else if ( from->type == netadrtype_t::NA_IP6 )
 	{
-		memset( from.ip6 + 7, 0, 9 ); // mask to /56
+		memset( from->ip6 + 7, 0, 9 ); // mask to /56
 	}
 	else
 	{
-		// So we got a connectionless packet but it's not IPv4, so
-		// what is it?  I don't care, it doesn't matter, we'll just block it.
-		// This probably won't even happen.
-		return true;
+		return false;
 	}
 
-	// Count receipts in last 2 seconds.
-	globalCount = 0;
-	specificCount = 0;
-	receipt = &svs.infoReceipts[ 0 ];
-	oldest = 0;
-	oldestTime = 0x7fffffff;
+	return true;
+}
 
-	for ( i = 0; i < MAX_INFO_RECEIPTS; i++, receipt++ )
+/*
+=================
+SV_CheckInfoRate
+
+Each subnet gets a token bucket in a small hash table, and all the
+queries share a global one, so a check costs the same however hard the
+server is being flooded. Returns true if the query must be blocked.
+=================
+*/
+static bool SV_CheckInfoRate( infoRateLimiter_t *limiter, netadr_t from, int now )
+{
+	netadr_t exactFrom = from;
+
+	// Usually the network is smart enough to not allow incoming UDP packets
+	// with a source address being a spoofed LAN address.  Even if that's not
+	// the case, sending packets to other hosts in the LAN is not a big deal.
+	// NA_LOOPBACK qualifies as a LAN address.
+	if ( Sys_IsLANAddress( from ) ) { return false; }
+
+	// So we got a connectionless packet but it's not IPv4, so
+	// what is it?  I don't care, it doesn't matter, we'll just block it.
+	// This probably won't even happen.
+	if ( !SV_MaskSubnet( &from ) ) { return true; }
+
+	infoBucket_t *bucket = &limiter->buckets[ SV_HashAddress( from ) & ( MAX_INFO_BUCKETS - 1 ) ];
+
+	// a subnet colliding with another one takes the slot over only once
+	// the bucket of the latter has refilled, otherwise they share it
+	if ( !NET_CompareBaseAdr( from, bucket->adr ) && ( !bucket->time || now - bucket->time >= INFO_RATE_PERIOD ) )
 	{
-		if ( receipt->time + 2000 > svs.time )
-		{
-			if ( receipt->time )
-			{
-				// When the server starts, all receipt times are at zero.  Furthermore,
-				// svs.time is close to zero.  We check that the receipt time is already
-				// set so that during the first two seconds after server starts, queries
-				// from the master servers don't get ignored.  As a consequence a potentially
-				// unlimited number of getinfo+getstatus responses may be sent during the
-				// first frame of a server's life.
-				globalCount++;
-			}
+		bucket->adr = from;
+	}
 
-			if ( NET_CompareBaseAdr( from, receipt->adr ) )
-			{
-				specificCount++;
-			}
-		}
+	// check the subnet before taking a global token, so a single flooding
+	// subnet can not starve the others
+	int tokens = bucket->tokens, time = bucket->time;
 
-		if ( receipt->time < oldestTime )
+	if ( !SV_TakeInfoToken( &tokens, &time, now, INFO_SUBNET_QUERIES ) )
+	{
+		if ( limiter->lastSpecificLogTime + 1000 <= now ) // Limit one log every second.
 		{
-			oldestTime = receipt->time;
-			oldest = i;
+			netLog.Notice( "Possible DRDoS attack to address %s, ignoring getinfo/getstatus connectionless packet",
+			               Net::AddressToString( exactFrom ) );
+			limiter->lastSpecificLogTime = now;
 		}
+
+		return true;
 	}
 
-	if ( globalCount == MAX_INFO_RECEIPTS ) // All receipts happened in last 2 seconds.
+	if ( !SV_TakeInfoToken( &limiter->globalTokens, &limiter->globalTime, now, MAX_INFO_RECEIPTS ) )
 	{
-		if ( lastGlobalLogTime + 1000 <= svs.time ) // Limit one log every second.
+		if ( limiter->lastGlobalLogTime + 1000 <= now ) // Limit one log every second.
 		{
 			netLog.Notice( "Detected flood of getinfo/getstatus connectionless packets" );
-			lastGlobalLogTime = svs.time;
+			limiter->lastGlobalLogTime = now;
 		}
 
 		return true;
 	}
 
-	if ( specificCount >= 5 ) // Already sent 5 to this IP address in last 2 seconds.
+	bucket->tokens = tokens;
+	bucket->time = time;
+	return false;
+}
+
+/*
+=================
+SV_CheckCommandRate
+
+Limits the connectionless commands other than the status queries, such as
+getchallenge, connect and rcon, per subnet only: with a global limit, a
+spoofed flood from many subnets would keep every player from connecting.
+For the same reason, a packet whose bucket is held by another subnet is let
+through, as it would be without the network thread. Returns true if the
+packet must be blocked.
+=================
+*/
+static bool SV_CheckCommandRate( infoRateLimiter_t *limiter, netadr_t from, int now )
+{
+	netadr_t exactFrom = from;
+
+	if ( Sys_IsLANAddress( from ) ) { return false; }
+
+	if ( !SV_MaskSubnet( &from ) ) { return true; }
+
+	infoBucket_t *bucket = &limiter->buckets[ SV_HashAddress( from ) & ( MAX_INFO_BUCKETS - 1 ) ];
+
+	if ( !NET_CompareBaseAdr( from, bucket->adr ) )
 	{
-		if ( lastSpecificLogTime + 1000 <= svs.time ) // Limit one log every second.
+		if ( bucket->time && now - bucket->time < INFO_RATE_PERIOD )
 		{
-			netLog.Notice( "Possible DRDoS attack to address %i.%i.%i.%i, ignoring getinfo/getstatus connectionless packet",
-			               exactFrom.ip[ 0 ], exactFrom.ip[ 1 ], exactFrom.ip[ 2 ], exactFrom.ip[ 3 ] );
-			lastSpecificLogTime = svs.time;
+			return false;
+		}
+
+		bucket->adr = from;
+	}
+
+	if ( !SV_TakeInfoToken( &bucket->tokens, &bucket->time, now, COMMAND_SUBNET_PACKETS ) )
+	{
+		if ( limiter->lastSpecificLogTime + 1000 <= now ) // Limit one log every second.
+		{
+			netLog.Notice( "Possible flood from address %s, ignoring connectionless command",
+			               Net::AddressToString( exactFrom ) );
+			limiter->lastSpecificLogTime = now;
 		}
 
 		return true;
 	}
 
-	receipt = &svs.infoReceipts[ oldest ];
-	receipt->adr = from;
-	receipt->time = svs.time;
 	return false;
 }
 
+/*
+=================
+SV_CheckDRDoS
+
+DRDoS stands for "Distributed Reflected Denial of Service".
+See here: http://www.lemuria.org/security/application-drdos.html
+
+Returns false if we're good.  true return value means we need to block.
+If the address isn't NA_IP, it's automatically denied.
+=================
+*/
+bool SV_CheckDRDoS( netadr_t from )
+{
+	// the network thread already did it in SV_FilterPacket
+	if ( Sys_NetThreadRunning() )
+	{
+		return false;
+	}
+
+	return SV_CheckInfoRate( &svs.infoLimiter, from, svs.time );
+}
+
+/*
+=================
+SV_FilterPacket
+
+Called on the network thread for each packet it receives, with its own
+rate limiters. The status queries and the other connectionless commands
+have separate limits, so a query flood does not keep players from
+connecting, see SV_CheckCommandRate. Returns false if the packet must be
+dropped before reaching SV_PacketEvent.
+=================
+*/
+bool SV_FilterPacket( const netadr_t& from, const byte *data, int length, int time )
+{
+	static infoRateLimiter_t infoLimiter;
+	static infoRateLimiter_t commandLimiter;
+
+	// too short to be anything
+	if ( length < 4 )
+	{
+		return false;
+	}
+
+	// sequenced packets are matched against the clients by SV_PacketEvent
+	int sequence;
+	memcpy( &sequence, data, sizeof( sequence ) );
+
+	if ( sequence != -1 )
+	{
+		return true;
+	}
+
+	const char *command = reinterpret_cast<const char *>( data ) + 4;
+	int commandLength = 0;
+
+	while ( 4 + commandLength < length && command[ commandLength ] > ' ' )
+	{
+		commandLength++;
+	}
+
+	std::string name( command, commandLength );
+
+	if ( name == "getstatus" || name == "getinfo" )
+	{
+		return !SV_CheckInfoRate( &infoLimiter, from, time );
+	}
+
+	return !SV_CheckCommandRate( &commandLimiter, from, time );
+}
+
 /*
 ===============
 SVC_RemoteCommand
@@ -1065,6 +1234,92 @@ static bool SV_IsAllowedNetwork( const netadr_t& address )
 	ASSERT_UNREACHABLE();
 }
 
+/*
+=================
+SV_UpdateClientIndex
+
+Rebuilds the hash table from the base address and qport of the clients
+to their slot, which SV_PacketEvent uses to find the sender of a packet.
+Entries are checked against the client when they are looked up, so a
+client leaving does not need to update the index, but one connecting
+does.
+=================
+*/
+static std::vector<int> clientIndex;
+
+static uint32_t SV_ClientIndexHash( const netadr_t& adr, int qport )
+{
+	uint32_t hash = SV_HashAddress( adr );
+	hash = ( hash ^ ( qport & 0xff ) ) * 16777619u;
+	return ( hash ^ ( ( qport >> 8 ) & 0xff ) ) * 16777619u;
+}
+
+void SV_UpdateClientIndex()
+{
+	size_t size = 16;
+
+	while ( size < 2 * static_cast<size_t>( sv_maxClients.Get() ) )
+	{
+		size *= 2;
+	}
+
+	clientIndex.assign( size, -1 );
+
+	if ( !svs.clients )
+	{
+		return;
+	}
+
+	for ( int i = 0; i < sv_maxClients.Get(); i++ )
+	{
+		const client_t *cl = &svs.clients[ i ];
+
+		if ( cl->state == clientState_t::CS_FREE || SV_IsBot( cl ) )
+		{
+			continue;
+		}
+
+		size_t slot = SV_ClientIndexHash( cl->netchan.remoteAddress, cl->netchan.qport ) & ( size - 1 );
+
+		while ( clientIndex[ slot ] != -1 )
+		{
+			slot = ( slot + 1 ) & ( size - 1 );
+		}
+
+		clientIndex[ slot ] = i;
+	}
+}
+
+static client_t *SV_FindClient( const netadr_t& from, int qport )
+{
+	if ( clientIndex.empty() || !svs.clients )
+	{
+		return nullptr;
+	}
+
+	size_t mask = clientIndex.size() - 1;
+
+	for ( size_t slot = SV_ClientIndexHash( from, qport ) & mask; clientIndex[ slot ] != -1; slot = ( slot + 1 ) & mask )
+	{
+		if ( clientIndex[ slot ] >= sv_maxClients.Get() )
+		{
+			continue;
+		}
+
+		client_t *cl = &svs.clients[ clientIndex[ slot ] ];
+
+		// it is possible to have multiple clients from a single IP
+		// address, so they are differentiated by the qport variable
+		if ( cl->state != clientState_t::CS_FREE && cl->netchan.qport == qport &&
+		     NET_CompareBaseAdr( from, cl->netchan.remoteAddress ) )
+		{
+			return cl;
+		}
+	}
+
+	return nullptr;
+}
+
 /*
 =================
 SV_PacketEvent
@@ -1072,7 +1327,6 @@ SV_PacketEvent
 */
 void SV_PacketEvent( const netadr_t& from, msg_t *msg )
 {
-	int      i;
 	client_t *cl;
 	int      qport;
 
@@ -1095,25 +1349,10 @@ void SV_PacketEvent( const netadr_t& from, msg_t *msg )
 	qport = MSG_ReadShort( msg ) & 0xffff;
 
 	// find which client the message is from
-	for ( i = 0, cl = svs.clients; i < sv_maxClients.Get(); i++, cl++ )
-	{
-		if ( cl->state == clientState_t::CS_FREE )
-		{
-			continue;
-		}
-
-		if ( !NET_CompareBaseAdr( from, cl->netchan.remoteAddress ) )
-		{
-			continue;
-		}
-
-		// it is possible to have multiple clients from a single IP
-		// address, so they are differentiated by the qport variable
-		if ( cl->netchan.qport != qport )
-		{
-			continue;
-		}
+	cl = SV_FindClient( from, qport );
 
+	if ( cl )
+	{
 		// the IP port can't be used to differentiate them, because
 		// some address translating routers periodically change UDP
 		// port assignments
@@ -1345,6 +1584,10 @@ void SV_Frame( int msec )
 		return;
 	}
 
+	PROFILE_ZONE( "SV_Frame" );
+
+	Sys::SteadyClock::time_point frameStart = Sys::SteadyClock::now();
+
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
 	// than checking for negative time wraparound everywhere.
@@ -1421,9 +1664,18 @@ void SV_Frame( int msec )
 	// check timeouts
 	SV_CheckTimeouts();
 
+	// connecting clients update the index themselves, this is only in case
+	// a slot changed some other way
+	SV_UpdateClientIndex();
+
 	// send messages back to the clients
+	Sys::SteadyClock::time_point sendStart = Sys::SteadyClock::now();
 	SV_SendClientMessages();
 
+	Sys::SteadyClock::time_point sendEnd = Sys::SteadyClock::now();
+	svs.lastSendUsec = std::chrono::duration_cast<std::chrono::microseconds>( sendEnd - sendStart ).count();
+	svs.lastFrameUsec = std::chrono::duration_cast<std::chrono::microseconds>( sendEnd - frameStart ).count();
+
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat( HEARTBEAT_GAME );
 
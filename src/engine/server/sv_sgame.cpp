@@ -40,6 +40,7 @@ Maryland 20850 USA.
 #include "qcommon/sys.h"
 #include "framework/CommonVMServices.h"
 #include "framework/CommandSystem.h"
+#include "common/Profiler.h"
 
 #ifndef BUILD_SERVER
 #include "client/client.h" // For bot debug draw
@@ -421,6 +422,8 @@ void GameVM::BotAIStartFrame(int)
 
 void GameVM::Syscall(uint32_t id, Util::Reader reader, IPC::Channel& channel)
 {
+	PROFILE_ZONE("GameVM::Syscall");
+
 	int major = id >> 16;
 	int minor = id & 0xffff;
 	if (major == VM::QVM) {
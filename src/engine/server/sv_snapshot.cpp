@@ -34,6 +34,10 @@ Maryland 20850 USA.
 
 #include "server.h"
 #include "qcommon/sys.h"
+#include "framework/ThreadPool.h"
+#include "common/Profiler.h"
+
+#include <bitset>
 
 /*
 =============================================================================
@@ -58,9 +62,131 @@ A server packet will look something like:
 */
 
 static Cvar::Cvar<bool> sv_novis("sv_novis", "skip PVS check when transmitting entities", 0, false);
+static Cvar::Range<Cvar::Cvar<int>> sv_snapshotThreads("sv_snapshotThreads",
+	"worker threads used to build and encode client snapshots, 0 to do it all on the main thread",
+	Cvar::NONE, 0, 0, ThreadPool::MAX_WORKERS);
+
+static Cvar::Cvar<bool> sv_deltaCache("sv_deltaCache",
+	"reuse the encoding of entity deltas that are sent to several clients in the same frame", Cvar::NONE, true);
+
+static Cvar::Cvar<bool> sv_fragmentBurst("sv_fragmentBurst",
+	"send as many fragments of a large message per frame as the client's rate allows, instead of one",
+	Cvar::NONE, false);
 
 static Log::Logger bandwidthLog("server.bandwidth");
 
+/*
+=============================================================================
+
+Entity delta cache
+
+Clients usually delta the same entity from the same old state (very often
+the baseline) to the same new state. The compressed encoding of a delta
+does not depend on where it starts in the message, so the bits produced for
+the first client are kept for the rest of the frame and copied for the others.
+
+Each thread keeps its own cache so snapshots can be encoded in parallel.
+
+=============================================================================
+*/
+
+// large enough for any single entity delta, plus the MSG_WriteBits overflow margin
+static const int MAX_DELTA_BYTES = 1024;
+
+struct deltaCacheEntry_t
+{
+	entityState_t from;
+	entityState_t to;
+	bool          force;
+	int           bits;
+	int           uncompressedBits;
+	int           offset; // into deltaCache_t::data
+};
+
+struct deltaCache_t
+{
+	int                                         frame = -1;
+	std::vector<std::vector<deltaCacheEntry_t>> entities{ MAX_GENTITIES };
+	std::vector<int>                            used; // entity numbers with entries
+	std::vector<byte>                           data;
+};
+
+static std::atomic<int> deltaCacheFrame;
+static std::atomic<int> deltaCacheHits;
+static std::atomic<int> deltaCacheMisses;
+
+/*
+=============
+SV_WriteDeltaEntity
+
+Same as MSG_WriteDeltaEntity( msg, from, to, force ) with a non-null to.
+=============
+*/
+static void SV_WriteDeltaEntity( msg_t *msg, entityState_t *from, entityState_t *to, bool force )
+{
+	static thread_local deltaCache_t cache;
+
+	// nothing is written for unchanged entities, which are the majority
+	if ( !force && !memcmp( from, to, sizeof( entityState_t ) ) )
+	{
+		return;
+	}
+
+	// close to the end, let MSG_WriteBits decide exactly when the message overflows
+	if ( !sv_deltaCache.Get() || msg->oob || msg->maxsize - msg->cursize < 2 * MAX_DELTA_BYTES )
+	{
+		MSG_WriteDeltaEntity( msg, from, to, force );
+		return;
+	}
+
+	if ( cache.frame != deltaCacheFrame )
+	{
+		for ( int number : cache.used )
+		{
+			cache.entities[ number ].clear();
+		}
+
+		cache.used.clear();
+		cache.data.clear();
+		cache.frame = deltaCacheFrame;
+	}
+
+	std::vector<deltaCacheEntry_t> &entries = cache.entities[ to->number ];
+
+	for ( const deltaCacheEntry_t &entry : entries )
+	{
+		if ( entry.force == force &&
+		     !memcmp( &entry.from, from, sizeof( entityState_t ) ) &&
+		     !memcmp( &entry.to, to, sizeof( entityState_t ) ) )
+		{
+			MSG_WriteBitstream( msg, cache.data.data() + entry.offset, entry.bits );
+			msg->uncompsize += entry.uncompressedBits;
+			deltaCacheHits++;
+			return;
+		}
+	}
+
+	byte  buffer[ MAX_DELTA_BYTES ];
+	msg_t delta;
+
+	MSG_Init( &delta, buffer, sizeof( buffer ) );
+	MSG_WriteDeltaEntity( &delta, from, to, force );
+
+	if ( entries.empty() )
+	{
+		cache.used.push_back( to->number );
+	}
+
+	int offset = cache.data.size();
+	int numBytes = ( delta.bit + 7 ) >> 3;
+	cache.data.insert( cache.data.end(), buffer, buffer + numBytes );
+	entries.push_back( { *from, *to, force, delta.bit, delta.uncompsize, offset } );
+
+	MSG_WriteBitstream( msg, buffer, delta.bit );
+	msg->uncompsize += delta.uncompsize;
+	deltaCacheMisses++;
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -122,7 +248,7 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity( msg, oldent, newent, false );
+			SV_WriteDeltaEntity( msg, oldent, newent, false );
 			oldindex++;
 			newindex++;
 			continue;
@@ -131,7 +257,7 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_
 		if ( newnum < oldnum )
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( msg, &sv.svEntities[ newnum ].baseline, newent, true );
+			SV_WriteDeltaEntity( msg, &sv.svEntities[ newnum ].baseline, newent, true );
 			newindex++;
 			continue;
 		}
@@ -151,9 +277,13 @@ static void SV_EmitPacketEntities( const clientSnapshot_t *from, clientSnapshot_
 /*
 ==================
 SV_WriteSnapshotToClient
+
+nextSnapshotEntities is the value svs.nextSnapshotEntities had right after the
+entities of this client's frame were allocated, which decides whether an old
+frame's entities have already rolled off the buffer.
 ==================
 */
-static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg )
+static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg, int nextSnapshotEntities )
 {
 	clientSnapshot_t *frame, *oldframe;
 	int              lastframe;
@@ -184,7 +314,7 @@ static void SV_WriteSnapshotToClient( client_t *client, msg_t *msg )
 		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 
 		// the snapshot's entities may still have rolled off the buffer, though
-		if ( oldframe->first_entity <= svs.nextSnapshotEntities - svs.numSnapshotEntities )
+		if ( oldframe->first_entity <= nextSnapshotEntities - svs.numSnapshotEntities )
 		{
 			Log::Debug( "%s^*: Delta request from out of date entities.", client->name );
 			oldframe = nullptr;
@@ -285,31 +415,25 @@ struct snapshotEntityNumbers_t
 {
 	int numSnapshotEntities;
 	int snapshotEntities[ MAX_SNAPSHOT_ENTITIES ];
+
+	// used to prevent double adding from portal views
+	std::bitset<MAX_GENTITIES> added;
 };
 
 /*
 =======================
-SV_QsortEntityNumbers
+SV_SortEntityNumbers
+
+Sorts the entity numbers for the delta compression and returns false if
+an entity was included twice. It doesn't drop, as it runs on the
+snapshot workers.
 =======================
 */
-static int SV_QsortEntityNumbers( const void *a, const void *b )
+static bool SV_SortEntityNumbers( int *entityNumbers, int count )
 {
-	int *ea, *eb;
-
-	ea = ( int * ) a;
-	eb = ( int * ) b;
-
-	if ( *ea == *eb )
-	{
-		Sys::Drop( "SV_QsortEntityNumbers: duplicated entity" );
-	}
-
-	if ( *ea < *eb )
-	{
-		return -1;
-	}
+	std::sort( entityNumbers, entityNumbers + count );
 
-	return 1;
+	return std::adjacent_find( entityNumbers, entityNumbers + count ) == entityNumbers + count;
 }
 
 /*
@@ -320,13 +444,15 @@ SV_AddEntToSnapshot
 static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt,
                                  snapshotEntityNumbers_t *eNums )
 {
+	int svEntNum = svEnt - sv.svEntities;
+
 	// if we have already added this entity to this snapshot, don't add again
-	if ( svEnt->snapshotCounter == sv.snapshotCounter )
+	if ( eNums->added[ svEntNum ] )
 	{
 		return;
 	}
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[ svEntNum ] = true;
 
 	// if we are full, silently discard entities
 	if ( eNums->numSnapshotEntities == MAX_SNAPSHOT_ENTITIES )
@@ -339,316 +465,601 @@ static void SV_AddEntToSnapshot( svEntity_t *svEnt, sharedEntity_t *gEnt,
 }
 
 /*
-===============
-SV_AddEntitiesVisibleFromPoint
-===============
+=============================================================================
+
+Cluster to entity index
+
+Lets a snapshot visit only the entities touching a cluster in the viewer's
+PVS instead of every entity in the world. Entities are linked by the game,
+so rather than being told about links the index compares the link state of
+each entity against the one it last saw, once per frame, and only moves the
+entities that changed.
+
+=============================================================================
 */
-static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
-//                                  snapshotEntityNumbers_t *eNums, bool portal, clientSnapshot_t *oldframe, bool localClient ) {
-//                                  snapshotEntityNumbers_t *eNums, bool portal ) {
-    snapshotEntityNumbers_t *eNums /*, bool portal, bool localClient */ )
+
+static Cvar::Range<Cvar::Cvar<int>> sv_snapshotIndex("sv_snapshotIndex",
+	"find the entities visible to a client through a cluster index; 2 also checks the result against a full scan",
+	Cvar::NONE, 1, 0, 2);
+
+struct entitySet_t
 {
-	int            e, i;
-	sharedEntity_t *ent, *playerEnt;
-	svEntity_t     *svEnt;
-	int            l;
-	int            clientarea, clientcluster;
-	int            leafnum;
-//	int             c_fullsend;
-	byte           *clientpvs;
-	byte           *bitvector;
+	uint64_t bits[ MAX_GENTITIES / 64 ];
+};
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specifically check for it
-	if (sv.state == serverState_t::SS_DEAD)
+struct indexedEntity_t
+{
+	bool always; // a candidate for every viewer, regardless of PVS
+	int  numClusters;
+	int  clusters[ MAX_ENT_CLUSTERS ];
+
+	bool operator==( const indexedEntity_t &other ) const
 	{
-		return;
+		return always == other.always && numClusters == other.numClusters &&
+		       std::equal( clusters, clusters + numClusters, other.clusters );
 	}
+};
 
-	leafnum = CM_PointLeafnum( origin );
-	clientarea = CM_LeafArea( leafnum );
-	clientcluster = CM_LeafCluster( leafnum );
+struct entityIndex_t
+{
+	int                           numEntities;
+	std::vector<std::vector<int>> clusterEntities;
+	indexedEntity_t               entities[ MAX_GENTITIES ];
+	entitySet_t                   always;
+};
 
-	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+static entityIndex_t entityIndex;
 
-	clientpvs = CM_ClusterPVS( clientcluster );
+/*
+===============
+SV_ClearEntityIndex
+===============
+*/
+void SV_ClearEntityIndex()
+{
+	entityIndex.numEntities = 0;
+	entityIndex.clusterEntities.clear();
+	memset( entityIndex.entities, 0, sizeof( entityIndex.entities ) );
+	memset( &entityIndex.always, 0, sizeof( entityIndex.always ) );
+}
 
-//	c_fullsend = 0;
+/*
+===============
+SV_IndexEntry
 
-	playerEnt = SV_GentityNum( frame->ps.clientNum );
+Works out where SV_AddEntityIfVisible may find the entity visible.
+Anything the index can't describe by clusters is checked for every viewer.
+===============
+*/
+static void SV_IndexEntry( const sharedEntity_t *ent, int numClusters, indexedEntity_t *entry )
+{
+	entry->always = false;
+	entry->numClusters = 0;
 
-	if ( playerEnt->r.svFlags & SVF_SELF_PORTAL )
+	if ( !ent->r.linked || ( ent->r.svFlags & SVF_NOCLIENT ) )
+	{
+		return;
+	}
+
+	if ( ent->r.svFlags & ( SVF_BROADCAST | SVF_CLIENTS_IN_RANGE ) )
 	{
-		SV_AddEntitiesVisibleFromPoint( playerEnt->s.origin2, frame, eNums );
+		entry->always = true;
+		return;
 	}
 
-	for ( e = 0; e < sv.num_entities; e++ )
+	if ( ent->r.svFlags & SVF_IGNOREBMODELEXTENTS )
+	{
+		entry->clusters[ entry->numClusters++ ] = ent->r.originCluster;
+	}
+	else if ( ent->r.lastCluster || ent->r.numClusters < 0 || ent->r.numClusters > MAX_ENT_CLUSTERS )
 	{
-		ent = SV_GentityNum( e );
+		// overflowed the cluster list
+		entry->always = true;
+		return;
+	}
+	else
+	{
+		entry->numClusters = ent->r.numClusters;
+		std::copy_n( ent->r.clusternums, entry->numClusters, entry->clusters );
+	}
 
-		// never send entities that aren't linked in
-		if ( !ent->r.linked )
+	for ( int i = 0; i < entry->numClusters; i++ )
+	{
+		if ( entry->clusters[ i ] < 0 || entry->clusters[ i ] >= numClusters )
 		{
-			continue;
+			entry->always = true;
+			entry->numClusters = 0;
+			return;
 		}
+	}
+}
+
+/*
+===============
+SV_UpdateEntityIndex
+
+Must be called on the main thread before building snapshots. Also fixes
+the numbers of the linked entities, which the snapshots rely on and which
+the snapshot workers must not write.
+===============
+*/
+static void SV_UpdateEntityIndex()
+{
+	int numClusters = CM_NumClusters();
+
+	for ( int e = 0; e < sv.num_entities; e++ )
+	{
+		sharedEntity_t *ent = SV_GentityNum( e );
 
-		if ( ent->s.number != e )
+		if ( ent->r.linked && ent->s.number != e )
 		{
 			Log::Debug( "FIXING ENT->S.NUMBER!!!" );
 			ent->s.number = e;
 		}
+	}
+
+	if ( static_cast<int>( entityIndex.clusterEntities.size() ) != numClusters )
+	{
+		SV_ClearEntityIndex();
+		entityIndex.clusterEntities.resize( numClusters );
+	}
+
+	int numEntities = std::max( entityIndex.numEntities, sv.num_entities );
+
+	for ( int e = 0; e < numEntities; e++ )
+	{
+		indexedEntity_t entry{};
+
+		if ( e < sv.num_entities )
+		{
+			SV_IndexEntry( SV_GentityNum( e ), numClusters, &entry );
+		}
 
-		// entities can be flagged to explicitly not be sent to the client
-		if ( ent->r.svFlags & SVF_NOCLIENT )
+		indexedEntity_t &old = entityIndex.entities[ e ];
+
+		if ( entry == old )
 		{
 			continue;
 		}
 
-		// entities can be flagged to be sent to only one client
-		if ( ent->r.svFlags & SVF_SINGLECLIENT )
+		for ( int i = 0; i < old.numClusters; i++ )
 		{
-			if ( ent->r.singleClient != frame->ps.clientNum )
-			{
-				continue;
-			}
+			std::vector<int> &bucket = entityIndex.clusterEntities[ old.clusters[ i ] ];
+			auto it = std::find( bucket.begin(), bucket.end(), e );
+			*it = bucket.back();
+			bucket.pop_back();
 		}
 
-		// entities can be flagged to be sent to everyone but one client
-		if ( ent->r.svFlags & SVF_NOTSINGLECLIENT )
+		for ( int i = 0; i < entry.numClusters; i++ )
 		{
-			if ( ent->r.singleClient == frame->ps.clientNum )
-			{
-				continue;
-			}
+			entityIndex.clusterEntities[ entry.clusters[ i ] ].push_back( e );
+		}
+
+		if ( entry.always )
+		{
+			entityIndex.always.bits[ e / 64 ] |= uint64_t( 1 ) << ( e % 64 );
+		}
+		else
+		{
+			entityIndex.always.bits[ e / 64 ] &= ~( uint64_t( 1 ) << ( e % 64 ) );
 		}
 
-		// entities can be flagged to be sent to only a given mask of clients
-		if ( ent->r.svFlags & SVF_CLIENTMASK )
+		old = entry;
+	}
+
+	entityIndex.numEntities = sv.num_entities;
+}
+
+/*
+===============
+SV_GatherIndexedEntities
+
+Collects the entities that may be visible from a PVS.
+===============
+*/
+static void SV_GatherIndexedEntities( const byte *pvs, entitySet_t *candidates )
+{
+	int numClusters = entityIndex.clusterEntities.size();
+
+	*candidates = entityIndex.always;
+
+	for ( int i = 0; i < ( numClusters + 7 ) >> 3; i++ )
+	{
+		unsigned int visible = pvs[ i ];
+
+		while ( visible )
 		{
-			if ( frame->ps.clientNum >= 32 )
+			int cluster = i * 8 + CountTrailingZeroes( visible );
+			visible &= visible - 1;
+
+			if ( cluster >= numClusters )
 			{
-				if ( ~ent->r.hiMask & ( 1 << ( frame->ps.clientNum - 32 ) ) )
-				{
-					continue;
-				}
+				break;
 			}
-			else
+
+			for ( int e : entityIndex.clusterEntities[ cluster ] )
 			{
-				if ( ~ent->r.loMask & ( 1 << frame->ps.clientNum ) )
-				{
-					continue;
-				}
+				candidates->bits[ e / 64 ] |= uint64_t( 1 ) << ( e % 64 );
 			}
 		}
+	}
+}
+
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
+    snapshotEntityNumbers_t *eNums, bool useIndex );
+
+/*
+===============
+SV_AddEntityIfVisible
+===============
+*/
+static void SV_AddEntityIfVisible( int e, vec3_t origin, clientSnapshot_t *frame, snapshotEntityNumbers_t *eNums,
+                                   sharedEntity_t *playerEnt, int clientarea, byte *clientpvs, bool useIndex )
+{
+	int            i;
+	sharedEntity_t *ent;
+	svEntity_t     *svEnt;
+	int            l;
+	byte           *bitvector;
 
-		svEnt = SV_SvEntityForGentity( ent );
+	ent = SV_GentityNum( e );
+
+	// never send entities that aren't linked in
+	if ( !ent->r.linked )
+	{
+		return;
+	}
+
+	// entities can be flagged to explicitly not be sent to the client
+	if ( ent->r.svFlags & SVF_NOCLIENT )
+	{
+		return;
+	}
 
-		// don't double add an entity through portals
-		if ( svEnt->snapshotCounter == sv.snapshotCounter )
+	// entities can be flagged to be sent to only one client
+	if ( ent->r.svFlags & SVF_SINGLECLIENT )
+	{
+		if ( ent->r.singleClient != frame->ps.clientNum )
 		{
-			continue;
+			return;
 		}
+	}
 
-		if ( sv_novis.Get() )
+	// entities can be flagged to be sent to everyone but one client
+	if ( ent->r.svFlags & SVF_NOTSINGLECLIENT )
+	{
+		if ( ent->r.singleClient == frame->ps.clientNum )
 		{
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
-			continue;
+			return;
 		}
+	}
 
-		// broadcast entities are always sent
-		if ( ent->r.svFlags & SVF_BROADCAST )
+	// entities can be flagged to be sent to only a given mask of clients
+	if ( ent->r.svFlags & SVF_CLIENTMASK )
+	{
+		if ( frame->ps.clientNum >= 32 )
 		{
-			SV_AddEntToSnapshot( svEnt, ent, eNums );
-			continue;
+			if ( ~ent->r.hiMask & ( 1 << ( frame->ps.clientNum - 32 ) ) )
+			{
+				return;
+			}
 		}
+		else
+		{
+			if ( ~ent->r.loMask & ( 1 << frame->ps.clientNum ) )
+			{
+				return;
+			}
+		}
+	}
+
+	svEnt = SV_SvEntityForGentity( ent );
+
+	// don't double add an entity through portals
+	if ( eNums->added[ svEnt - sv.svEntities ] )
+	{
+		return;
+	}
+
+	if ( sv_novis.Get() )
+	{
+		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		return;
+	}
+
+	// broadcast entities are always sent
+	if ( ent->r.svFlags & SVF_BROADCAST )
+	{
+		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		return;
+	}
 
-		// send entity if the client is in range
-		if ( (ent->r.svFlags & SVF_CLIENTS_IN_RANGE) &&
-		     Distance( ent->s.origin, playerEnt->s.origin ) <= ent->r.clientRadius )
+	// send entity if the client is in range
+	if ( (ent->r.svFlags & SVF_CLIENTS_IN_RANGE) &&
+	     Distance( ent->s.origin, playerEnt->s.origin ) <= ent->r.clientRadius )
+	{
+		SV_AddEntToSnapshot( svEnt, ent, eNums );
+		return;
+	}
+
+	bitvector = clientpvs;
+
+	// Gordon: just check origin for being in pvs, ignore bmodel extents
+	if ( ent->r.svFlags & SVF_IGNOREBMODELEXTENTS )
+	{
+		if ( bitvector[ ent->r.originCluster >> 3 ] & ( 1 << ( ent->r.originCluster & 7 ) ) )
 		{
 			SV_AddEntToSnapshot( svEnt, ent, eNums );
-			continue;
 		}
 
-		bitvector = clientpvs;
+		return;
+	}
 
-		// Gordon: just check origin for being in pvs, ignore bmodel extents
-		if ( ent->r.svFlags & SVF_IGNOREBMODELEXTENTS )
+	// ignore if not touching a PV leaf
+	// check area
+	if ( !CM_AreasConnected( clientarea, ent->r.areanum ) )
+	{
+		// doors can legally straddle two areas, so
+		// we may need to check another one
+		if ( !CM_AreasConnected( clientarea, ent->r.areanum2 ) )
 		{
-			if ( bitvector[ ent->r.originCluster >> 3 ] & ( 1 << ( ent->r.originCluster & 7 ) ) )
-			{
-				SV_AddEntToSnapshot( svEnt, ent, eNums );
-			}
+			return;
+		}
+	}
 
-			continue;
+	// check individual leafs
+	if ( !ent->r.numClusters )
+	{
+		return;
+	}
+
+	l = 0;
+
+	for ( i = 0; i < std::min(std::max(0, ent->r.numClusters), MAX_ENT_CLUSTERS); i++ )
+	{
+		l = ent->r.clusternums[ i ];
+
+		if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
+		{
+			break;
 		}
+	}
 
-		// ignore if not touching a PV leaf
-		// check area
-		if ( !CM_AreasConnected( clientarea, ent->r.areanum ) )
+	// if we haven't found it to be visible,
+	// check the overflow clusters that couldn't be stored
+	if ( i == ent->r.numClusters )
+	{
+		if ( ent->r.lastCluster )
 		{
-			// doors can legally straddle two areas, so
-			// we may need to check another one
-			if ( !CM_AreasConnected( clientarea, ent->r.areanum2 ) )
+			for ( ; l <= ent->r.lastCluster; l++ )
 			{
-				continue;
+				if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
+				{
+					break;
+				}
 			}
-		}
 
-		// check individual leafs
-		if ( !ent->r.numClusters )
+			if ( l == ent->r.lastCluster )
+			{
+				return;
+			}
+		}
+		else
 		{
-			continue;
+			return;
 		}
+	}
 
-		l = 0;
+	//----(SA) added "visibility dummies"
+	if ( ent->r.svFlags & SVF_VISDUMMY )
+	{
+		sharedEntity_t *ment = nullptr;
+
+		//find master;
+		ment = SV_GentityNum( ent->s.otherEntityNum );
 
-		for ( i = 0; i < std::min(std::max(0, ent->r.numClusters), MAX_ENT_CLUSTERS); i++ )
+		if ( ment )
 		{
-			l = ent->r.clusternums[ i ];
+			svEntity_t *master = nullptr;
+
+			master = SV_SvEntityForGentity( ment );
 
-			if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
+			if ( eNums->added[ master - sv.svEntities ] || !ment->r.linked )
 			{
-				break;
+				return;
 			}
+
+			SV_AddEntToSnapshot( master, ment, eNums );
 		}
 
-		// if we haven't found it to be visible,
-		// check the overflow clusters that couldn't be stored
-		if ( i == ent->r.numClusters )
+		return; // master needs to be added, but not this dummy ent
+	}
+	//----(SA) end
+	else if ( ent->r.svFlags & SVF_VISDUMMY_MULTIPLE )
+	{
 		{
-			if ( ent->r.lastCluster )
+			int            h;
+			sharedEntity_t *ment = nullptr;
+			svEntity_t     *master = nullptr;
+
+			for ( h = 0; h < sv.num_entities; h++ )
 			{
-				for ( ; l <= ent->r.lastCluster; l++ )
+				ment = SV_GentityNum( h );
+
+				if ( ment == ent )
+				{
+					continue;
+				}
+
+				if ( ment )
+				{
+					master = SV_SvEntityForGentity( ment );
+				}
+				else
 				{
-					if ( bitvector[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
-					{
-						break;
-					}
+					continue;
+				}
+
+				if ( !( ment->r.linked ) )
+				{
+					continue;
 				}
 
-				if ( l == ent->r.lastCluster )
+				if ( ment->r.svFlags & SVF_NOCLIENT )
 				{
 					continue;
 				}
+
+				if ( eNums->added[ master - sv.svEntities ] )
+				{
+					continue;
+				}
+
+				if ( ment->s.otherEntityNum == ent->s.number )
+				{
+					SV_AddEntToSnapshot( master, ment, eNums );
+				}
 			}
-			else
+
+			return;
+		}
+	}
+
+	// add it
+	SV_AddEntToSnapshot( svEnt, ent, eNums );
+
+	// if it's a portal entity, add everything visible from its camera position
+	if ( ent->r.svFlags & SVF_PORTAL )
+	{
+		if ( ent->s.generic1 )
+		{
+			vec3_t dir;
+			VectorSubtract( ent->s.origin, origin, dir );
+
+			if ( VectorLengthSquared( dir ) > ( float ) ent->s.generic1 * ent->s.generic1 )
 			{
-				continue;
+				return;
 			}
 		}
 
-		//----(SA) added "visibility dummies"
-		if ( ent->r.svFlags & SVF_VISDUMMY )
-		{
-			sharedEntity_t *ment = nullptr;
+//          SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, true, oldframe, localClient );
+		SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, useIndex /*, true, localClient */ );
+	}
+}
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+
+With useIndex, only the entities the cluster index finds in the PVS are
+checked, in the same order as a full scan would.
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint( vec3_t origin, clientSnapshot_t *frame,
+//                                  snapshotEntityNumbers_t *eNums, bool portal, clientSnapshot_t *oldframe, bool localClient ) {
+//                                  snapshotEntityNumbers_t *eNums, bool portal ) {
+    snapshotEntityNumbers_t *eNums, bool useIndex /*, bool portal, bool localClient */ )
+{
+	sharedEntity_t *playerEnt;
+	int            clientarea, clientcluster;
+	int            leafnum;
+//	int             c_fullsend;
+	byte           *clientpvs;
+
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specifically check for it
+	if (sv.state == serverState_t::SS_DEAD)
+	{
+		return;
+	}
 
-			//find master;
-			ment = SV_GentityNum( ent->s.otherEntityNum );
+	leafnum = CM_PointLeafnum( origin );
+	clientarea = CM_LeafArea( leafnum );
+	clientcluster = CM_LeafCluster( leafnum );
+
+	// calculate the visible areas
+	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
 
-			if ( ment )
-			{
-				svEntity_t *master = nullptr;
+	clientpvs = CM_ClusterPVS( clientcluster );
 
-				master = SV_SvEntityForGentity( ment );
+//	c_fullsend = 0;
 
-				if ( master->snapshotCounter == sv.snapshotCounter || !ment->r.linked )
-				{
-					continue;
-				}
+	playerEnt = SV_GentityNum( frame->ps.clientNum );
 
-				SV_AddEntToSnapshot( master, ment, eNums );
-			}
+	if ( playerEnt->r.svFlags & SVF_SELF_PORTAL )
+	{
+		SV_AddEntitiesVisibleFromPoint( playerEnt->s.origin2, frame, eNums, useIndex );
+	}
 
-			continue; // master needs to be added, but not this dummy ent
-		}
-		//----(SA) end
-		else if ( ent->r.svFlags & SVF_VISDUMMY_MULTIPLE )
+	if ( !useIndex )
+	{
+		for ( int e = 0; e < sv.num_entities; e++ )
 		{
-			{
-				int            h;
-				sharedEntity_t *ment = nullptr;
-				svEntity_t     *master = nullptr;
+			SV_AddEntityIfVisible( e, origin, frame, eNums, playerEnt, clientarea, clientpvs, useIndex );
+		}
 
-				for ( h = 0; h < sv.num_entities; h++ )
-				{
-					ment = SV_GentityNum( h );
-
-					if ( ment == ent )
-					{
-						continue;
-					}
-
-					if ( ment )
-					{
-						master = SV_SvEntityForGentity( ment );
-					}
-					else
-					{
-						continue;
-					}
-
-					if ( !( ment->r.linked ) )
-					{
-						continue;
-					}
-
-					if ( ment->s.number != h )
-					{
-						Log::Debug( "FIXING vis dummy multiple ment->S.NUMBER!!!" );
-						ment->s.number = h;
-					}
-
-					if ( ment->r.svFlags & SVF_NOCLIENT )
-					{
-						continue;
-					}
-
-					if ( master->snapshotCounter == sv.snapshotCounter )
-					{
-						continue;
-					}
-
-					if ( ment->s.otherEntityNum == ent->s.number )
-					{
-						SV_AddEntToSnapshot( master, ment, eNums );
-					}
-				}
+		return;
+	}
 
-				continue;
-			}
-		}
+	entitySet_t candidates;
+	SV_GatherIndexedEntities( clientpvs, &candidates );
 
-		// add it
-		SV_AddEntToSnapshot( svEnt, ent, eNums );
+	for ( int word = 0; word < MAX_GENTITIES / 64; word++ )
+	{
+		uint64_t bits = candidates.bits[ word ];
 
-		// if it's a portal entity, add everything visible from its camera position
-		if ( ent->r.svFlags & SVF_PORTAL )
+		while ( bits )
 		{
-			if ( ent->s.generic1 )
-			{
-				vec3_t dir;
-				VectorSubtract( ent->s.origin, origin, dir );
+			int e = word * 64 + CountTrailingZeroes( bits );
+			bits &= bits - 1;
 
-				if ( VectorLengthSquared( dir ) > ( float ) ent->s.generic1 * ent->s.generic1 )
-				{
-					continue;
-				}
+			if ( e >= sv.num_entities )
+			{
+				return;
 			}
 
-//          SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums, true, oldframe, localClient );
-			SV_AddEntitiesVisibleFromPoint( ent->s.origin2, frame, eNums /*, true, localClient */ );
+			SV_AddEntityIfVisible( e, origin, frame, eNums, playerEnt, clientarea, clientpvs, useIndex );
 		}
+	}
+}
+
+/*
+=============
+SV_CheckEntityIndex
+
+Compares the entities found through the cluster index with a full scan.
+=============
+*/
+static void SV_CheckEntityIndex( const client_t *client, vec3_t org, const clientSnapshot_t *frame,
+                                 const snapshotEntityNumbers_t *indexed )
+{
+	std::unique_ptr<clientSnapshot_t> scanFrame( new clientSnapshot_t( *frame ) );
+	std::unique_ptr<snapshotEntityNumbers_t> scanned( new snapshotEntityNumbers_t );
+
+	scanned->numSnapshotEntities = 0;
+	scanned->added.reset();
+	scanned->added[ frame->ps.clientNum ] = true;
+
+	SV_AddEntitiesVisibleFromPoint( org, scanFrame.get(), scanned.get(), false );
 
-		continue;
+	if ( !SV_SortEntityNumbers( scanned->snapshotEntities, scanned->numSnapshotEntities ) )
+	{
+		Log::Warn( "%s^*: full scan found a duplicated entity", client->name );
+		return;
+	}
+
+	if ( !std::equal( indexed->snapshotEntities, indexed->snapshotEntities + indexed->numSnapshotEntities,
+	                  scanned->snapshotEntities, scanned->snapshotEntities + scanned->numSnapshotEntities ) )
+	{
+		Log::Warn( "%s^*: cluster index found %d entities, full scan found %d",
+		           client->name, indexed->numSnapshotEntities, scanned->numSnapshotEntities );
 	}
 }
 
 /*
 =============
-SV_BuildClientSnapshot
+SV_CollectClientSnapshot
 
 Decides which entities are going to be visible to the client, and
 copies off the playerstate and areabits.
@@ -657,28 +1068,26 @@ This properly handles multiple recursive portals, but the render
 currently doesn't.
 
 For viewing through other player's eyes, clent can be something other than client->gentity
+
+Only touches the client's own frame, so it can run for several clients at once.
+Returns false if the client has no entity to build a snapshot for, or with
+error set if the snapshot is invalid, for the caller to drop on the main thread.
 =============
 */
-static void SV_BuildClientSnapshot( client_t *client )
+static bool SV_CollectClientSnapshot( client_t *client, snapshotEntityNumbers_t *entityNumbers, const char **error )
 {
 	vec3_t                  org;
 	clientSnapshot_t        *frame;
-	snapshotEntityNumbers_t entityNumbers;
 	int                     i;
-	sharedEntity_t          *ent;
-	entityState_t           *state;
-	svEntity_t              *svEnt;
 	sharedEntity_t          *clent;
 	int                     clientNum;
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// this is the frame we are creating
 	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
 
 	// clear everything in this snapshot
-	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers->numSnapshotEntities = 0;
+	entityNumbers->added.reset();
 	memset( frame->areabits, 0, sizeof( frame->areabits ) );
 
 	// show_bug.cgi?id=62
@@ -688,7 +1097,7 @@ static void SV_BuildClientSnapshot( client_t *client )
 
 	if ( !clent || client->state == clientState_t::CS_ZOMBIE )
 	{
-		return;
+		return false;
 	}
 
 	// grab the current playerState_t
@@ -701,12 +1110,11 @@ static void SV_BuildClientSnapshot( client_t *client )
 
 	if ( clientNum < 0 || clientNum >= MAX_GENTITIES )
 	{
-		Sys::Drop( "SV_SvEntityForGentity: bad gEnt" );
+		*error = "SV_SvEntityForGentity: bad gEnt";
+		return false;
 	}
 
-	svEnt = &sv.svEntities[ clientNum ];
-
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers->added[ clientNum ] = true;
 
 	if ( clent->r.svFlags & SVF_SELF_PORTAL_EXCLUSIVE )
 	{
@@ -720,16 +1128,26 @@ static void SV_BuildClientSnapshot( client_t *client )
 
 	org[ 2 ] += ps->viewheight;
 
+	bool useIndex = sv_snapshotIndex.Get() && !sv_novis.Get();
+
 	// add all the entities directly visible to the eye, which
 	// may include portal entities that merge other viewpoints
-	SV_AddEntitiesVisibleFromPoint( org, frame, &entityNumbers /*, false, client->netchan.remoteAddress.type == NA_LOOPBACK */ );
+	SV_AddEntitiesVisibleFromPoint( org, frame, entityNumbers, useIndex /*, false, client->netchan.remoteAddress.type == NA_LOOPBACK */ );
 
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
 	// of an entity being included twice.
-	qsort( entityNumbers.snapshotEntities, entityNumbers.numSnapshotEntities,
-	       sizeof( entityNumbers.snapshotEntities[ 0 ] ), SV_QsortEntityNumbers );
+	if ( !SV_SortEntityNumbers( entityNumbers->snapshotEntities, entityNumbers->numSnapshotEntities ) )
+	{
+		*error = "SV_SortEntityNumbers: duplicated entity";
+		return false;
+	}
+
+	if ( useIndex && sv_snapshotIndex.Get() == 2 )
+	{
+		SV_CheckEntityIndex( client, org, frame, entityNumbers );
+	}
 
 	// now that all viewpoint's areabits have been OR'd together, invert
 	// all of them to make it a mask vector, which is what the renderer wants
@@ -738,25 +1156,76 @@ static void SV_BuildClientSnapshot( client_t *client )
 		( ( int * ) frame->areabits ) [ i ] = ( ( int * ) frame->areabits ) [ i ] ^ -1;
 	}
 
-	// copy the entity states out
-	frame->num_entities = 0;
-	frame->first_entity = svs.nextSnapshotEntities;
+	return true;
+}
+
+/*
+=============
+SV_AllocSnapshotEntities
+
+Reserves room for a frame's entities in the circular svs.snapshotEntities
+and returns the index of the first one.
+=============
+*/
+static int SV_AllocSnapshotEntities( int numEntities )
+{
+	int firstEntity = svs.nextSnapshotEntities;
+
+	svs.nextSnapshotEntities += numEntities;
+
+	// this should never hit, map should always be restarted first in SV_Frame
+	if ( svs.nextSnapshotEntities >= 0x7FFFFFFE )
+	{
+		Sys::Error( "svs.nextSnapshotEntities wrapped" );
+	}
+
+	return firstEntity;
+}
+
+/*
+=============
+SV_CopySnapshotEntities
 
-	for ( i = 0; i < entityNumbers.numSnapshotEntities; i++ )
+Copies the entity states out into the frame's reserved part of svs.snapshotEntities.
+=============
+*/
+static void SV_CopySnapshotEntities( clientSnapshot_t *frame, const snapshotEntityNumbers_t *entityNumbers )
+{
+	for ( int i = 0; i < entityNumbers->numSnapshotEntities; i++ )
 	{
-		ent = SV_GentityNum( entityNumbers.snapshotEntities[ i ] );
-		state = &svs.snapshotEntities[ svs.nextSnapshotEntities % svs.numSnapshotEntities ];
-		*state = ent->s;
-		svs.nextSnapshotEntities++;
+		sharedEntity_t *ent = SV_GentityNum( entityNumbers->snapshotEntities[ i ] );
+		svs.snapshotEntities[ ( frame->first_entity + i ) % svs.numSnapshotEntities ] = ent->s;
+	}
 
-		// this should never hit, map should always be restarted first in SV_Frame
-		if ( svs.nextSnapshotEntities >= 0x7FFFFFFE )
+	frame->num_entities = entityNumbers->numSnapshotEntities;
+}
+
+/*
+=============
+SV_BuildClientSnapshot
+=============
+*/
+static void SV_BuildClientSnapshot( client_t *client )
+{
+	snapshotEntityNumbers_t entityNumbers;
+	clientSnapshot_t        *frame;
+
+	frame = &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ];
+
+	const char *error = nullptr;
+
+	if ( !SV_CollectClientSnapshot( client, &entityNumbers, &error ) )
+	{
+		if ( error )
 		{
-			Sys::Error( "svs.nextSnapshotEntities wrapped" );
+			Sys::Drop( "%s", error );
 		}
 
-		frame->num_entities++;
+		return;
 	}
+
+	frame->first_entity = SV_AllocSnapshotEntities( entityNumbers.numSnapshotEntities );
+	SV_CopySnapshotEntities( frame, &entityNumbers );
 }
 
 /*
@@ -810,6 +1279,39 @@ static int SV_RateMsec( client_t *client, int messageSize )
 	return rateMsec;
 }
 
+/*
+=======================
+SV_SendNextFragments
+
+Continue sending a message that was too large to send at once. With
+sv_fragmentBurst, fragments go out back to back until they use up the
+client's rate for a server frame, so a gamestate or a large snapshot
+doesn't take one frame per fragment.
+=======================
+*/
+static void SV_SendNextFragments( client_t *client )
+{
+	bool unlimited = client->netchan.remoteAddress.type == netadrtype_t::NA_LOOPBACK ||
+	                 ( sv_lanForceRate.Get() && Sys_IsLANAddress( client->netchan.remoteAddress ) );
+	int frameMsec = 1000 / sv_fps.Get();
+	int rateMsec = 0;
+
+	do
+	{
+		rateMsec += SV_RateMsec( client, client->netchan.unsentLength - client->netchan.unsentFragmentStart );
+		SV_Netchan_TransmitNextFragment( client );
+	}
+	while ( sv_fragmentBurst.Get() && client->netchan.unsentFragments && ( unlimited || rateMsec < frameMsec ) );
+
+	if ( sv_fragmentBurst.Get() && unlimited )
+	{
+		client->nextSnapshotTime = svs.time - 1;
+		return;
+	}
+
+	client->nextSnapshotTime = svs.time + rateMsec;
+}
+
 /*
 =======================
 SV_SendMessageToClient
@@ -922,13 +1424,59 @@ void SV_SendClientIdle( client_t *client )
 
 /*
 =======================
-SV_SendClientSnapshot
+SV_WriteClientSnapshotMessage
 
-Also called by SV_FinalCommand
+Writes everything up to and including the snapshot itself.
+=======================
+*/
+static void SV_WriteClientSnapshotMessage( client_t *client, msg_t *msg, int nextSnapshotEntities )
+{
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong( msg, client->lastClientCommand );
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient( client, msg );
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotToClient( client, msg, nextSnapshotEntities );
+}
+
+/*
+=======================
+SV_FinishClientSnapshot
 
+Appends download data to a snapshot message and sends it.
 =======================
 */
-void SV_SendClientSnapshot( client_t *client )
+static void SV_FinishClientSnapshot( client_t *client, msg_t *msg )
+{
+	// Add any download data if the client is downloading
+	SV_WriteDownloadToClient( client, msg );
+
+	// check for overflow
+	if ( msg->overflowed )
+	{
+		Log::Warn("msg overflowed for %s", client->name );
+		MSG_Clear( msg );
+
+		SV_DropClient( client, "Msg overflowed" );
+		return;
+	}
+
+	SV_SendMessageToClient( msg, client );
+
+	sv.bpsTotalBytes += msg->cursize; // NERVE - SMF - net debugging
+	sv.ubpsTotalBytes += msg->uncompsize / 8; // NERVE - SMF - net debugging
+}
+
+/*
+=======================
+SV_BuildAndSendClientSnapshot
+=======================
+*/
+static void SV_BuildAndSendClientSnapshot( client_t *client )
 {
 	byte  msg_buf[ MAX_MSGLEN ];
 	msg_t msg;
@@ -957,34 +1505,171 @@ void SV_SendClientSnapshot( client_t *client )
 
 	MSG_Init( &msg, msg_buf, sizeof( msg_buf ) );
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong( &msg, client->lastClientCommand );
+	SV_WriteClientSnapshotMessage( client, &msg, svs.nextSnapshotEntities );
 
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient( client, &msg );
+	SV_FinishClientSnapshot( client, &msg );
+}
 
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient( client, &msg );
+/*
+=======================
+SV_SendClientSnapshot
 
-	// Add any download data if the client is downloading
-	SV_WriteDownloadToClient( client, &msg );
+Also called by SV_FinalCommand
 
-	// check for overflow
-	if ( msg.overflowed )
+=======================
+*/
+void SV_SendClientSnapshot( client_t *client )
+{
+	SV_UpdateEntityIndex();
+	SV_BuildAndSendClientSnapshot( client );
+}
+
+/*
+=======================
+SV_SendClientSnapshotsParallel
+
+Builds and encodes the snapshots of several clients on the thread pool.
+
+Entity visibility and delta encoding run concurrently, while the
+allocation of svs.snapshotEntities and the actual sending happen on the
+main thread in client order, so the result is the same as calling
+SV_SendClientSnapshot for each client in turn. Clients which are only
+sent fragments or an idle message are handled at their place in the
+order too.
+=======================
+*/
+struct snapshotJob_t
+{
+	client_t                *client;
+	bool                    snapshot; // builds a new snapshot, else sent on the main thread only
+	bool                    built;
+	const char              *error;
+	int                     nextSnapshotEntities;
+	snapshotEntityNumbers_t entityNumbers;
+	msg_t                   msg;
+	byte                    msgBuf[ MAX_MSGLEN ];
+};
+
+static void SV_SendClientSnapshotsParallel( const std::vector<client_t *> &clients )
+{
+	static std::vector<std::unique_ptr<snapshotJob_t>> jobs;
+	int numJobs = clients.size();
+
+	while ( static_cast<int>( jobs.size() ) < numJobs )
 	{
-		Log::Warn("msg overflowed for %s", client->name );
-		MSG_Clear( &msg );
+		jobs.emplace_back( new snapshotJob_t );
+	}
 
-		SV_DropClient( client, "Msg overflowed" );
-		return;
+	for ( int i = 0; i < numJobs; i++ )
+	{
+		snapshotJob_t *job = jobs[ i ].get();
+		client_t *client = clients[ i ];
+		job->client = client;
+		job->snapshot = !client->netchan.unsentFragments &&
+		                ( client->state >= clientState_t::CS_ACTIVE || client->state == clientState_t::CS_ZOMBIE );
+		job->built = false;
+		job->error = nullptr;
 	}
 
-	SV_SendMessageToClient( &msg, client );
+	ThreadPool::ParallelFor( sv_snapshotThreads.Get(), numJobs, []( int i ) {
+		snapshotJob_t *job = jobs[ i ].get();
 
-	sv.bpsTotalBytes += msg.cursize; // NERVE - SMF - net debugging
-	sv.ubpsTotalBytes += msg.uncompsize / 8; // NERVE - SMF - net debugging
+		if ( job->snapshot )
+		{
+			job->built = SV_CollectClientSnapshot( job->client, &job->entityNumbers, &job->error );
+		}
+	} );
+
+	// the workers can't drop, report the first error like the serial path would
+	for ( int i = 0; i < numJobs; i++ )
+	{
+		if ( jobs[ i ]->error )
+		{
+			Sys::Drop( "%s", jobs[ i ]->error );
+		}
+	}
+
+	// hand out the entity storage in the same order as the serial path would
+	for ( int i = 0; i < numJobs; i++ )
+	{
+		snapshotJob_t *job = jobs[ i ].get();
+		client_t *client = job->client;
+
+		if ( job->built )
+		{
+			client->frames[ client->netchan.outgoingSequence & PACKET_MASK ].first_entity =
+				SV_AllocSnapshotEntities( job->entityNumbers.numSnapshotEntities );
+		}
+
+		job->nextSnapshotEntities = svs.nextSnapshotEntities;
+	}
+
+	// the serial path encodes each client before the following ones overwrite
+	// the oldest part of the ring; if a frame we may delta from lies there,
+	// keep that ordering
+	bool serial = false;
+
+	for ( int i = 0; i < numJobs; i++ )
+	{
+		const client_t *client = jobs[ i ]->client;
+
+		if ( jobs[ i ]->snapshot && client->deltaMessage > 0 &&
+		     client->frames[ client->deltaMessage & PACKET_MASK ].first_entity < svs.nextSnapshotEntities - svs.numSnapshotEntities )
+		{
+			serial = true;
+			break;
+		}
+	}
+
+	auto encode = []( int i ) {
+		snapshotJob_t *job = jobs[ i ].get();
+		client_t *client = job->client;
+
+		if ( !job->snapshot )
+		{
+			return;
+		}
+
+		if ( job->built )
+		{
+			SV_CopySnapshotEntities( &client->frames[ client->netchan.outgoingSequence & PACKET_MASK ], &job->entityNumbers );
+		}
+
+		MSG_Init( &job->msg, job->msgBuf, sizeof( job->msgBuf ) );
+		SV_WriteClientSnapshotMessage( client, &job->msg, job->nextSnapshotEntities );
+	};
+
+	ThreadPool::ParallelFor( serial ? 0 : sv_snapshotThreads.Get(), numJobs, encode );
+
+	// a drop broadcasts commands and lets the game change entities, which the
+	// serial path would send to the following clients right away; they are
+	// built again on the main thread then
+	bool rebuild = false;
+
+	for ( int i = 0; i < numJobs; i++ )
+	{
+		snapshotJob_t *job = jobs[ i ].get();
+		clientState_t state = job->client->state;
+
+		if ( job->snapshot && !rebuild )
+		{
+			SV_FinishClientSnapshot( job->client, &job->msg );
+		}
+		else if ( job->client->netchan.unsentFragments )
+		{
+			SV_SendNextFragments( job->client );
+		}
+		else
+		{
+			SV_BuildAndSendClientSnapshot( job->client );
+		}
+
+		if ( !rebuild && state != clientState_t::CS_ZOMBIE && job->client->state == clientState_t::CS_ZOMBIE )
+		{
+			rebuild = true;
+			svs.nextSnapshotEntities = job->nextSnapshotEntities;
+		}
+	}
 }
 
 /*
@@ -997,6 +1682,13 @@ void SV_SendClientMessages()
 {
 	client_t *c;
 	int      numclients = 0; // NERVE - SMF - net debugging
+	bool     parallel = sv_snapshotThreads.Get() > 0;
+	static std::vector<client_t *> snapshotClients;
+
+	PROFILE_ZONE( "SV_SendClientMessages" );
+
+	// send the snapshots of all the clients together once they are built
+	Sys::PacketBatch packetBatch;
 
 	sv.bpsTotalBytes = 0; // NERVE - SMF - net debugging
 	sv.ubpsTotalBytes = 0; // NERVE - SMF - net debugging
@@ -1004,6 +1696,13 @@ void SV_SendClientMessages()
 	// Gordon: update any changed configstrings from this frame
 	SV_UpdateConfigStrings();
 
+	// entity states change between frames, so start over with the delta cache
+	deltaCacheFrame++;
+
+	SV_UpdateEntityIndex();
+
+	snapshotClients.clear();
+
 	// send a message to each connected client
 	for ( int i = 0; i < sv_maxClients.Get(); i++ )
 	{
@@ -1030,17 +1729,28 @@ void SV_SendClientMessages()
 
 		numclients++; // NERVE - SMF - net debugging
 
+		// keep the order of the sends, see SV_SendClientSnapshotsParallel
+		if ( parallel )
+		{
+			snapshotClients.push_back( c );
+			continue;
+		}
+
 		// send additional message fragments if the last message
 		// was too large to send at once
 		if ( c->netchan.unsentFragments )
 		{
-			c->nextSnapshotTime = svs.time + SV_RateMsec( c, c->netchan.unsentLength - c->netchan.unsentFragmentStart );
-			SV_Netchan_TransmitNextFragment( c );
+			SV_SendNextFragments( c );
 			continue;
 		}
 
 		// generate and send a new message
-		SV_SendClientSnapshot( c );
+		SV_BuildAndSendClientSnapshot( c );
+	}
+
+	if ( !snapshotClients.empty() )
+	{
+		SV_SendClientSnapshotsParallel( snapshotClients );
 	}
 
 	// NERVE - SMF - net debugging
@@ -1095,6 +1805,15 @@ void SV_SendClientMessages()
 			bandwidthLog.Debug( "bpspc(%2.0f) bps(%2.0f) pk(%i) ubps(%2.0f) upk(%i) cr(%2.2f) acr(%2.2f)",
 			             ave / ( float ) numclients, ave, sv.bpsMaxBytes, uave, sv.ubpsMaxBytes, comp_ratio,
 			             sv.ucompAve / sv.ucompNum );
+
+			int hits = deltaCacheHits.exchange( 0 );
+			int misses = deltaCacheMisses.exchange( 0 );
+
+			if ( hits + misses )
+			{
+				bandwidthLog.Debug( "delta cache: hits(%i) misses(%i) hr(%2.2f)",
+				             hits, misses, 100.f * hits / ( hits + misses ) );
+			}
 		}
 	});
 
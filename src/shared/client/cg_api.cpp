@@ -84,11 +84,43 @@ void trap_GetCurrentSnapshotNumber( int *snapshotNumber, int *serverTime )
 	VM::SendMsg<GetCurrentSnapshotNumberMsg>(*snapshotNumber, *serverTime);
 }
 
+// The engine writes every parsed snapshot in this ring, so that only the
+// server commands have to go through the socket
+static IPC::SharedMemory snapshotMemory;
+
 bool trap_GetSnapshot( int snapshotNumber, ipcSnapshot_t *snapshot )
 {
+	if (!snapshotMemory) {
+		snapshotMemory = IPC::SharedMemory::Create(sizeof(sharedSnapshots_t));
+		VM::SendMsg<LocateSnapshotsMsg>(snapshotMemory);
+	}
+
 	bool res;
-	VM::SendMsg<GetSnapshotMsg>(snapshotNumber, res, *snapshot);
-	return res;
+	uint32_t generation;
+	VM::SendMsg<GetSharedSnapshotMsg>(snapshotNumber, res, generation, snapshot->b.serverCommands);
+	if (!res) {
+		return false;
+	}
+
+	const sharedSnapshots_t* shared = static_cast<const sharedSnapshots_t*>(snapshotMemory.GetBase());
+	const sharedSnapshot_t& slot = shared->slots[snapshotNumber % SHARED_SNAPSHOT_SLOTS];
+	if (slot.generation != generation || slot.messageNum != snapshotNumber) {
+		Sys::Drop("trap_GetSnapshot: snapshot %d was overwritten", snapshotNumber);
+	}
+
+	snapshot->b.snapFlags = slot.snapFlags;
+	snapshot->b.ping = slot.ping;
+	snapshot->b.serverTime = slot.serverTime;
+	memcpy(snapshot->b.areamask, slot.areamask, sizeof(snapshot->b.areamask));
+	snapshot->ps = slot.ps;
+
+	// the entities may wrap around the end of the ring
+	int start = slot.firstEntity % SHARED_SNAPSHOT_ENTITIES;
+	int count = std::min(slot.numEntities, SHARED_SNAPSHOT_ENTITIES - start);
+	snapshot->b.entities.assign(shared->entities + start, shared->entities + start + count);
+	snapshot->b.entities.insert(snapshot->b.entities.end(), shared->entities, shared->entities + slot.numEntities - count);
+
+	return true;
 }
 
 int trap_GetCurrentCmdNumber()
@@ -544,6 +576,19 @@ int trap_R_BlendSkeleton( refSkeleton_t *skel, const refSkeleton_t *blend, float
     return true;
 }
 
+// Prefer this to many trap_R_BuildSkeleton calls, which are a roundtrip each
+void trap_R_BuildSkeletons( const std::vector<skeletonJob_t> &jobs, std::vector<refSkeleton_t> &skeletons, std::vector<int> &results )
+{
+	if ( jobs.empty() )
+	{
+		skeletons.clear();
+		results.clear();
+		return;
+	}
+
+	VM::SendMsg<Render::BuildSkeletonsMsg>( jobs, skeletons, results );
+}
+
 int trap_R_BoneIndex( qhandle_t hModel, const char *boneName )
 {
 	int index;